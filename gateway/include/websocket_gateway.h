@@ -6,6 +6,7 @@
 #include <set>
 #include <sys/epoll.h>
 #include <nlohmann/json.hpp>
+#include "fd_slab.h"
 
 using json = nlohmann::json;
 
@@ -15,12 +16,12 @@ using json = nlohmann::json;
 
 // WebSocket connection info
 struct WebSocketConn {
-    int sockfd;
+    int sockfd = -1;
     std::string session_token;
-    int backend_sockfd;  // Connection to backend TCP server
+    int backend_sockfd = -1;  // Connection to backend TCP server
     std::string ws_buffer;  // Buffer for WebSocket frame reassembly
     std::string backend_buffer;  // Buffer for backend response reassembly
-    bool handshake_done;
+    bool handshake_done = false;
 };
 
 class WebSocketGateway {
@@ -31,8 +32,11 @@ private:
     std::string backend_host;
     int backend_port;
     
-    // Map WebSocket socket fd -> WebSocketConn
-    std::map<int, WebSocketConn> connections;
+    // WebSocket socket fd -> WebSocketConn (dense, indexed directly by fd)
+    FdSlab<WebSocketConn> connections;
+    
+    // Backend socket fd -> owning WebSocket client fd
+    FdSlab<int> backend_owner;
     
     bool setup_server_socket();
     bool setup_epoll();
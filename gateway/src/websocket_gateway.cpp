@@ -83,11 +83,12 @@ void WebSocketGateway::stop() {
     if (server_fd >= 0) close(server_fd);
     if (epoll_fd >= 0) close(epoll_fd);
     
-    for (auto& conn : connections) {
-        if (conn.second.sockfd >= 0) close(conn.second.sockfd);
-        if (conn.second.backend_sockfd >= 0) close(conn.second.backend_sockfd);
-    }
+    connections.for_each([](int, WebSocketConn& conn) {
+        if (conn.sockfd >= 0) close(conn.sockfd);
+        if (conn.backend_sockfd >= 0) close(conn.backend_sockfd);
+    });
     connections.clear();
+    backend_owner.clear();
 }
 
 void WebSocketGateway::handle_new_connection() {
@@ -105,12 +106,8 @@ void WebSocketGateway::handle_new_connection() {
     int flags = fcntl(client_fd, F_GETFL, 0);
     fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
     
-    WebSocketConn conn;
+    WebSocketConn& conn = connections.insert(client_fd);
     conn.sockfd = client_fd;
-    conn.backend_sockfd = -1;
-    conn.handshake_done = false;
-    
-    connections[client_fd] = conn;
     
     struct epoll_event event;
     event.events = EPOLLIN | EPOLLET;
@@ -122,15 +119,16 @@ void WebSocketGateway::handle_new_connection() {
 }
 
 void WebSocketGateway::handle_client_disconnect(int client_fd) {
-    auto it = connections.find(client_fd);
-    if (it != connections.end()) {
-        if (it->second.backend_sockfd >= 0) {
-            close(it->second.backend_sockfd);
-            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, it->second.backend_sockfd, nullptr);
+    WebSocketConn* conn = connections.find(client_fd);
+    if (conn) {
+        if (conn->backend_sockfd >= 0) {
+            close(conn->backend_sockfd);
+            epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn->backend_sockfd, nullptr);
+            backend_owner.erase(conn->backend_sockfd);
         }
         close(client_fd);
         epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, nullptr);
-        connections.erase(it);
+        connections.erase(client_fd);
         std::cout << "WebSocket client disconnected (fd=" << client_fd << ")" << std::endl;
     }
 }
@@ -377,10 +375,10 @@ int WebSocketGateway::connect_to_backend() {
 }
 
 void WebSocketGateway::forward_ws_to_backend(int client_fd, const std::string& json_str) {
-    auto it = connections.find(client_fd);
-    if (it == connections.end()) return;
+    WebSocketConn* found = connections.find(client_fd);
+    if (!found) return;
     
-    WebSocketConn& conn = it->second;
+    WebSocketConn& conn = *found;
     
     // Create backend connection if needed
     if (conn.backend_sockfd < 0) {
@@ -389,6 +387,7 @@ void WebSocketGateway::forward_ws_to_backend(int client_fd, const std::string& j
             std::cerr << "Failed to create backend connection" << std::endl;
             return;
         }
+        backend_owner.insert(conn.backend_sockfd) = client_fd;
     }
     
     try {
@@ -474,10 +473,10 @@ void WebSocketGateway::forward_backend_to_ws(int client_fd, const std::string& d
 }
 
 void WebSocketGateway::handle_websocket_data(int client_fd) {
-    auto it = connections.find(client_fd);
-    if (it == connections.end()) return;
+    WebSocketConn* found = connections.find(client_fd);
+    if (!found) return;
     
-    WebSocketConn& conn = it->second;
+    WebSocketConn& conn = *found;
     
     // Do handshake if not done yet
     if (!conn.handshake_done) {
@@ -546,17 +545,14 @@ void WebSocketGateway::handle_websocket_data(int client_fd) {
 
 void WebSocketGateway::handle_backend_data(int backend_fd) {
     // Find which client this backend fd belongs to
-    int client_fd = -1;
-    for (auto& conn : connections) {
-        if (conn.second.backend_sockfd == backend_fd) {
-            client_fd = conn.first;
-            break;
-        }
-    }
+    int* owner = backend_owner.find(backend_fd);
+    if (!owner) return;
     
-    if (client_fd < 0) return;
+    int client_fd = *owner;
+    WebSocketConn* found = connections.find(client_fd);
+    if (!found) return;
     
-    WebSocketConn& conn = connections[client_fd];
+    WebSocketConn& conn = *found;
     
     char buffer[4096];
     ssize_t n = recv(backend_fd, buffer, sizeof(buffer), 0);
@@ -608,8 +604,7 @@ void WebSocketGateway::run() {
                 handle_new_connection();
             } else {
                 // Check if it's a WebSocket client or backend connection
-                auto it = connections.find(fd);
-                if (it != connections.end()) {
+                if (connections.find(fd)) {
                     // WebSocket client
                     handle_websocket_data(fd);
                 } else {
@@ -0,0 +1,99 @@
+#ifndef ANSWER_WRITER_H
+#define ANSWER_WRITER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "database.h"
+
+// Defaults for AnswerWriter (--answer-flush-ms, --answer-flush-rows)
+#define DEFAULT_ANSWER_FLUSH_MS 50
+#define DEFAULT_ANSWER_FLUSH_ROWS 512
+
+// Counters since startup (read with AnswerWriter::get_stats)
+struct AnswerWriterStats {
+    uint64_t enqueued = 0;          // CHANGE_ANSWER upserts received
+    uint64_t coalesced = 0;         // Replaced a pending answer to the same question
+    uint64_t rows_written = 0;
+    uint64_t flushes = 0;
+    uint64_t failed_rows = 0;       // Rejected by the database (e.g. unknown room)
+    uint64_t failed_flushes = 0;    // Transaction failed: the batch went back to pending
+    size_t queue_depth = 0;         // Pending right now
+    size_t max_queue_depth = 0;
+    double last_flush_ms = 0;
+    double max_flush_ms = 0;
+};
+
+// Write-behind queue for UserTestAnswers.
+// Answer clicks only update a pending map keyed by (user, room, question),
+// so repeated changes to one question keep just the last choice. A flusher
+// thread writes the pending answers in one transaction every flush_ms, or
+// sooner once flush_rows are pending: one commit per batch instead of one
+// per click. flush() writes everything pending on the caller's thread (on
+// submit and at exam end); if it returns true, answers enqueued before it
+// returns are stored. A batch whose transaction fails goes back to pending
+// (behind newer changes to the same questions) for the next flush.
+class AnswerWriter {
+private:
+    struct AnswerKey {
+        int user_id;
+        int room_id;
+        int question_id;
+        
+        bool operator==(const AnswerKey& other) const {
+            return user_id == other.user_id && room_id == other.room_id && question_id == other.question_id;
+        }
+    };
+    
+    struct AnswerKeyHash {
+        size_t operator()(const AnswerKey& key) const {
+            uint64_t h = (uint64_t)(uint32_t)key.user_id * 0x9E3779B97F4A7C15ULL;
+            h ^= ((uint64_t)(uint32_t)key.room_id << 32 | (uint32_t)key.question_id) + (h << 6) + (h >> 2);
+            return (size_t)h;
+        }
+    };
+    
+    Database* db;
+    int flush_ms;
+    size_t flush_rows;
+    
+    std::mutex mutex;               // pending, stats, stopping
+    std::condition_variable wake;
+    std::unordered_map<AnswerKey, std::string, AnswerKeyHash> pending;
+    AnswerWriterStats stats;
+    bool stopping;
+    
+    // One batch at a time: a synchronous flush waits for the one in progress
+    std::mutex write_mutex;
+    
+    std::thread flusher;
+    
+    void flusher_loop();
+    
+    // Take everything pending and write it; false if the transaction
+    // failed (the batch is pending again)
+    bool write_pending();
+
+public:
+    AnswerWriter(Database* database, int flush_ms = DEFAULT_ANSWER_FLUSH_MS,
+                 size_t flush_rows = DEFAULT_ANSWER_FLUSH_ROWS);
+    ~AnswerWriter();    // Flushes what is left
+    
+    AnswerWriter(const AnswerWriter&) = delete;
+    AnswerWriter& operator=(const AnswerWriter&) = delete;
+    
+    // Record an answer (thread-safe, never touches the database)
+    void enqueue(int user_id, int room_id, int question_id, const std::string& selected_option);
+    
+    // Write every pending answer now (thread-safe, blocking); false if
+    // they could not be stored
+    bool flush();
+    
+    AnswerWriterStats get_stats();
+};
+
+#endif // ANSWER_WRITER_H
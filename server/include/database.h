@@ -4,10 +4,32 @@
 #include <sqlite3.h>
 #include <string>
 #include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 #include <nlohmann/json.hpp>
+#include "question_index.h"
+#include "question_cache.h"
+#include "grader.h"
 
 using json = nlohmann::json;
 
+// DatabaseConfig defaults
+#define DEFAULT_DB_MMAP_SIZE (256LL * 1024 * 1024)  // Bytes of the file read through mmap
+#define DEFAULT_DB_CACHE_KIB 16384                  // Page cache per connection
+#define DEFAULT_WAL_AUTOCHECKPOINT 2000             // WAL pages before a checkpoint
+
+// Connection tuning applied by Database::configure()
+struct DatabaseConfig {
+    bool wal = true;                // journal_mode=WAL + synchronous=NORMAL
+    int read_connections = 0;       // Read-only connections (0 = reads use the writer)
+    int64_t mmap_size = DEFAULT_DB_MMAP_SIZE;
+    int cache_size_kib = DEFAULT_DB_CACHE_KIB;
+    int wal_autocheckpoint = DEFAULT_WAL_AUTOCHECKPOINT;
+    size_t question_cache_size = DEFAULT_QUESTION_CACHE_SIZE;  // Decoded questions kept (0 = off)
+};
+
 // Forward declarations
 struct User;
 struct Question;
@@ -23,16 +45,7 @@ struct User {
     std::string created_at;
 };
 
-// Question structure
-struct Question {
-    int question_id;
-    std::string content;
-    json options; // {"a": "...", "b": "...", ...}
-    std::string correct_option;
-    std::string difficulty;
-    std::string topic;
-    int created_by;
-};
+// Question structure: see question_cache.h
 
 // Test Room structure
 struct TestRoom {
@@ -47,6 +60,14 @@ struct TestRoom {
     std::string end_timestamp;
 };
 
+// One UserTestAnswers row (see Database::save_user_answers)
+struct UserAnswer {
+    int user_id;
+    int room_id;
+    int question_id;
+    std::string selected_option;
+};
+
 // Session structure
 struct Session {
     std::string session_token;
@@ -59,11 +80,102 @@ private:
     sqlite3* db;
     std::string db_path;
     
+    // Serializes access from worker threads (statement sequences such as
+    // INSERT + last_insert_rowid must not interleave)
+    std::recursive_mutex db_mutex;
+    
+    // Prepared statements keyed by SQL text: prepared on first use, then
+    // reset and rebound. sqlite3_prepare_v2 statements re-prepare themselves
+    // after a schema change; initialize() still drops them after running DDL.
+    typedef std::unordered_map<std::string, sqlite3_stmt*> StatementMap;
+    StatementMap statements;
+    std::atomic<bool> cache_statements;
+    
+    // Statement for `sql` on `handle`: the cached one, or a one-off (cached = false)
+    // when caching is off or the cached one is still being stepped (re-entrant call)
+    sqlite3_stmt* acquire_statement(sqlite3* handle, StatementMap& cache, const char* sql, bool& cached);
+    static void finalize_statements(StatementMap& cache);
+    
+    // Read-only connection: with WAL, readers run in parallel with the writer
+    // and with each other. Each thread sticks to one (round-robin on first use).
+    struct ReadConnection {
+        sqlite3* db = nullptr;
+        std::mutex mutex;       // Contended only with more reading threads than connections
+        StatementMap statements;
+    };
+    std::vector<std::unique_ptr<ReadConnection>> readers;
+    
+    // Connection for one read-only call: the calling thread's reader, or the
+    // writer (under db_mutex) when there are no readers
+    class ReadLease {
+    private:
+        std::unique_lock<std::recursive_mutex> writer_lock;
+        std::unique_lock<std::mutex> reader_lock;
+    
+    public:
+        sqlite3* db;
+        StatementMap* statements;
+        
+        explicit ReadLease(Database* database);
+    };
+    
+    // Statement borrowed for one call. Reset and unbound when it goes out of
+    // scope (so a SELECT never keeps its read open), one-offs are finalized.
+    class CachedStatement {
+    private:
+        sqlite3_stmt* stmt;
+        bool cached;
+    
+    public:
+        // On the writer (caller holds db_mutex)
+        CachedStatement(Database* database, const char* sql) : cached(false) {
+            stmt = database->acquire_statement(database->db, database->statements, sql, cached);
+        }
+        // On a leased read connection
+        CachedStatement(Database* database, ReadLease& reader, const char* sql) : cached(false) {
+            stmt = database->acquire_statement(reader.db, *reader.statements, sql, cached);
+        }
+        ~CachedStatement() {
+            if (stmt && cached) {
+                sqlite3_reset(stmt);
+                sqlite3_clear_bindings(stmt);
+            } else if (stmt) {
+                sqlite3_finalize(stmt);
+            }
+        }
+        CachedStatement(const CachedStatement&) = delete;
+        CachedStatement& operator=(const CachedStatement&) = delete;
+        
+        operator sqlite3_stmt*() const { return stmt; }
+    };
+    
+    void close_readers();
+    
+    // Question ids by (topic, difficulty) for get_random_questions
+    QuestionIndex question_index;
+    
+    // Correct option by question id, for grading
+    AnswerKeyTable answer_keys;
+    
+    // Fill question_index and answer_keys from the Questions table (end of initialize())
+    bool load_question_index();
+    
+    // Decoded Question objects by id (json::parse of options once per row)
+    QuestionCache question_cache;
+    
+    // Load the newest questions up to the cache capacity (configure())
+    void warm_question_cache();
+    
+    // Question from a row of `stmt` (7 columns, question_id first): the
+    // cached copy if there is one, else decoded and, if `remember`, cached
+    void read_question(sqlite3_stmt* stmt, Question& question, uint64_t stamp, bool remember);
+    
     // Helper: execute SQL with no return
     bool execute_sql(const std::string& sql);
     
     // Helper: get last insert rowid
     int64_t get_last_insert_rowid();
+    
 
 public:
     Database(const std::string& path);
@@ -75,10 +187,18 @@ public:
     // Check if database is open
     bool is_open() const { return db != nullptr; }
     
+    // WAL, pragmas and read connections; call after initialize()
+    bool configure(const DatabaseConfig& config);
+    int reader_count() const { return static_cast<int>(readers.size()); }
+    
+    // Prepare every statement on each call instead (benchmark baseline)
+    void set_statement_cache(bool enabled);
+    
     // User operations
     bool create_user(const std::string& username, const std::string& hashed_password, const std::string& role);
     bool get_user_by_username(const std::string& username, User& user);
     bool get_user_by_id(int user_id, User& user);
+    bool update_password_hash(int user_id, const std::string& hashed_password);
     
     // Session operations
     bool create_session(const std::string& token, int user_id, int expiry_seconds);
@@ -92,6 +212,13 @@ public:
     std::vector<Question> get_questions_by_filter(const std::string& topic, const std::string& difficulty, int limit);
     bool get_question_by_id(int question_id, Question& question);
     std::vector<Question> get_random_questions(int count, const std::string& topic, const std::string& difficulty);
+    size_t indexed_question_count() { return question_index.size(); }
+    QuestionCacheStats question_cache_stats() { return question_cache.get_stats(); }
+    
+    // Encoded correct options of question_ids, in order (one in-memory lookup)
+    void get_answer_key(const std::vector<int>& question_ids, std::vector<uint8_t>& key) {
+        answer_keys.lookup(question_ids, key);
+    }
     
     // New Question Management
     bool create_question(const std::string& content, const json& options, const std::string& correct_option,
@@ -115,21 +242,42 @@ public:
     bool update_room_timestamps(int room_id, const std::string& start_time, const std::string& end_time);
     
     // Room participant operations
-    bool add_participant(int room_id, int user_id);
+    bool add_participant(int room_id, int user_id);     // Only while the room is NOT_STARTED
     bool update_participant_status(int room_id, int user_id, const std::string& status);
     bool update_participant_score(int room_id, int user_id, int score);
     std::vector<std::string> get_room_participants(int room_id);
+    std::vector<int> get_room_participant_ids(int room_id);
     bool is_user_in_room(int room_id, int user_id);
     
     // Room questions operations
     bool add_room_questions(int room_id, const std::vector<int>& question_ids);
+    
+    // START_TEST in one transaction: NOT_STARTED -> ONGOING with the timestamps,
+    // the exam's questions, and the participants at that point (user_ids).
+    // False if the room was not NOT_STARTED (already started by someone else).
+    bool start_room(int room_id, const std::vector<int>& question_ids, const std::string& start_time,
+                    const std::string& end_time, std::vector<int>& user_ids);
+    // Undo start_room (ONGOING -> NOT_STARTED, the exam's questions removed)
+    bool cancel_room_start(int room_id);
     std::vector<Question> get_room_questions(int room_id);
     
     // User test answers operations
     bool save_user_answer(int user_id, int room_id, int question_id, const std::string& selected_option);
+    
+    // Upsert a batch in one transaction; saved counts the rows stored (rows
+    // the database rejects, e.g. an unknown room, are skipped, not the
+    // batch). False if the transaction failed: nothing was stored.
+    bool save_user_answers(const std::vector<UserAnswer>& answers, size_t& saved);
     bool update_answer_correctness(int user_id, int room_id, int question_id, bool is_correct);
     int get_user_score(int user_id, int room_id);
     
+    // End of a live exam, in one transaction: the graded sheets (row p =
+    // user_ids[p], column q = question_ids[q]) as is_correct of every answer
+    // of the room and the participants' scores, every participant SUBMITTED
+    // (sheets not handed in are auto-submitted) and the room FINISHED
+    bool finish_room(int room_id, const std::vector<int>& user_ids, const std::vector<int>& question_ids,
+                     const SheetGrades& grades);
+    
     // Statistics operations
     json get_user_practice_history(int user_id);
     json get_user_test_history(int user_id);
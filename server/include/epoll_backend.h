@@ -0,0 +1,34 @@
+#ifndef EPOLL_BACKEND_H
+#define EPOLL_BACKEND_H
+
+#include <sys/epoll.h>
+#include "io_backend.h"
+
+#define MAX_EVENTS 64
+
+// Readiness backend: edge-triggered epoll for connections, level-triggered
+// for the listening socket, the wakeup eventfd and the timerfd.
+class EpollBackend : public IoBackend {
+private:
+    int epoll_fd;
+    int listen_fd;
+    int wakeup_fd;
+    int timer_fd;
+    IoStats* stats;
+    struct epoll_event ready[MAX_EVENTS];
+
+public:
+    EpollBackend();
+    ~EpollBackend();
+    
+    const char* name() const { return "epoll"; }
+    bool setup(int listen_fd, int wakeup_fd, int timer_fd, IoStats* stats);
+    bool add_client(int fd);
+    void remove_client(int fd);
+    void pause_recv(int) {}
+    void resume_recv(int) {}
+    bool wait(std::vector<IoEvent>& events, int timeout_ms);
+    SendResult flush(int fd, OutputQueue& queue);
+};
+
+#endif // EPOLL_BACKEND_H
@@ -0,0 +1,97 @@
+#ifndef EXAM_ENGINE_H
+#define EXAM_ENGINE_H
+
+#include <cstdint>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "grader.h"
+
+// Outcome of CHANGE_ANSWER / SUBMIT_TEST against a running exam
+enum class ExamChange {
+    OK,
+    NOT_RUNNING,        // Room not started, or the exam is over (or its time is up)
+    NOT_PARTICIPANT,    // Not in the room when the exam started
+    UNKNOWN_QUESTION,   // Not one of the exam's questions
+    INVALID_OPTION,
+    SUBMITTED           // Sheet already handed in
+};
+
+// One ONGOING room. Sheet row p belongs to user_ids[p], column q to
+// question_ids[q]; answers are encoded like Grader::encode_option.
+struct ExamRoom {
+    int room_id = 0;
+    time_t end_time = 0;
+    std::vector<int> question_ids;      // Exam order
+    std::vector<int> user_ids;          // Participants at start
+    AnswerSheets sheets;
+    std::vector<uint8_t> submitted;     // Per participant: 1 once handed in
+    size_t submitted_count = 0;
+    bool closed = false;                // Time is up: submissions only (grace period)
+    bool finished = false;              // Taken out by ExamEngine::finish
+    
+    std::unordered_map<int, uint32_t> question_slots;       // question_id -> column
+    std::unordered_map<int, uint32_t> participant_slots;    // user_id -> row
+    
+    std::mutex mutex;
+};
+
+// Live exams, shared by every worker and pool thread. An answer change is
+// two hash lookups and a byte store under the room's lock; the answer is
+// then handed to the sink (the AnswerWriter queue) to reach
+// UserTestAnswers asynchronously. The sink runs under the room lock, so
+// once finish() returns no answer of the room is still on its way to it.
+class ExamEngine {
+public:
+    typedef std::function<void(int user_id, int room_id, int question_id, const std::string& selected_option)>
+        AnswerSink;
+
+private:
+    std::shared_mutex mutex;
+    std::unordered_map<int, std::shared_ptr<ExamRoom>> rooms;
+    AnswerSink sink;
+    
+    std::shared_ptr<ExamRoom> find(int room_id);
+    ExamChange apply_locked(ExamRoom& room, uint32_t row, int question_id, const std::string& selected_option);
+
+public:
+    // Set before the first exam starts
+    void set_sink(AnswerSink answer_sink) { sink = std::move(answer_sink); }
+    
+    // Fails if the room is already running
+    bool start(int room_id, const std::vector<int>& question_ids, const std::vector<int>& user_ids, time_t end_time);
+    
+    ExamChange change_answer(int room_id, int user_id, int question_id, const std::string& selected_option);
+    
+    // Hand in a sheet with its last answers (invalid ones are skipped), also
+    // after close(); all_submitted: this was the last participant still answering
+    ExamChange submit(int room_id, int user_id, const std::vector<std::pair<int, std::string>>& answers,
+                      bool& all_submitted);
+    
+    // Undo submit() whose answers could not be stored: the sheet is open
+    // again. False if the exam is over or the sheet was not handed in.
+    bool withdraw(int room_id, int user_id);
+    
+    // End the exam: the room leaves the engine, later changes get
+    // NOT_RUNNING. nullptr if it was not running (or already finished).
+    std::shared_ptr<ExamRoom> finish(int room_id);
+    
+    // Put back a room taken out by finish() whose results could not be
+    // stored: closed, so only submissions are taken until the next finish()
+    void restore(const std::shared_ptr<ExamRoom>& room);
+    
+    // Deadline reached: later answer changes get NOT_RUNNING, submissions
+    // still in flight are accepted until finish(). False if not running.
+    bool close(int room_id);
+    
+    bool is_running(int room_id);
+    size_t running_count();
+};
+
+#endif // EXAM_ENGINE_H
@@ -0,0 +1,108 @@
+#ifndef FD_SLAB_H
+#define FD_SLAB_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+// Dense fd-indexed table of per-connection state.
+// A lookup is a bounds check plus two array indexes (no tree walk).
+// Slots live in fixed-size pages, so pointers stay valid while the table
+// grows. Every slot carries a generation counter bumped on insert and
+// erase: a (fd, generation) pair captured earlier detects that the fd
+// was closed and reused by a newer connection.
+template <typename T>
+class FdSlab {
+private:
+    static const int PAGE_BITS = 10;
+    static const int PAGE_SIZE = 1 << PAGE_BITS;
+    
+    struct Slot {
+        T value;
+        uint32_t generation = 0;
+        bool live = false;
+    };
+    
+    std::vector<std::unique_ptr<Slot[]>> pages;
+    size_t live_count = 0;
+    
+    Slot* slot(int fd) const {
+        if (fd < 0) {
+            return nullptr;
+        }
+        size_t page = static_cast<size_t>(fd) >> PAGE_BITS;
+        if (page >= pages.size()) {
+            return nullptr;
+        }
+        return &pages[page][fd & (PAGE_SIZE - 1)];
+    }
+
+public:
+    // Live entry for fd, or nullptr
+    T* find(int fd) const {
+        Slot* s = slot(fd);
+        return (s && s->live) ? &s->value : nullptr;
+    }
+    
+    // Live entry for fd only if it still has the given generation
+    T* find(int fd, uint32_t generation) const {
+        Slot* s = slot(fd);
+        return (s && s->live && s->generation == generation) ? &s->value : nullptr;
+    }
+    
+    // Create (or reset) the entry for fd
+    T& insert(int fd) {
+        size_t page = static_cast<size_t>(fd) >> PAGE_BITS;
+        while (pages.size() <= page) {
+            pages.emplace_back(new Slot[PAGE_SIZE]);
+        }
+        Slot* s = slot(fd);
+        if (!s->live) {
+            live_count++;
+        }
+        s->value = T();
+        s->generation++;
+        s->live = true;
+        return s->value;
+    }
+    
+    void erase(int fd) {
+        Slot* s = slot(fd);
+        if (!s || !s->live) {
+            return;
+        }
+        s->value = T();   // Release buffers now, not on reuse
+        s->generation++;
+        s->live = false;
+        live_count--;
+    }
+    
+    // Current generation of the slot (0 if never used)
+    uint32_t generation(int fd) const {
+        Slot* s = slot(fd);
+        return s ? s->generation : 0;
+    }
+    
+    size_t size() const { return live_count; }
+    
+    // Visit every live entry: f(fd, value)
+    template <typename F>
+    void for_each(F f) const {
+        for (size_t page = 0; page < pages.size(); ++page) {
+            for (int i = 0; i < PAGE_SIZE; ++i) {
+                Slot& s = pages[page][i];
+                if (s.live) {
+                    f(static_cast<int>((page << PAGE_BITS) | i), s.value);
+                }
+            }
+        }
+    }
+    
+    void clear() {
+        pages.clear();
+        live_count = 0;
+    }
+};
+
+#endif // FD_SLAB_H
@@ -0,0 +1,96 @@
+#ifndef GRADER_H
+#define GRADER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Encoded option: 0..3 for a..d
+#define OPTION_NONE 0xFF    // Unanswered, unknown question or invalid choice
+
+// Answer sheets of a room as a dense matrix: row p holds participant p's
+// encoded answers, one byte per question. Rows are padded with OPTION_NONE
+// to a multiple of 64 questions so a row grades into whole bitmap words.
+class AnswerSheets {
+private:
+    size_t participant_count = 0;
+    size_t question_count = 0;
+    size_t row_stride = 0;
+    std::vector<uint8_t> cells;
+
+public:
+    // Every answer OPTION_NONE
+    void reset(size_t participants, size_t questions);
+    
+    size_t participants() const { return participant_count; }
+    size_t questions() const { return question_count; }
+    size_t stride() const { return row_stride; }
+    
+    uint8_t* row(size_t participant) { return cells.data() + participant * row_stride; }
+    const uint8_t* row(size_t participant) const { return cells.data() + participant * row_stride; }
+    void set(size_t participant, size_t question, uint8_t option) { row(participant)[question] = option; }
+};
+
+// Result of grading AnswerSheets: a score and a correctness bitmap per sheet
+struct SheetGrades {
+    std::vector<uint32_t> scores;
+    std::vector<uint64_t> bitmaps;     // words_per_sheet words per participant
+    size_t words_per_sheet = 0;
+    
+    bool is_correct(size_t participant, size_t question) const {
+        return (bitmaps[participant * words_per_sheet + question / 64] >> (question % 64)) & 1;
+    }
+};
+
+enum class GradeKernel {
+    AUTO,       // Best one the CPU supports
+    SCALAR,
+    SSE2,
+    AVX2
+};
+
+// Answers and answer keys as one byte per question, compared in one pass
+class Grader {
+public:
+    // "option_a" (client form) or "a" (stored form) -> 0; anything else -> OPTION_NONE
+    static uint8_t encode_option(const std::string& option);
+    
+    // Positions where selected[i] == key[i]; OPTION_NONE never matches
+    static size_t grade(const uint8_t* selected, const uint8_t* key, size_t count);
+    
+    // Every sheet against key[0..questions): byte compares 16 (SSE2) or 32
+    // (AVX2) answers at a time, movemask into the bitmap, popcount for the
+    // score. All kernels give identical results; an unsupported one falls
+    // back to the scalar loop.
+    static void grade_sheets(const AnswerSheets& sheets, const uint8_t* key, SheetGrades& grades,
+                             GradeKernel kernel = GradeKernel::AUTO);
+    
+    // What AUTO resolves to on this CPU
+    static GradeKernel best_kernel();
+    static bool kernel_supported(GradeKernel kernel);
+    static const char* kernel_name(GradeKernel kernel);
+};
+
+// Correct option of every question, by id: a whole submission's key comes
+// from one lookup instead of a query per answer. Database loads it with
+// the question index and updates it on create/update/delete.
+class AnswerKeyTable {
+private:
+    std::shared_mutex mutex;
+    std::unordered_map<int, uint8_t> keys;
+
+public:
+    void set(int question_id, const std::string& correct_option);
+    void remove(int question_id);
+    void clear();
+    
+    // key[i] = correct option of question_ids[i] (OPTION_NONE if unknown)
+    void lookup(const std::vector<int>& question_ids, std::vector<uint8_t>& key);
+    
+    size_t size();
+};
+
+#endif // GRADER_H
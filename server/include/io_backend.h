@@ -0,0 +1,72 @@
+#ifndef IO_BACKEND_H
+#define IO_BACKEND_H
+
+#include <string>
+#include <vector>
+#include "protocol.h"
+
+// Network backends selectable at startup (--io)
+enum IoBackendKind {
+    IO_BACKEND_EPOLL,   // Readiness: epoll + recv()/sendmsg() per connection
+    IO_BACKEND_URING    // Completion: io_uring multishot accept/recv, linked sends
+};
+
+// What the backend reports to the event loop
+enum IoEventType {
+    IO_LISTEN_READY,    // Listening socket readable: accept4() in a loop (epoll)
+    IO_ACCEPTED,        // New connection already accepted, fd = socket or -errno (io_uring)
+    IO_WAKEUP,          // Wakeup eventfd signalled
+    IO_TIMER,           // Timer timerfd expired
+    IO_READABLE,        // Socket readable: drain it with FrameDecoder::fill (epoll)
+    IO_WRITABLE,        // Socket writable again: flush the OutputQueue (epoll)
+    IO_DATA,            // Bytes received into a backend buffer (io_uring)
+    IO_CLOSED,          // Peer closed or receive failed (io_uring)
+    IO_SENT             // Asynchronous send finished: consume bytes, error if failed (io_uring)
+};
+
+struct IoEvent {
+    IoEventType type;
+    int fd;
+    const char* data;   // IO_DATA: valid until the next wait()
+    size_t length;      // IO_DATA: bytes received, IO_SENT: bytes written
+    bool error;         // IO_SENT: send failed, the connection must be closed
+};
+
+// Network I/O behind the event loop. Server only sees IoEvents and calls
+// flush(); how bytes move (readiness + syscalls, or submitted operations
+// and completions) is up to the backend. Used from the owning worker only.
+class IoBackend {
+public:
+    virtual ~IoBackend() {}
+    
+    virtual const char* name() const = 0;
+    
+    // Watch the listening socket, the wakeup eventfd and the timer timerfd.
+    // Syscalls are counted into stats (owned by the caller).
+    virtual bool setup(int listen_fd, int wakeup_fd, int timer_fd, IoStats* stats) = 0;
+    
+    // Start / stop watching a connection (remove before close())
+    virtual bool add_client(int fd) = 0;
+    virtual void remove_client(int fd) = 0;
+    
+    // Stop / restart receiving on a connection whose input buffer is full.
+    // Only io_uring needs it: epoll reads on demand and never runs ahead.
+    virtual void pause_recv(int fd) = 0;
+    virtual void resume_recv(int fd) = 0;
+    
+    // Collect events; timeout_ms is -1 (block until one) or 0 (poll).
+    // Returns false on a fatal error.
+    virtual bool wait(std::vector<IoEvent>& events, int timeout_ms) = 0;
+    
+    // Start writing queued frames. SEND_PENDING: the rest follows on
+    // IO_WRITABLE (epoll) or IO_SENT (io_uring)
+    virtual SendResult flush(int fd, OutputQueue& queue) = 0;
+    
+    // Create a backend (io_uring falls back to epoll if the kernel lacks support)
+    static IoBackend* create(IoBackendKind kind);
+    
+    // "epoll" / "uring"
+    static bool parse_kind(const std::string& name, IoBackendKind& kind);
+};
+
+#endif // IO_BACKEND_H
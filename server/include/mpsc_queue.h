@@ -0,0 +1,67 @@
+#ifndef MPSC_QUEUE_H
+#define MPSC_QUEUE_H
+
+#include <atomic>
+#include <utility>
+#include <vector>
+
+// Lock-free multi-producer / single-consumer queue.
+// Producers push onto an atomic list head (one CAS, never blocks); the
+// single consumer detaches the whole list at once and reverses it, so
+// items come out in push order. No ABA: nodes are never popped one by one.
+template <typename T>
+class MpscQueue {
+private:
+    struct Node {
+        T value;
+        Node* next;
+    };
+    
+    std::atomic<Node*> head;
+
+public:
+    MpscQueue() : head(nullptr) {}
+    
+    ~MpscQueue() {
+        std::vector<T> dropped;
+        pop_all(dropped);
+    }
+    
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+    
+    // Any thread
+    void push(T value) {
+        Node* node = new Node{std::move(value), head.load(std::memory_order_relaxed)};
+        while (!head.compare_exchange_weak(node->next, node,
+                                           std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+        }
+    }
+    
+    // Consumer thread only: append everything queued so far, oldest first
+    void pop_all(std::vector<T>& out) {
+        Node* node = head.exchange(nullptr, std::memory_order_acquire);
+        
+        Node* reversed = nullptr;
+        while (node) {
+            Node* next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+        
+        while (reversed) {
+            Node* next = reversed->next;
+            out.push_back(std::move(reversed->value));
+            delete reversed;
+            reversed = next;
+        }
+    }
+    
+    bool empty() const {
+        return head.load(std::memory_order_acquire) == nullptr;
+    }
+};
+
+#endif // MPSC_QUEUE_H
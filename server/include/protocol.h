@@ -3,6 +3,10 @@
 
 #include <stdint.h>
 #include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <sys/uio.h>
 #include <nlohmann/json.hpp>
 
 using json = nlohmann::json;
@@ -86,20 +90,151 @@ enum RecvResult {
     RECV_SUCCESS,      // Message received successfully
     RECV_NO_DATA,      // No data available (EAGAIN), connection OK
     RECV_ERROR,        // Error or connection closed
-    RECV_INCOMPLETE    // Partial data received (should not happen with proper implementation)
+    RECV_INCOMPLETE    // Partial frame buffered, wait for more data
+};
+
+// Send result enum (non-blocking output queue)
+enum SendResult {
+    SEND_DONE,         // Everything queued has been written
+    SEND_PENDING,      // Kernel buffer full (EAGAIN), rest stays queued
+    SEND_ERROR         // Socket error or connection closed
+};
+
+// Maximum accepted payload size (2MB, to prevent DoS)
+#define MAX_PAYLOAD_SIZE (2 * 1024 * 1024)
+
+struct IoStats;
+
+// Incremental frame decoder, one per connection.
+// Bytes are appended as they arrive and complete frames are extracted
+// with a header -> payload state machine, so a partial frame never
+// blocks the event loop: decoding resumes on the next EPOLLIN.
+class FrameDecoder {
+public:
+    enum State {
+        READ_HEADER,   // Waiting for the 6-byte header
+        READ_PAYLOAD   // Header parsed, waiting for payload_length bytes
+    };
+    
+    FrameDecoder();
+    
+    // Read everything currently available on a non-blocking socket, or stop
+    // once max_buffered bytes are buffered (0 = no limit).
+    // Returns: RECV_SUCCESS if bytes were read, RECV_NO_DATA on EAGAIN with
+    //          nothing read, RECV_ERROR on EOF or socket error
+    RecvResult fill(int sockfd, size_t max_buffered = 0, IoStats* stats = nullptr);
+    
+    // Append raw bytes (used by fill and by tests)
+    void feed(const char* data, size_t length);
+    
+    // Extract the next complete message.
+    // Returns: RECV_SUCCESS if msg was filled, RECV_INCOMPLETE if more bytes
+    //          are needed, RECV_ERROR on an invalid frame
+    RecvResult next(Message& msg);
+    
+    // True if next() would return a message (or report an invalid frame)
+    bool has_frame() const;
+    
+    State state() const { return current_state; }
+    size_t buffered() const { return buffer.size() - read_pos; }
+    
+private:
+    std::vector<char> buffer;
+    size_t read_pos;
+    State current_state;
+    uint16_t msg_type;
+    uint32_t payload_length;
+    
+    // Drop consumed bytes from the front of the buffer
+    void compact();
+};
+
+// I/O counters (syscalls per message)
+struct IoStats {
+    uint64_t messages_queued = 0;   // Frames handed to an OutputQueue
+    uint64_t send_calls = 0;        // sendmsg() syscalls issued
+    uint64_t bytes_sent = 0;
+    uint64_t recv_calls = 0;        // recv() syscalls issued
+    uint64_t wait_calls = 0;        // epoll_wait() / io_uring_enter()
+    uint64_t other_calls = 0;       // accept4(), epoll_ctl(), ...
+    
+    uint64_t syscalls() const { return send_calls + recv_calls + wait_calls + other_calls; }
+};
+
+// Serialized JSON payload, immutable once built. A broadcast serializes once
+// and every member's queue holds a reference to the same buffer.
+typedef std::shared_ptr<const std::string> SharedPayload;
+
+// Queued outbound frame: header and payload are separate buffers,
+// written together with one vectored send
+struct OutFrame {
+    char header[6];
+    SharedPayload payload;
+    
+    size_t size() const { return 6 + payload->size(); }
+};
+
+// Outbound byte queue, one per connection.
+// Frames are queued whole; flush() writes as many as possible with a single
+// sendmsg() per call (header + payload of every queued frame as iovecs) and
+// keeps the remainder (with a partial-write offset) for EPOLLOUT.
+class OutputQueue {
+public:
+    OutputQueue();
+    
+    // Append a message (payload is the serialized JSON)
+    void push(uint16_t msg_type, std::string payload);
+    
+    // Append a message sharing an already serialized payload (zero-copy)
+    void push(uint16_t msg_type, const SharedPayload& payload);
+    
+    // Write queued bytes until empty or EAGAIN (never blocks)
+    SendResult flush(int sockfd, IoStats* stats = nullptr);
+    
+    // Asynchronous sends (io_uring): copy up to max_frames queued frames
+    // (headers copied, payloads shared) so the kernel never points into the
+    // queue, then consume() what the completion reports as written
+    size_t snapshot(std::vector<OutFrame>& out, size_t max_frames) const;
+    size_t head_written() const { return head_offset; }
+    
+    // Drop n written bytes from the front of the queue
+    void consume(size_t n);
+    
+    // Point iovecs at frames[0..count), skipping the first head_offset bytes.
+    // Returns the number of iovecs used (2 per frame at most).
+    static size_t gather(const OutFrame* frames, size_t count, size_t head_offset,
+                         struct iovec* iov, size_t max_iovecs);
+    
+    size_t pending() const { return pending_bytes; }
+    size_t frame_count() const { return frames.size(); }
+    bool empty() const { return frames.empty(); }
+    
+private:
+    std::deque<OutFrame> frames;
+    size_t head_offset;      // Bytes of frames.front() already written
+    size_t pending_bytes;    // Total unwritten bytes
 };
 
 class Protocol {
 public:
     // Send message: [Type][Length][JSON Payload]
+    // Loops until written: for blocking sockets and tools, the server
+    // event loop queues frames in the connection's OutputQueue instead
     static bool send_message(int sockfd, uint16_t msg_type, const json& payload);
     
+    // Write the 6-byte header (network byte order) into header
+    static void write_header(char* header, uint16_t msg_type, uint32_t payload_length);
+    
+    // Serialize a payload once into a shareable buffer
+    static SharedPayload serialize(const json& payload);
+    
     // Receive message: [Type][Length][JSON Payload]
     // Returns: RECV_SUCCESS if message received, RECV_NO_DATA if no data (EAGAIN),
     //          RECV_ERROR if error or connection closed
     static RecvResult recv_message(int sockfd, Message& msg);
     
-    // Helper: receive exact N bytes
+    // Helper: receive exact N bytes (never waits: a non-blocking socket
+    // returning EAGAIN fails the call, use FrameDecoder for partial frames)
     // Returns: true if all bytes received, false if error or EAGAIN
     static bool recv_exact(int sockfd, char* buffer, size_t length);
     
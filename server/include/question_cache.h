@@ -0,0 +1,148 @@
+#ifndef QUESTION_CACHE_H
+#define QUESTION_CACHE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <nlohmann/json.hpp>
+
+using json = nlohmann::json;
+
+// Number of independently locked shards (power of two)
+#define QUESTION_CACHE_SHARDS 16
+
+// Default QuestionCache capacity in questions (--question-cache)
+#define DEFAULT_QUESTION_CACHE_SIZE 100000
+
+// Answer options 'a'..'d' of a question. Stored as the JSON object
+// {"a": "...", ...} in Questions.options, decoded once when the row is read.
+struct QuestionOptions {
+    static const int COUNT = 4;
+    
+    std::array<std::string, COUNT> text;
+    uint8_t present = 0;    // Bit i: option 'a' + i exists
+    
+    bool has(int i) const { return (present >> i) & 1; }
+    static char key(int i) { return static_cast<char>('a' + i); }
+    
+    void set(int i, const std::string& value) {
+        text[i] = value;
+        present |= static_cast<uint8_t>(1 << i);
+    }
+    
+    // Keys other than a..d are ignored; non-string values keep their JSON text
+    static QuestionOptions from_json(const json& options) {
+        QuestionOptions result;
+        if (!options.is_object()) {
+            return result;
+        }
+        for (int i = 0; i < COUNT; i++) {
+            auto it = options.find(std::string(1, key(i)));
+            if (it != options.end()) {
+                result.set(i, it->is_string() ? it->get<std::string>() : it->dump());
+            }
+        }
+        return result;
+    }
+    
+    json to_json() const {
+        json options = json::object();
+        for (int i = 0; i < COUNT; i++) {
+            if (has(i)) {
+                options[std::string(1, key(i))] = text[i];
+            }
+        }
+        return options;
+    }
+};
+
+// Question structure
+struct Question {
+    int question_id;
+    std::string content;
+    QuestionOptions options;
+    std::string correct_option;
+    std::string difficulty;
+    std::string topic;
+    int created_by;
+    
+    // What clients see of it, serialized (QuestionPayload::client_json);
+    // set when the row is decoded, shared by every copy
+    std::shared_ptr<const std::string> client_json;
+};
+
+struct QuestionCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;         // Least recently used, dropped to stay in capacity
+    uint64_t invalidations = 0;     // Dropped by update/delete
+    size_t size = 0;
+    size_t capacity = 0;
+    
+    double hit_rate() const {
+        uint64_t lookups = hits + misses;
+        return lookups ? static_cast<double>(hits) / lookups : 0.0;
+    }
+};
+
+// Decoded questions by id, shared by every thread that reads questions.
+// Each of QUESTION_CACHE_SHARDS shards has its own mutex and LRU list
+// holding capacity / QUESTION_CACHE_SHARDS entries. Database fills it on
+// reads (and at startup) and erases an id when its row changes.
+//
+// A row read concurrently with an update could put the old version back
+// after the erase: readers take a stamp() before querying and put(q, stamp)
+// is dropped if any question was invalidated in between.
+class QuestionCache {
+private:
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::list<Question> lru;    // Most recently used first
+        std::unordered_map<int, std::list<Question>::iterator> entries;
+    };
+    
+    Shard shards[QUESTION_CACHE_SHARDS];
+    std::atomic<size_t> shard_capacity;
+    std::atomic<uint64_t> generation{0};    // Bumped by every erase/clear
+    
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> evictions{0};
+    std::atomic<uint64_t> invalidations{0};
+    
+    Shard& shard_for(int question_id);
+    void insert_locked(Shard& shard, const Question& question);
+
+public:
+    explicit QuestionCache(size_t capacity = DEFAULT_QUESTION_CACHE_SIZE);
+    
+    // 0 disables the cache; shrinking evicts
+    void set_capacity(size_t capacity);
+    size_t capacity() const;
+    
+    // Copy of the cached question (counts a hit or a miss)
+    bool get(int question_id, Question& question);
+    
+    // Take before reading rows from the database
+    uint64_t stamp() const { return generation.load(std::memory_order_acquire); }
+    
+    // Cache a row read after stamp(); dropped if anything was invalidated since
+    void put(const Question& question, uint64_t stamp);
+    
+    // Cache a row known to be current (just written, or loaded at startup)
+    void put(const Question& question);
+    
+    // The row changed or is gone
+    void erase(int question_id);
+    
+    void clear();
+    
+    QuestionCacheStats get_stats();
+};
+
+#endif // QUESTION_CACHE_H
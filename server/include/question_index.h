@@ -0,0 +1,54 @@
+#ifndef QUESTION_INDEX_H
+#define QUESTION_INDEX_H
+
+#include <cstddef>
+#include <map>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// In-memory index of question ids partitioned by (topic, difficulty).
+// Replaces ORDER BY RANDOM(), which sorted every matching row of the bank
+// on each request: sample(k) draws k distinct ids uniformly from the
+// matching partitions in O(k) (Floyd's algorithm, or a partial
+// Fisher-Yates shuffle when k is close to the match count). Database
+// keeps it in step with the Questions table on create/update/delete.
+// Samples run in parallel; changes take the lock exclusively.
+class QuestionIndex {
+private:
+    typedef std::pair<std::string, std::string> PartitionKey;     // topic, difficulty
+    typedef std::vector<int> Partition;
+    
+    // Where an id sits, for O(1) removal (the last id moves into its slot)
+    struct Location {
+        Partition* partition;
+        size_t position;
+    };
+    
+    std::shared_mutex mutex;
+    std::map<PartitionKey, Partition> partitions;   // std::map: Partition* stays valid
+    std::unordered_map<int, Location> locations;
+    
+    void remove_locked(int question_id);
+
+public:
+    // Insert, or move to another partition if already indexed
+    void add(int question_id, const std::string& topic, const std::string& difficulty);
+    
+    void remove(int question_id);
+    
+    void clear();
+    
+    // Up to `count` distinct ids in random order; "all" or "" matches any
+    // topic/difficulty. Fewer when fewer questions match.
+    std::vector<int> sample(int count, const std::string& topic, const std::string& difficulty);
+    
+    // Number of ids matching the filter (same wildcard rules as sample)
+    size_t count(const std::string& topic, const std::string& difficulty);
+    
+    size_t size();
+};
+
+#endif // QUESTION_INDEX_H
@@ -0,0 +1,25 @@
+#ifndef QUESTION_PAYLOAD_H
+#define QUESTION_PAYLOAD_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "protocol.h"
+#include "question_cache.h"
+
+// Question lists sent to clients (S2C_PRACTICE_QUESTIONS, S2C_TEST_STARTED).
+// The client-facing form of a question (no correct answer) never changes,
+// so it is serialized once when the row is decoded and kept in
+// Question::client_json (and so in the QuestionCache). A payload is then
+// the other fields plus the fragments joined into one buffer, without
+// building or dumping a json tree per question.
+class QuestionPayload {
+public:
+    // {"content":...,"option_a":...,...,"q_id":...} (keys in json::dump order)
+    static std::shared_ptr<const std::string> client_json(const Question& question);
+    
+    // `fields` (an object) with "questions": [fragments...] appended
+    static SharedPayload build(const json& fields, const std::vector<Question>& questions);
+};
+
+#endif // QUESTION_PAYLOAD_H
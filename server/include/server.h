@@ -4,50 +4,358 @@
 #include <string>
 #include <map>
 #include <set>
-#include <sys/epoll.h>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <memory>
 #include "database.h"
 #include "protocol.h"
+#include "fd_slab.h"
+#include "mpsc_queue.h"
+#include "task_pool.h"
+#include "io_backend.h"
+#include "session_cache.h"
+#include "token_signer.h"
+#include "answer_writer.h"
+#include "question_payload.h"
+#include "exam_engine.h"
+#include "timer_wheel.h"
 
-#define MAX_EVENTS 64
 #define BUFFER_SIZE 4096
 
+// Default listen() backlog (the kernel caps it at net.core.somaxconn)
+#define DEFAULT_LISTEN_BACKLOG 4096
+
+// Connections accepted per listening-socket event before other fds get a turn
+// (the listening socket is level-triggered, the rest is picked up next tick)
+#define MAX_ACCEPTS_PER_EVENT 256
+
+// Messages handled per connection per round; a connection with more
+// buffered work goes back on the ready list behind everyone else
+#define MESSAGE_BUDGET_PER_ROUND 16
+
+// Unread bytes buffered per connection before reading pauses
+// (a frame being assembled may always complete)
+#define INPUT_BUFFER_LIMIT (256 * 1024)
+
+// Unsent bytes allowed per connection before a slow reader is dropped
+#define OUTPUT_HIGH_WATER_MARK (8 * 1024 * 1024)
+
+// Timer wheel resolution (timers fire up to one tick late)
+#define TIMER_TICK_MS 100
+
+// Session purge and stats logging interval
+#define HOUSEKEEPING_INTERVAL_MS 10000
+
+// After an exam's end_timestamp, SUBMIT_TEST still in flight is accepted
+// for this long before the room is graded (answer changes are not)
+#define EXAM_GRACE_SECONDS 2
+
+// Retry interval when an exam's results could not be stored
+#define EXAM_FINISH_RETRY_MS 1000
+
+// What a TimerEvent is for (TimerEvent::kind)
+enum TimerKind {
+    TIMER_HOUSEKEEPING,     // Periodic cleanup and stats
+    TIMER_EXAM_DEADLINE,    // key = room_id: time is up, close the sheets
+    TIMER_EXAM_GRACE,       // key = room_id: grace period over, grade the room
+    TIMER_EXAM_RETRY,       // key = room_id: storing the results failed, grade again
+    TIMER_IDLE              // key = fd, generation = slab generation
+};
+
+// Login state of a connection. Requests on a logged-in connection that
+// carry its token (or none) are authorized from here without a lookup.
+struct ConnectionAuth {
+    std::string session_token;
+    int user_id = -1;       // -1: not logged in
+    std::string role;
+    time_t expiry = 0;      // Session expiry (epoch seconds)
+    uint64_t revision = 0;  // SessionCache::revision() when last checked
+};
+
 // Client connection info
 struct ClientInfo {
-    int sockfd;
-    std::string session_token;
-    int user_id;
+    int sockfd = -1;
+    ConnectionAuth auth;
     std::string username;
-    std::string role;
+    std::set<int> rooms;    // Rooms joined on this connection (reverse of room_clients)
+    FrameDecoder decoder;   // Partial inbound frame state, resumed on next EPOLLIN
+    OutputQueue outbox;     // Unsent outbound bytes, flushed on EPOLLOUT
+    bool flush_scheduled = false; // Listed in dirty_fds for the end-of-tick flush
+    bool busy = false;      // Handler running on the task pool; later frames wait in decoder
+    bool recv_pending = false;  // Socket may hold unread bytes (edge seen, not drained)
+    bool recv_paused = false;   // io_uring receive stopped at the input limit
+    bool input_closed = false;  // Peer closed; disconnect once buffered frames are handled
+    bool ready_listed = false;  // Queued on the ready list
+    bool closing = false;   // Scheduled for disconnect at end of loop iteration
+    time_t last_active = 0;     // loop_clock of the last bytes received
+    TimerId idle_timer = 0;     // Armed with --idle-timeout
+};
+
+// Accept-path counters (logged periodically)
+struct AcceptStats {
+    uint64_t accepted = 0;          // Connections taken from the accept queue
+    uint64_t batches = 0;           // Listening-socket events drained
+    uint64_t queue_full = 0;        // Batches that found the accept queue at its backlog limit
+    uint32_t max_queue = 0;         // Deepest accept queue seen (TCP_INFO)
+    uint64_t shed = 0;              // Accepted then closed because fds ran out
+    uint64_t errors = 0;
+};
+
+// Reply captured while a handler ran on the task pool
+struct QueuedReply {
+    uint16_t msg_type;
+    SharedPayload payload;
+};
+
+// Room broadcast made while a handler ran on the task pool
+struct QueuedBroadcast {
+    int room_id;
+    uint16_t msg_type;
+    SharedPayload payload;
+};
+
+// Finished task pool handler, returned to the owning worker
+struct TaskCompletion {
+    int client_fd;
+    uint32_t generation;    // Slab generation at submit time (detects a closed fd)
+    std::vector<QueuedReply> replies;
+    
+    // Set by a successful login: bound to the connection before the replies go out
+    bool logged_in = false;
+    ConnectionAuth auth;
+    std::string username;
+    
+    // Set by JOIN_ROOM / LOGOUT: room membership added, login cleared
+    // (if still bound to the token) before the replies go out
+    int joined_room_id = 0;
+    bool logged_out = false;
+    std::string logout_token;
+    
+    // Set by START_TEST: the exam deadline, armed on the event loop
+    // (also when the connection closed meanwhile)
+    int exam_room_id = 0;
+    uint64_t exam_deadline_ms = 0;
+    
+    // Sent after the replies, so a member added above gets them too
+    // (also when the connection closed meanwhile)
+    std::vector<QueuedBroadcast> broadcasts;
+};
+
+// Serialized payload per user_id (exam results: one message each)
+typedef std::unordered_map<int, SharedPayload> UserPayloads;
+
+// Broadcast forwarded from another worker (room_id = -1 means all clients).
+// The payload is serialized once by the sender and shared by every worker.
+// With per_user set, each member gets its own user's payload instead.
+struct RoomBroadcast {
+    int room_id;
+    uint16_t msg_type;
+    SharedPayload payload;
+    std::shared_ptr<const UserPayloads> per_user;
 };
 
 class Server {
 private:
     int server_fd;
-    int epoll_fd;
+    int wakeup_fd;      // eventfd signalled when a peer posts to inbox
+    int timer_fd;       // timerfd set to the wheel's next expiry
     int port;
+    int backlog;        // listen() backlog
+    int spare_fd;       // Reserved fd, released to shed connections on EMFILE
+    int worker_id;
+    bool reuse_port;    // SO_REUSEPORT so every worker owns a listening socket
     Database* db;
+    IoBackendKind io_kind;
+    std::unique_ptr<IoBackend> io;     // epoll or io_uring (--io)
+    std::atomic<bool> running;
+    
+    // Deadlines, idle connections and housekeeping, in TIMER_TICK_MS ticks
+    // of CLOCK_MONOTONIC; timer_fd is re-armed only when the next expiry changes
+    TimerWheel timers;
+    uint64_t timer_fd_tick;     // Tick timer_fd is set for (UINT64_MAX = disarmed)
+    std::vector<TimerEvent> fired_timers;
+    
+    // Close connections silent for this long (seconds, 0 = never)
+    int idle_timeout;
+    
+    // Other workers of the same process (for cross-worker broadcasts)
+    std::vector<Server*> peers;
+    
+    // Runs database-bound handlers off the event loop (nullptr = inline)
+    TaskPool* task_pool;
+    
+    // Runs password hashing (register/login) off the event loop and off
+    // the database pool, so a login storm cannot starve either (nullptr = inline)
+    TaskPool* hash_pool;
+    
+    // Sessions shared by all workers (nullptr = always ask the database)
+    SessionCache* session_cache;
+    
+    // Signs and verifies stateless tokens (nullptr = database sessions)
+    TokenSigner* token_signer;
+    
+    // Batches answer writes (nullptr = one autocommit write per answer)
+    AnswerWriter* answer_writer;
+    
+    // Running exams (shared by all workers; nullptr = exams disabled)
+    ExamEngine* exam_engine;
+    AnswerWriterStats answer_stats_logged;
+    QuestionCacheStats question_stats_logged;
+    
+    // time() sampled once per loop iteration, for session expiry checks
+    // (read by pool threads too)
+    std::atomic<time_t> loop_clock;
+    
+    // Finished pool handlers, pushed by pool threads, drained on wakeup_fd
+    MpscQueue<TaskCompletion> completions;
+    
+    // Broadcasts posted by peers and timers posted by other threads
+    // (delay_ms, event), drained on this worker's thread
+    std::mutex inbox_mutex;
+    std::vector<RoomBroadcast> inbox;
+    std::vector<std::pair<uint64_t, TimerEvent>> posted_timers;
+    
+    // Connections to close once the current loop iteration is done,
+    // as (fd, slab generation) so a reused fd is never closed by mistake
+    std::vector<std::pair<int, uint32_t>> pending_close;
+    
+    // Connections with output queued during the current loop iteration
+    std::vector<int> dirty_fds;
+    
+    // Connections with buffered frames or unread input left after their
+    // round, as (fd, slab generation); served again next iteration
+    std::vector<std::pair<int, uint32_t>> ready_list;
+    
+    // Send-path counters (logged periodically)
+    IoStats io_stats;
+    IoStats io_stats_logged;
     
-    // Map socket fd -> ClientInfo
-    std::map<int, ClientInfo> clients;
+    // Accept-path counters
+    AcceptStats accept_stats;
+    AcceptStats accept_stats_logged;
+    uint64_t listen_overflows_logged;   // TcpExt ListenOverflows at last log
     
-    // Map room_id -> set of socket fds (for broadcasting)
+    // Socket fd -> ClientInfo (dense, indexed directly by fd)
+    FdSlab<ClientInfo> clients;
+    
+    // Map room_id -> set of socket fds (for broadcasting).
+    // Entries are removed when their last member leaves.
     std::map<int, std::set<int>> room_clients;
     
     // Setup server socket
     bool setup_server_socket();
     
-    // Setup epoll
-    bool setup_epoll();
+    // Create the wakeup eventfd, the timerfd and the I/O backend
+    bool setup_io();
+    
+    // Drain broadcasts posted by peers and posted timers
+    void handle_inbox();
+    
+    // Close all sockets owned by this worker
+    void close_all();
     
-    // Accept new connection
+    // Accept pending connections (up to MAX_ACCEPTS_PER_EVENT)
     void handle_new_connection();
     
+    // Register an accepted socket with the I/O backend and the client table
+    void add_client(int client_fd);
+    
     // Handle client disconnect
     void handle_client_disconnect(int client_fd);
     
     // Handle client message
     void handle_client_message(int client_fd);
     
+    // One scheduling round: read (bounded), handle up to the message budget,
+    // requeue on the ready list if work is left
+    void service_client(int client_fd);
+    void schedule_ready(int client_fd, ClientInfo& client);
+    void run_ready_round(const std::vector<std::pair<int, uint32_t>>& round);
+    
+    // Dispatch up to MESSAGE_BUDGET_PER_ROUND buffered frames
+    // (stops early when none is complete or a handler is offloaded)
+    void process_messages(int client_fd);
+    
+    // Route a decoded message to its handler
+    void dispatch_message(int client_fd, Message& msg);
+    
+    // Run a handler on a pool; the connection stays busy until it completes
+    typedef void (Server::*Handler)(int client_fd, const json& payload);
+    Handler pool_handler(uint16_t msg_type) const;
+    static Handler hash_handler(uint16_t msg_type);
+    void offload_message(int client_fd, ClientInfo& client, TaskPool* pool, Handler handler, Message& msg);
+    
+    // Attach a login to the connection (deferred to the completion on a pool thread)
+    void bind_login(int client_fd, const ConnectionAuth& auth, const std::string& username);
+    
+    // Detach a logged-out token from the connection, and add the connection
+    // to a room's members (both deferred to the completion on a pool thread)
+    void clear_login(int client_fd, const std::string& session_token);
+    void add_room_member(int client_fd, int room_id);
+    
+    // Deliver replies of finished pool handlers and resume their connections
+    void handle_completions();
+    
+    // Signal wakeup_fd (any thread)
+    void wake();
+    
+    // Flush queued output when the socket becomes writable
+    void handle_client_writable(int client_fd);
+    
+    // io_uring: bytes received into a backend buffer, an async send finished
+    void handle_client_data(int client_fd, const char* data, size_t length);
+    void handle_client_sent(int client_fd, size_t written, bool failed);
+    
+    // Queue a message on the connection's outbox (flushed at end of tick)
+    void send_message(int client_fd, uint16_t msg_type, const json& payload);
+    
+    // send_message for a payload serialized by the caller
+    void send_serialized(int client_fd, uint16_t msg_type, const SharedPayload& payload);
+    
+    // Queue an already serialized payload (shared, no copy; event loop only)
+    void send_shared(int client_fd, uint16_t msg_type, const SharedPayload& payload);
+    
+    // Flush every connection that got output this iteration: all messages
+    // queued for one connection go out in a single sendmsg()
+    void flush_dirty();
+    
+    // Log send-path counters since the last call
+    void log_io_stats();
+    
+    // Log accept-path counters since the last call
+    void log_accept_stats();
+    
+    // Log answer write-behind counters since the last call
+    void log_answer_stats();
+    
+    // Log question cache hit rate since the last call
+    void log_question_cache_stats();
+    
+    // Arm a timer delay_ms from now (event loop only)
+    TimerId schedule_timer(uint64_t delay_ms, TimerKind kind, int key, uint32_t generation = 0);
+    
+    // Arm a timer on this worker's event loop (any thread)
+    void post_timer(uint64_t delay_ms, TimerKind kind, int key);
+    
+    // Arm a room's exam deadline (deferred to the completion on a pool thread)
+    void arm_exam_deadline(int room_id, uint64_t delay_ms);
+    
+    // Fire due timers, then point timer_fd at the next expiry
+    void run_timers();
+    void handle_timer(const TimerEvent& event);
+    
+    // Session purge and stats logging (re-arms itself)
+    void housekeeping();
+    
+    // Close the connection if it has been silent for idle_timeout, else re-arm
+    void check_idle(int client_fd, uint32_t generation);
+    
+    // Deferred disconnect (safe while iterating clients or rooms)
+    void schedule_close(int client_fd);
+    void close_pending();
+    
     // Message handlers
     void handle_register(int client_fd, const json& payload);
     void handle_login(int client_fd, const json& payload);
@@ -70,23 +378,92 @@ private:
     void handle_update_question(int client_fd, const json& payload);
     void handle_delete_question(int client_fd, const json& payload);
     
-    // Helper: validate session and get user info
+    // Helper: validate session and get user info. A logged-in connection
+    // using its own token (or none) is authorized from ConnectionAuth; the
+    // session store is consulted on token mismatch, expiry or revocation.
     bool validate_session(int client_fd, const std::string& session_token, int& user_id, std::string& role);
     
+    // Login state of the connection a handler runs for (ClientInfo on the
+    // event loop, the snapshot taken at offload time on a pool thread)
+    const ConnectionAuth* connection_auth(int client_fd);
+    
     // Helper: broadcast message to all clients in a room
     void broadcast_to_room(int room_id, uint16_t msg_type, const json& payload);
     
     // Helper: broadcast message to all connected clients
     void broadcast_to_all(uint16_t msg_type, const json& payload);
     
+    // Helper: broadcast a payload serialized by the caller (from a pool
+    // thread it is sent with the completion)
+    void broadcast_shared(int room_id, uint16_t msg_type, const SharedPayload& payload);
+    
+    // Helper: send to this worker's local members only
+    void deliver_broadcast(int room_id, uint16_t msg_type, const SharedPayload& payload);
+    void deliver_per_user(int room_id, uint16_t msg_type, const UserPayloads& payloads);
+    
+    // Queue a message for the room on every worker, this one included (any thread)
+    void publish_to_room(int room_id, uint16_t msg_type, const SharedPayload& payload,
+                         const std::shared_ptr<const UserPayloads>& per_user = nullptr);
+    
+    // End a running exam: grade its sheets, store the grades and finish the
+    // room (one transaction), send S2C_TEST_ENDED and each participant's
+    // S2C_YOUR_RESULT (any thread). If the transaction fails nothing is
+    // sent: the room goes back to the engine and is graded again after
+    // EXAM_FINISH_RETRY_MS.
+    void finish_exam(int room_id);
+    
+    // Time is up: close the sheets, grade after EXAM_GRACE_SECONDS
+    void handle_exam_deadline(int room_id);
+    
+    // finish_exam on the task pool (inline without one)
+    void schedule_finish_exam(int room_id);
+    
 public:
-    Server(int port, Database* database);
+    Server(int port, Database* database, int worker_id = 0, bool reuse_port = false,
+           int backlog = DEFAULT_LISTEN_BACKLOG, IoBackendKind io_kind = IO_BACKEND_EPOLL);
     ~Server();
     
-    // Start server (blocking)
+    // Register the other workers of the process
+    void set_peers(const std::vector<Server*>& workers);
+    
+    // Offload database-bound handlers to this pool (shared by all workers)
+    void set_task_pool(TaskPool* pool);
+    
+    // Offload register/login password hashing to this pool (shared by all workers)
+    void set_hash_pool(TaskPool* pool);
+    
+    // Validate sessions against this cache (shared by all workers)
+    void set_session_cache(SessionCache* cache);
+    
+    // Issue HMAC-signed session tokens instead of database sessions
+    void set_token_signer(TokenSigner* signer);
+    
+    // Queue answer changes through this writer (shared by all workers)
+    void set_answer_writer(AnswerWriter* writer);
+    
+    // Run exams in this engine (shared by all workers)
+    void set_exam_engine(ExamEngine* engine);
+    
+    // Close connections that send nothing for this many seconds (0 = never)
+    void set_idle_timeout(int seconds);
+    
+    // Queue a broadcast for this worker's clients (thread-safe)
+    void post_broadcast(int room_id, uint16_t msg_type, const SharedPayload& payload,
+                        const std::shared_ptr<const UserPayloads>& per_user = nullptr);
+    
+    // Create listening socket and I/O backend
+    bool setup();
+    
+    // Syscall counters (read after the loop has stopped)
+    const IoStats& get_io_stats() const { return io_stats; }
+    
+    // Run event loop (blocking)
+    void run();
+    
+    // Start server (setup + run, blocking)
     bool start();
     
-    // Stop server
+    // Stop server (thread-safe, wakes the event loop)
     void stop();
 };
 
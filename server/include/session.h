@@ -3,24 +3,43 @@
 
 #include <string>
 #include <random>
+#include <ctime>
+
+// Lifetime of a login session
+#define SESSION_EXPIRY_SECONDS 86400    // 24 hours
+
+// PBKDF2-HMAC-SHA256 work factor for new password hashes (~45 ms on one core)
+#define DEFAULT_KDF_ITERATIONS 100000
+#define KDF_SALT_BYTES 16
 
 class SessionManager {
 public:
     // Generate random session token
     static std::string generate_token(size_t length = 32);
     
-    // Hash password (simple SHA256 for demo, should use bcrypt in production)
+    // Salted PBKDF2-HMAC-SHA256: "pbkdf2_sha256$<iterations>$<salt hex>$<hash hex>".
+    // CPU-heavy on purpose: call from the hashing pool, not the event loop
     static std::string hash_password(const std::string& password);
     
-    // Verify password against hash
+    // Verify password against a PBKDF2 hash or a legacy unsalted SHA-256 hex hash
     static bool verify_password(const std::string& password, const std::string& hash);
     
+    // Legacy SHA-256 or fewer iterations than configured: rehash at next login
+    static bool needs_rehash(const std::string& hash);
+    
+    // Work factor for new hashes (--kdf-iterations)
+    static void set_kdf_iterations(int iterations);
+    static int kdf_iterations();
+    
     // Get current timestamp in ISO format
     static std::string get_current_timestamp();
     
     // Get timestamp N seconds in the future
     static std::string get_future_timestamp(int seconds);
     
+    // Parse a timestamp written by get_future_timestamp (UTC) to epoch seconds
+    static time_t parse_timestamp(const std::string& timestamp);
+    
     // Check if timestamp is expired
     static bool is_timestamp_expired(const std::string& timestamp);
 };
@@ -0,0 +1,58 @@
+#ifndef SESSION_CACHE_H
+#define SESSION_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Number of independently locked shards (power of two)
+#define SESSION_CACHE_SHARDS 16
+
+// What validate_session needs to know about a session
+struct CachedSession {
+    int user_id = -1;
+    std::string role;
+    time_t expiry = 0;      // Epoch seconds
+};
+
+// In-memory session table: token -> user, role, expiry.
+// Filled on login (and on the first use of a session that is only in the
+// database), dropped on logout and once expired. Shared by every worker
+// and pool thread; a token hashes to one of SESSION_CACHE_SHARDS shards,
+// each with its own mutex, so lookups rarely contend.
+class SessionCache {
+private:
+    struct alignas(64) Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, CachedSession> sessions;
+    };
+    
+    Shard shards[SESSION_CACHE_SHARDS];
+    
+    // Bumped by every erase (logout)
+    std::atomic<uint64_t> revocations{0};
+    
+    Shard& shard_for(const std::string& token);
+
+public:
+    void put(const std::string& token, const CachedSession& session);
+    
+    // False if unknown or expired at `now` (an expired entry is dropped)
+    bool get(const std::string& token, time_t now, CachedSession& session);
+    
+    void erase(const std::string& token);
+    
+    // Changes whenever a session is revoked: a connection that authorized
+    // itself at an older value must re-check its token
+    uint64_t revision() const { return revocations.load(std::memory_order_acquire); }
+    
+    // Drop every entry expired at `now`; returns how many were removed
+    size_t purge_expired(time_t now);
+    
+    size_t size();
+};
+
+#endif // SESSION_CACHE_H
@@ -0,0 +1,70 @@
+#ifndef TASK_POOL_H
+#define TASK_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Default number of task pool threads (0 runs handlers on the event loop)
+#define DEFAULT_POOL_THREADS 4
+
+// Default number of password hashing threads (0 hashes on the event loop)
+#define DEFAULT_HASH_THREADS 2
+
+// Work-stealing thread pool for blocking work (database handlers).
+// Each thread owns a deque: submissions are spread round-robin, a thread
+// takes from the front of its own deque and, when that is empty, steals
+// from the back of another thread's deque. Results are handed back by the
+// task itself (see Server: completions go through an eventfd-signalled queue).
+class TaskPool {
+public:
+    typedef std::function<void()> Task;
+    
+private:
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+    
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> next_queue;
+    
+    // Idle threads sleep until queued > 0
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    std::atomic<int> queued;
+    bool stopping;
+    
+    std::atomic<uint64_t> executed;
+    std::atomic<uint64_t> stolen;
+    
+    void worker_loop(int index);
+    
+    // Own queue first, then steal; false if every queue is empty
+    bool take(int index, Task& task);
+
+public:
+    explicit TaskPool(int num_threads);
+    ~TaskPool();
+    
+    TaskPool(const TaskPool&) = delete;
+    TaskPool& operator=(const TaskPool&) = delete;
+    
+    // Queue a task (thread-safe)
+    void submit(Task task);
+    
+    // Run every queued task, then join the threads
+    void shutdown();
+    
+    int size() const { return static_cast<int>(queues.size()); }
+    uint64_t executed_count() const { return executed.load(); }
+    uint64_t stolen_count() const { return stolen.load(); }
+};
+
+#endif // TASK_POOL_H
@@ -0,0 +1,93 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+// Wheel geometry: blocks of 256 ticks. Level 0 has a slot per tick for two
+// blocks, level 1 a slot per block, level 2 a slot per 256 blocks.
+#define TIMER_WHEEL_BITS 8
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_RANGE (255ULL << (2 * TIMER_WHEEL_BITS))    // Ticks ahead; further is clamped
+
+// Handle of an armed timer (0 = none). Stays safe to cancel after the
+// timer fired or was cancelled: the node's serial no longer matches.
+typedef uint64_t TimerId;
+
+// What fires; the owner dispatches on kind
+struct TimerEvent {
+    int kind;
+    int key;                // e.g. room_id or fd
+    uint32_t generation;    // e.g. FdSlab generation of the fd
+};
+
+// Hierarchical timing wheel, time counted in ticks (the owner picks the
+// tick length):
+//   level 0 - one slot per tick, for the current and the next block
+//   level 1 - one slot per block, up to 256 blocks ahead
+//   level 2 - one slot per 256 blocks
+// Timers move down before they are due rather than in one burst per block:
+// each advance() drains a share of the next block's level-1 slot into
+// level 0, so that slot is empty by the block boundary (if the loop slept
+// through the block, the rest moves at the boundary). A level-2 slot moves
+// down one block before its span starts.
+// A slot is a packed array of node indices: schedule() appends, cancel()
+// swaps the last entry in, both O(1). advance() costs the timers it fires
+// plus a share of the next block, however many are armed further out.
+// Not thread-safe: used from the owning event loop only.
+class TimerWheel {
+private:
+    static const uint32_t NIL = 0xffffffffu;
+    static const uint32_t LEVEL1 = 2 * TIMER_WHEEL_SLOTS;      // First slot of levels 1 and 2
+    static const uint32_t LEVEL2 = 3 * TIMER_WHEEL_SLOTS;
+    static const uint32_t SLOT_COUNT = 4 * TIMER_WHEEL_SLOTS;
+    
+    struct Node {
+        uint64_t expires = 0;   // Tick
+        uint32_t slot = NIL;    // Slot while armed, NIL when free
+        uint32_t position = 0;  // Index in the slot's array
+        uint32_t serial = 0;    // Bumped on release (stale TimerIds miss)
+        TimerEvent event = TimerEvent();
+    };
+    
+    std::vector<Node> nodes;
+    std::vector<uint32_t> free_nodes;
+    std::vector<uint32_t> slots[SLOT_COUNT];
+    uint64_t occupied[SLOT_COUNT / 64];     // Non-empty slots
+    uint64_t current;           // Every timer due at or before this tick has fired
+    size_t armed;
+    std::vector<uint32_t> refiling;         // Slot being moved down (its array swapped out)
+    
+    void link(uint32_t index);
+    void unlink(uint32_t index);
+    void release(uint32_t index);
+    void refile(uint32_t slot);
+    void drain_next_block();
+    
+    // Slots from start (included) to the first non-empty one of a level,
+    // round its ring; -1 if the level is empty
+    int ring_distance(uint32_t first_slot, uint32_t slot_count, uint32_t start) const;
+
+public:
+    explicit TimerWheel(uint64_t now = 0);
+    
+    // Arm a timer for the given tick (one in the past fires on the next tick)
+    TimerId schedule(uint64_t expires, const TimerEvent& event);
+    
+    // Disarm; false if it already fired or was cancelled
+    bool cancel(TimerId id);
+    
+    // Move the wheel to now, appending the events of expired timers in
+    // expiry order (timers armed while handling them are not included)
+    void advance(uint64_t now, std::vector<TimerEvent>& fired);
+    
+    // Earliest tick advance() must run at: the next expiry, or a block
+    // boundary with timers still to move down. UINT64_MAX when empty.
+    uint64_t next_expiry() const;
+    
+    uint64_t now() const { return current; }
+    size_t size() const { return armed; }
+};
+
+#endif // TIMER_WHEEL_H
@@ -0,0 +1,69 @@
+#ifndef TOKEN_SIGNER_H
+#define TOKEN_SIGNER_H
+
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Prefix of signed tokens (database tokens are plain alphanumerics)
+#define SIGNED_TOKEN_PREFIX "s1."
+
+// Claims carried by a signed token
+struct SignedToken {
+    uint32_t key_id = 0;
+    int user_id = -1;
+    std::string role;
+    time_t expiry = 0;      // Epoch seconds
+};
+
+// Stateless session tokens (--tokens signed):
+//   s1.<key id>.<user id>.<role>.<expiry>.<HMAC-SHA256 hex>
+// The MAC covers everything before it, keyed by the secret named by the
+// key id. Login writes nothing and verification is CPU only; logouts go to
+// a small in-memory revocation set kept until the token would expire.
+// Several keys may be loaded: new tokens use the current (last added) one,
+// tokens signed with an older one stay valid while it is loaded, so keys
+// can be rotated without logging everybody out.
+class TokenSigner {
+private:
+    std::map<uint32_t, std::string> keys;   // Fixed once the server runs
+    uint32_t current_key;
+    
+    // MAC -> expiry of logged-out tokens
+    std::mutex revoked_mutex;
+    std::unordered_map<std::string, time_t> revoked;
+    
+    static std::string hmac_hex(const std::string& key, const std::string& data);
+
+public:
+    TokenSigner();
+    
+    // Add a key and make it current (secret: at least 16 bytes)
+    bool add_key(uint32_t key_id, const std::string& secret);
+    
+    // One "<key id> <secret>" per line, the last one is current
+    bool load_key_file(const std::string& path);
+    
+    // Random key for this process only (tokens die with it)
+    bool generate_key();
+    
+    bool has_keys() const { return !keys.empty(); }
+    uint32_t current_key_id() const { return current_key; }
+    
+    std::string issue(int user_id, const std::string& role, time_t expiry) const;
+    
+    // Signature, key id, expiry at `now` and revocation
+    bool verify(const std::string& token, time_t now, SignedToken& claims);
+    
+    static bool is_signed(const std::string& token);
+    
+    // Logout: reject the token from now on (kept until `expiry`)
+    void revoke(const std::string& token, time_t expiry);
+    size_t purge_revoked(time_t now);
+    size_t revoked_count();
+};
+
+#endif // TOKEN_SIGNER_H
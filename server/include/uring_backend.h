@@ -0,0 +1,132 @@
+#ifndef URING_BACKEND_H
+#define URING_BACKEND_H
+
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+#include <vector>
+#include "io_backend.h"
+#include "fd_slab.h"
+
+#define URING_SQ_ENTRIES 4096
+#define URING_CQ_ENTRIES 16384
+#define URING_BUF_COUNT 1024        // Provided receive buffers (power of two)
+#define URING_BUF_SIZE 8192
+#define URING_SEND_FRAMES 32        // Frames per sendmsg operation (64 iovecs)
+#define URING_SEND_LINKS 4          // Linked sendmsg operations per flush
+
+// Completion backend on io_uring (raw syscalls, kernel 6.0+):
+//  - one multishot accept on the listening socket
+//  - one multishot recv per connection, data lands in a provided-buffer ring
+//    and is handed to the loop as IO_DATA (buffers recycled on the next wait);
+//    cancelled while the connection's input buffer is full, armed again once
+//    it drains
+//  - output goes out as linked sendmsg operations (MSG_WAITALL, so a short
+//    write breaks the chain), one chain in flight per connection
+// A loop iteration costs one io_uring_enter() for all submissions and
+// completions together.
+class UringBackend : public IoBackend {
+private:
+    // A chain of sendmsg operations in flight. Owns copies of the frames
+    // (payloads shared) so it outlives a connection closed meanwhile.
+    struct InflightSend {
+        int fd;
+        uint32_t generation;
+        std::vector<OutFrame> frames;
+        std::vector<struct iovec> iov;
+        std::vector<struct msghdr> msgs;
+        int outstanding;        // Operations without a completion yet
+        size_t written;         // Bytes written by the chain (contiguous prefix)
+        bool failed;
+        bool orphaned;          // Connection removed: free on last completion
+        size_t orphan_index;    // Position in orphaned_sends while orphaned
+    };
+    
+    struct UringConn {
+        InflightSend* send = nullptr;
+        bool recv_armed = false;    // Multishot recv in flight (until its final completion)
+        bool recv_paused = false;   // Input buffer full: don't arm again
+    };
+    
+    int ring_fd;
+    int listen_fd;
+    int wakeup_fd;
+    int timer_fd;
+    IoStats* stats;
+    
+    // Submission queue
+    void* sq_ring;
+    size_t sq_ring_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    unsigned* sq_flags;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned sq_entries;
+    unsigned sq_local_tail;     // Next free SQE (published on submit)
+    unsigned sq_unsubmitted;
+    
+    // Completion queue
+    void* cq_ring;
+    size_t cq_ring_size;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    
+    // Provided receive buffers
+    struct io_uring_buf_ring* buf_ring;
+    char* buffers;
+    unsigned short buf_tail;
+    std::vector<unsigned short> used_buffers;   // Handed out as IO_DATA, recycled next wait
+    
+    FdSlab<UringConn> conns;
+    std::vector<InflightSend*> orphaned_sends;  // Removed connections' chains still in flight
+    
+    // Requests without their final completion yet (one per SQE, until a
+    // completion without IORING_CQE_F_MORE): drained before teardown
+    size_t inflight;
+    
+    // Multishot operations that ended and must be armed again
+    bool rearm_accept;
+    bool rearm_wakeup;
+    bool rearm_timer;
+    std::vector<std::pair<int, uint32_t>> rearm_recv;
+    
+    struct io_uring_sqe* get_sqe();
+    void reserve_sqes(unsigned count);
+    int enter(unsigned to_submit, unsigned min_complete);
+    void submit();
+    
+    void arm_accept();
+    void arm_wakeup();
+    void arm_timer();
+    void arm_recv(int fd, uint32_t generation);
+    void cancel(uint64_t user_data);
+    void recycle_buffers();
+    void reap(std::vector<IoEvent>& events);
+    void handle_send_completion(InflightSend* send, int res, std::vector<IoEvent>& events);
+    
+    // Cancel everything and reap until nothing is in flight (false on error)
+    bool drain();
+    void release();
+
+public:
+    UringBackend();
+    ~UringBackend();
+    
+    // Create the ring and register receive buffers (false if unsupported)
+    bool init();
+    
+    const char* name() const { return "uring"; }
+    bool setup(int listen_fd, int wakeup_fd, int timer_fd, IoStats* stats);
+    bool add_client(int fd);
+    void remove_client(int fd);
+    void pause_recv(int fd);
+    void resume_recv(int fd);
+    bool wait(std::vector<IoEvent>& events, int timeout_ms);
+    SendResult flush(int fd, OutputQueue& queue);
+};
+
+#endif // URING_BACKEND_H
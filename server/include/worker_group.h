@@ -0,0 +1,54 @@
+#ifndef WORKER_GROUP_H
+#define WORKER_GROUP_H
+
+#include <memory>
+#include <thread>
+#include <vector>
+#include "server.h"
+#include "task_pool.h"
+#include "session_cache.h"
+#include "exam_engine.h"
+
+// Runs N independent Server event loops (one per thread).
+// Each worker owns its I/O backend (epoll or io_uring), its SO_REUSEPORT listening socket
+// and its slice of clients; room broadcasts are forwarded between workers.
+// Database-bound handlers of every worker share one task pool, password
+// hashing (register/login) another.
+class WorkerGroup {
+private:
+    // Declared first: outlive the workers and pool threads using them
+    SessionCache sessions;
+    ExamEngine exams;
+    
+    std::vector<std::unique_ptr<Server>> workers;
+    std::vector<std::thread> threads;
+    
+    // Declared after workers: destroyed (and drained) before them
+    std::unique_ptr<TaskPool> pool;
+    std::unique_ptr<TaskPool> hash_pool;
+
+public:
+    WorkerGroup(int port, Database* database, int num_workers, int backlog = DEFAULT_LISTEN_BACKLOG,
+                int pool_threads = DEFAULT_POOL_THREADS, IoBackendKind io_kind = IO_BACKEND_EPOLL,
+                int hash_threads = DEFAULT_HASH_THREADS);
+    ~WorkerGroup();
+    
+    int size() const { return static_cast<int>(workers.size()); }
+    
+    // Setup all workers, then run them (blocking, worker 0 runs on caller thread)
+    bool start();
+    
+    // Stop all workers
+    void stop();
+    
+    // Issue signed session tokens on every worker (--tokens signed)
+    void set_token_signer(TokenSigner* signer);
+    
+    // Close silent connections on every worker (--idle-timeout, 0 = never)
+    void set_idle_timeout(int seconds);
+    
+    // Batch answer writes on every worker (and the answers of running exams)
+    void set_answer_writer(AnswerWriter* writer);
+};
+
+#endif // WORKER_GROUP_H
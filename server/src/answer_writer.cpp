@@ -0,0 +1,119 @@
+#include "../include/answer_writer.h"
+#include "../include/logger.h"
+#include <algorithm>
+#include <chrono>
+
+AnswerWriter::AnswerWriter(Database* database, int flush_ms, size_t flush_rows)
+    : db(database), flush_ms(flush_ms > 0 ? flush_ms : DEFAULT_ANSWER_FLUSH_MS),
+      flush_rows(flush_rows > 0 ? flush_rows : DEFAULT_ANSWER_FLUSH_ROWS), stopping(false) {
+    flusher = std::thread(&AnswerWriter::flusher_loop, this);
+}
+
+AnswerWriter::~AnswerWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    flusher.join();
+    if (!write_pending()) {
+        LOG_ERROR("Answer writer stopped with " + std::to_string(get_stats().queue_depth) + " answers not stored");
+    }
+}
+
+void AnswerWriter::enqueue(int user_id, int room_id, int question_id, const std::string& selected_option) {
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto result = pending.insert({AnswerKey{user_id, room_id, question_id}, selected_option});
+        if (!result.second) {
+            result.first->second = selected_option;     // Last write wins
+            stats.coalesced++;
+        }
+        stats.enqueued++;
+        stats.max_queue_depth = std::max(stats.max_queue_depth, pending.size());
+        full = pending.size() >= flush_rows;
+    }
+    if (full) {
+        wake.notify_one();
+    }
+}
+
+bool AnswerWriter::flush() {
+    return write_pending();
+}
+
+void AnswerWriter::flusher_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping) {
+        wake.wait_for(lock, std::chrono::milliseconds(flush_ms),
+                      [this]() { return stopping || pending.size() >= flush_rows; });
+        if (pending.empty()) {
+            continue;
+        }
+        lock.unlock();
+        bool stored = write_pending();
+        lock.lock();
+        
+        // Database unavailable: give it flush_ms before the next attempt
+        if (!stored) {
+            wake.wait_for(lock, std::chrono::milliseconds(flush_ms), [this]() { return stopping; });
+        }
+    }
+}
+
+bool AnswerWriter::write_pending() {
+    std::lock_guard<std::mutex> write_lock(write_mutex);
+    
+    std::unordered_map<AnswerKey, std::string, AnswerKeyHash> batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        batch.swap(pending);
+    }
+    if (batch.empty()) {
+        return true;
+    }
+    
+    std::vector<UserAnswer> answers;
+    answers.reserve(batch.size());
+    for (auto& entry : batch) {
+        answers.push_back(UserAnswer{entry.first.user_id, entry.first.room_id, entry.first.question_id,
+                                     std::move(entry.second)});
+    }
+    
+    auto start = std::chrono::steady_clock::now();
+    size_t written;
+    bool stored = db->save_user_answers(answers, written);
+    double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!stored) {
+        // Back to pending, still under write_mutex so a flush() waiting for
+        // this batch writes it; changes enqueued meanwhile are newer and stay
+        for (UserAnswer& answer : answers) {
+            pending.emplace(AnswerKey{answer.user_id, answer.room_id, answer.question_id},
+                            std::move(answer.selected_option));
+        }
+        stats.failed_flushes++;
+        stats.max_queue_depth = std::max(stats.max_queue_depth, pending.size());
+        LOG_WARN("Answer flush failed: " + std::to_string(answers.size()) + " answers kept for the next flush");
+        return false;
+    }
+    stats.rows_written += written;
+    stats.failed_rows += answers.size() - written;
+    stats.flushes++;
+    stats.last_flush_ms = elapsed_ms;
+    stats.max_flush_ms = std::max(stats.max_flush_ms, elapsed_ms);
+    if (written < answers.size()) {
+        LOG_WARN("Answer flush: " + std::to_string(answers.size() - written) + " of " +
+                 std::to_string(answers.size()) + " answers rejected by the database");
+    }
+    return true;
+}
+
+AnswerWriterStats AnswerWriter::get_stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    AnswerWriterStats current = stats;
+    current.queue_depth = pending.size();
+    return current;
+}
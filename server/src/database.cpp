@@ -1,12 +1,13 @@
 #include "../include/database.h"
 #include "../include/logger.h"
 #include "../include/session.h"
+#include "../include/question_payload.h"
 #include <iostream>
 #include <sstream>
 #include <fstream>
 #include <vector>
 
-Database::Database(const std::string& path) : db(nullptr), db_path(path) {
+Database::Database(const std::string& path) : db(nullptr), db_path(path), cache_statements(true) {
     int rc = sqlite3_open(path.c_str(), &db);
     if (rc != SQLITE_OK) {
         LOG_ERROR("Cannot open database: " + std::string(sqlite3_errmsg(db)));
@@ -19,7 +20,9 @@ Database::Database(const std::string& path) : db(nullptr), db_path(path) {
 }
 
 Database::~Database() {
+    close_readers();
     if (db) {
+        finalize_statements(statements);    // sqlite3_close fails while statements are alive
         sqlite3_close(db);
         LOG_INFO("Database closed");
     }
@@ -36,11 +39,131 @@ bool Database::execute_sql(const std::string& sql) {
     return true;
 }
 
+sqlite3_stmt* Database::acquire_statement(sqlite3* handle, StatementMap& cache, const char* sql, bool& cached) {
+    sqlite3_stmt* stmt = nullptr;
+    cached = false;
+    
+    bool enabled = cache_statements.load(std::memory_order_relaxed);
+    auto it = enabled ? cache.find(sql) : cache.end();
+    if (it != cache.end()) {
+        if (!sqlite3_stmt_busy(it->second)) {
+            cached = true;
+            return it->second;
+        }
+    } else if (enabled) {
+        if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+            return nullptr;
+        }
+        cache.emplace(sql, stmt);
+        cached = true;
+        return stmt;
+    }
+    
+    if (sqlite3_prepare_v2(handle, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+        return nullptr;
+    }
+    return stmt;
+}
+
+void Database::finalize_statements(StatementMap& cache) {
+    for (auto& entry : cache) {
+        sqlite3_finalize(entry.second);
+    }
+    cache.clear();
+}
+
+void Database::set_statement_cache(bool enabled) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    cache_statements = enabled;
+    if (!enabled) {
+        finalize_statements(statements);
+        for (auto& reader : readers) {
+            std::lock_guard<std::mutex> reader_lock(reader->mutex);
+            finalize_statements(reader->statements);
+        }
+    }
+}
+
+Database::ReadLease::ReadLease(Database* database) {
+    if (database->readers.empty()) {
+        writer_lock = std::unique_lock<std::recursive_mutex>(database->db_mutex);
+        db = database->db;
+        statements = &database->statements;
+        return;
+    }
+    
+    static std::atomic<unsigned> reading_threads(0);
+    static thread_local unsigned slot = reading_threads.fetch_add(1);
+    ReadConnection& reader = *database->readers[slot % database->readers.size()];
+    reader_lock = std::unique_lock<std::mutex>(reader.mutex);
+    db = reader.db;
+    statements = &reader.statements;
+}
+
+bool Database::configure(const DatabaseConfig& config) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    
+    // In-memory databases are private to their connection: no WAL, no readers
+    bool in_memory = db_path.empty() || db_path == ":memory:" || db_path.compare(0, 13, "file::memory:") == 0;
+    
+    std::string pragmas = "PRAGMA mmap_size = " + std::to_string(config.mmap_size) + ";" +
+                          "PRAGMA cache_size = -" + std::to_string(config.cache_size_kib) + ";" +
+                          "PRAGMA busy_timeout = 5000;";
+    if (!execute_sql(pragmas)) {
+        return false;
+    }
+    
+    question_cache.set_capacity(config.question_cache_size);
+    warm_question_cache();
+    
+    if (!config.wal || in_memory) {
+        return true;
+    }
+    
+    // WAL: readers never block the writer nor each other. synchronous=NORMAL
+    // syncs at checkpoints only (a power loss can drop the last commits, never
+    // corrupt). Checkpoints run every wal_autocheckpoint pages and the WAL
+    // file is truncated back to journal_size_limit afterwards.
+    if (!execute_sql("PRAGMA journal_mode = WAL;") ||
+        !execute_sql("PRAGMA synchronous = NORMAL;"
+                     "PRAGMA wal_autocheckpoint = " + std::to_string(config.wal_autocheckpoint) + ";"
+                     "PRAGMA journal_size_limit = 67108864;")) {
+        return false;
+    }
+    
+    close_readers();
+    for (int i = 0; i < config.read_connections; i++) {
+        std::unique_ptr<ReadConnection> reader(new ReadConnection());
+        if (sqlite3_open_v2(db_path.c_str(), &reader->db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+            LOG_ERROR("Cannot open read connection: " + std::string(sqlite3_errmsg(reader->db)));
+            sqlite3_close(reader->db);
+            close_readers();
+            return false;
+        }
+        sqlite3_exec(reader->db, pragmas.c_str(), nullptr, nullptr, nullptr);
+        readers.push_back(std::move(reader));
+    }
+    
+    LOG_INFO("Database: WAL, " + std::to_string(readers.size()) + " read connection(s), mmap " +
+             std::to_string(config.mmap_size >> 20) + " MiB, cache " +
+             std::to_string(config.cache_size_kib >> 10) + " MiB per connection");
+    return true;
+}
+
+void Database::close_readers() {
+    for (auto& reader : readers) {
+        finalize_statements(reader->statements);
+        sqlite3_close(reader->db);
+    }
+    readers.clear();
+}
+
 int64_t Database::get_last_insert_rowid() {
     return sqlite3_last_insert_rowid(db);
 }
 
 bool Database::initialize() {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     // Read schema from file (try multiple paths)
     std::ifstream schema_file;
     std::vector<std::string> schema_paths = {
@@ -69,7 +192,8 @@ bool Database::initialize() {
     std::string schema = buffer.str();
     schema_file.close();
     
-    // Execute schema
+    // Execute schema (statements prepared against the old one are dropped)
+    finalize_statements(statements);
     if (!execute_sql(schema)) {
         return false;
     }
@@ -114,16 +238,38 @@ bool Database::initialize() {
         sqlite3_finalize(stmt);
     }
     
+    return load_question_index();
+}
+
+bool Database::load_question_index() {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    question_index.clear();
+    answer_keys.clear();
+    const char* sql = "SELECT question_id, topic, difficulty, correct_option FROM Questions;";
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
+        LOG_ERROR("Failed to load question index: " + std::string(sqlite3_errmsg(db)));
+        return false;
+    }
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        int question_id = sqlite3_column_int(stmt, 0);
+        question_index.add(question_id,
+                           reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                           reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
+        answer_keys.set(question_id, reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3)));
+    }
+    LOG_INFO("Question index: " + std::to_string(question_index.size()) + " question(s)");
     return true;
 }
 
 // User operations
 bool Database::create_user(const std::string& username, const std::string& hashed_password, 
                           const std::string& role) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "INSERT INTO Users (username, hashed_password, role) VALUES (?, ?, ?);";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         LOG_ERROR("Failed to prepare statement: " + std::string(sqlite3_errmsg(db)));
         return false;
     }
@@ -133,7 +279,6 @@ bool Database::create_user(const std::string& username, const std::string& hashe
     sqlite3_bind_text(stmt, 3, role.c_str(), -1, SQLITE_TRANSIENT);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     if (success) {
         LOG_INFO("User created: " + username);
@@ -145,10 +290,10 @@ bool Database::create_user(const std::string& username, const std::string& hashe
 }
 
 bool Database::get_user_by_username(const std::string& username, User& user) {
+    ReadLease reader(this);
     const char* sql = "SELECT user_id, username, hashed_password, role, created_at FROM Users WHERE username = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -164,15 +309,14 @@ bool Database::get_user_by_username(const std::string& username, User& user) {
         found = true;
     }
     
-    sqlite3_finalize(stmt);
     return found;
 }
 
 bool Database::get_user_by_id(int user_id, User& user) {
+    ReadLease reader(this);
     const char* sql = "SELECT user_id, username, hashed_password, role, created_at FROM Users WHERE user_id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -188,16 +332,32 @@ bool Database::get_user_by_id(int user_id, User& user) {
         found = true;
     }
     
-    sqlite3_finalize(stmt);
     return found;
 }
 
+bool Database::update_password_hash(int user_id, const std::string& hashed_password) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    const char* sql = "UPDATE Users SET hashed_password = ? WHERE user_id = ?;";
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
+        LOG_ERROR("Failed to prepare statement: " + std::string(sqlite3_errmsg(db)));
+        return false;
+    }
+    
+    sqlite3_bind_text(stmt, 1, hashed_password.c_str(), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int(stmt, 2, user_id);
+    
+    bool success = sqlite3_step(stmt) == SQLITE_DONE;
+    
+    return success;
+}
+
 // Session operations
 bool Database::create_session(const std::string& token, int user_id, int expiry_seconds) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "INSERT INTO Sessions (session_token, user_id, expiry_timestamp) VALUES (?, ?, ?);";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -208,16 +368,15 @@ bool Database::create_session(const std::string& token, int user_id, int expiry_
     sqlite3_bind_text(stmt, 3, expiry.c_str(), -1, SQLITE_TRANSIENT);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
 bool Database::get_session(const std::string& token, Session& session) {
+    ReadLease reader(this);
     const char* sql = "SELECT session_token, user_id, expiry_timestamp FROM Sessions WHERE session_token = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -231,26 +390,25 @@ bool Database::get_session(const std::string& token, Session& session) {
         found = true;
     }
     
-    sqlite3_finalize(stmt);
     return found;
 }
 
 bool Database::delete_session(const std::string& token) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "DELETE FROM Sessions WHERE session_token = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_text(stmt, 1, token.c_str(), -1, SQLITE_TRANSIENT);
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
 bool Database::is_session_valid(const std::string& token) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     Session session;
     if (!get_session(token, session)) {
         return false;
@@ -259,6 +417,7 @@ bool Database::is_session_valid(const std::string& token) {
 }
 
 int Database::get_user_id_from_session(const std::string& token) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     Session session;
     if (!get_session(token, session)) {
         return -1;
@@ -270,62 +429,123 @@ int Database::get_user_id_from_session(const std::string& token) {
 }
 
 void Database::cleanup_expired_sessions() {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     std::string current_time = SessionManager::get_current_timestamp();
     const char* sql = "DELETE FROM Sessions WHERE expiry_timestamp < ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) == SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (stmt) {
         sqlite3_bind_text(stmt, 1, current_time.c_str(), -1, SQLITE_TRANSIENT);
         sqlite3_step(stmt);
-        sqlite3_finalize(stmt);
     }
 }
 
 // Question operations
-std::vector<Question> Database::get_random_questions(int count, const std::string& topic, 
-                                                     const std::string& difficulty) {
-    std::vector<Question> questions;
-    std::stringstream sql;
-    sql << "SELECT question_id, content, options, correct_option, difficulty, topic, created_by "
-        << "FROM Questions WHERE 1=1";
-    
-    if (topic != "all" && !topic.empty()) {
-        sql << " AND topic = '" << topic << "'";
+static void read_question_row(sqlite3_stmt* stmt, Question& question) {
+    question.question_id = sqlite3_column_int(stmt, 0);
+    question.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
+    std::string options_str = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
+    question.options = QuestionOptions::from_json(json::parse(options_str));
+    question.correct_option = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
+    question.difficulty = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
+    question.topic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
+    question.created_by = sqlite3_column_int(stmt, 6);
+    question.client_json = QuestionPayload::client_json(question);
+}
+
+void Database::read_question(sqlite3_stmt* stmt, Question& question, uint64_t stamp, bool remember) {
+    if (question_cache.get(sqlite3_column_int(stmt, 0), question)) {
+        return;
     }
-    if (difficulty != "all" && !difficulty.empty()) {
-        sql << " AND difficulty = '" << difficulty << "'";
+    read_question_row(stmt, question);
+    if (remember) {
+        question_cache.put(question, stamp);
+    }
+}
+
+void Database::warm_question_cache() {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    question_cache.clear();
+    size_t capacity = question_cache.capacity();
+    if (capacity == 0) {
+        return;
     }
-    sql << " ORDER BY RANDOM() LIMIT " << count << ";";
     
-    sqlite3_stmt* stmt;
-    if (sqlite3_prepare_v2(db, sql.str().c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
-        LOG_ERROR("Failed to prepare statement: " + std::string(sqlite3_errmsg(db)));
-        return questions;
+    // Newest first: recently written questions are the likeliest to be used
+    const char* sql = "SELECT question_id, content, options, correct_option, difficulty, topic, created_by "
+                     "FROM Questions ORDER BY question_id DESC LIMIT ?;";
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
+        return;
     }
+    sqlite3_bind_int64(stmt, 1, static_cast<sqlite3_int64>(capacity));
     
+    size_t loaded = 0;
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         Question q;
-        q.question_id = sqlite3_column_int(stmt, 0);
-        q.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        std::string options_str = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        q.options = json::parse(options_str);
-        q.correct_option = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        q.difficulty = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        q.topic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        q.created_by = sqlite3_column_int(stmt, 6);
-        questions.push_back(q);
+        read_question_row(stmt, q);
+        question_cache.put(q);
+        loaded++;
+    }
+    LOG_INFO("Question cache: " + std::to_string(loaded) + " question(s) loaded, capacity " +
+             std::to_string(capacity));
+}
+
+std::vector<Question> Database::get_random_questions(int count, const std::string& topic, 
+                                                     const std::string& difficulty) {
+    // Ids come from the index (O(count)), rows from the cache or by primary key
+    std::vector<int> ids = question_index.sample(count, topic, difficulty);
+    std::vector<Question> sampled(ids.size());
+    std::vector<char> found(ids.size(), 0);
+    std::vector<size_t> missing;
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (question_cache.get(ids[i], sampled[i])) {
+            found[i] = 1;
+        } else {
+            missing.push_back(i);
+        }
+    }
+    
+    if (!missing.empty()) {
+        uint64_t stamp = question_cache.stamp();
+        ReadLease reader(this);
+        const char* sql = "SELECT question_id, content, options, correct_option, difficulty, topic, created_by "
+                         "FROM Questions WHERE question_id = ?;";
+        CachedStatement stmt(this, reader, sql);
+        for (size_t i = 0; stmt && i < missing.size(); i++) {
+            size_t slot = missing[i];
+            sqlite3_bind_int(stmt, 1, ids[slot]);
+            // A question deleted after sampling is skipped
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                read_question_row(stmt, sampled[slot]);
+                question_cache.put(sampled[slot], stamp);
+                found[slot] = 1;
+            }
+            sqlite3_reset(stmt);
+        }
     }
     
-    sqlite3_finalize(stmt);
+    // Keep the sampled (random) order
+    std::vector<Question> questions;
+    questions.reserve(ids.size());
+    for (size_t i = 0; i < ids.size(); i++) {
+        if (found[i]) {
+            questions.push_back(std::move(sampled[i]));
+        }
+    }
     return questions;
 }
 
 bool Database::get_question_by_id(int question_id, Question& question) {
+    if (question_cache.get(question_id, question)) {
+        return true;
+    }
+    
+    uint64_t stamp = question_cache.stamp();
+    ReadLease reader(this);
     const char* sql = "SELECT question_id, content, options, correct_option, difficulty, topic, created_by "
                      "FROM Questions WHERE question_id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -333,28 +553,21 @@ bool Database::get_question_by_id(int question_id, Question& question) {
     
     bool found = false;
     if (sqlite3_step(stmt) == SQLITE_ROW) {
-        question.question_id = sqlite3_column_int(stmt, 0);
-        question.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        std::string options_str = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        question.options = json::parse(options_str);
-        question.correct_option = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        question.difficulty = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        question.topic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        question.created_by = sqlite3_column_int(stmt, 6);
+        read_question_row(stmt, question);
+        question_cache.put(question, stamp);
         found = true;
     }
     
-    sqlite3_finalize(stmt);
     return found;
 }
 
 bool Database::create_question(const std::string& content, const json& options, const std::string& correct_option,
                               const std::string& difficulty, const std::string& topic, int created_by, int& question_id) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "INSERT INTO Questions (content, options, correct_option, difficulty, topic, created_by) "
                      "VALUES (?, ?, ?, ?, ?, ?);";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         LOG_ERROR("Failed to prepare create_question: " + std::string(sqlite3_errmsg(db)));
         return false;
     }
@@ -373,21 +586,33 @@ bool Database::create_question(const std::string& content, const json& options,
     
     if (success) {
         question_id = static_cast<int>(get_last_insert_rowid());
+        question_index.add(question_id, topic, difficulty);
+        answer_keys.set(question_id, correct_option);
+        
+        Question question;
+        question.question_id = question_id;
+        question.content = content;
+        question.options = QuestionOptions::from_json(options);
+        question.correct_option = correct_option;
+        question.difficulty = difficulty;
+        question.topic = topic;
+        question.created_by = created_by;
+        question.client_json = QuestionPayload::client_json(question);
+        question_cache.put(question);
     } else {
         LOG_ERROR("create_question execution failed: " + std::string(sqlite3_errmsg(db)));
     }
     
-    sqlite3_finalize(stmt);
     return success;
 }
 
 bool Database::update_question(int question_id, const std::string& content, const json& options, 
                               const std::string& correct_option, const std::string& difficulty, const std::string& topic) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "UPDATE Questions SET content=?, options=?, correct_option=?, difficulty=?, topic=? "
                      "WHERE question_id=?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -401,86 +626,82 @@ bool Database::update_question(int question_id, const std::string& content, cons
     sqlite3_bind_int(stmt, 6, question_id);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    if (success && sqlite3_changes(db) > 0) {
+        question_index.add(question_id, topic, difficulty);    // Topic/difficulty may have changed
+        answer_keys.set(question_id, correct_option);
+        question_cache.erase(question_id);
+    }
     return success;
 }
 
 bool Database::delete_question(int question_id) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "DELETE FROM Questions WHERE question_id=?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_int(stmt, 1, question_id);
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    if (success) {
+        question_index.remove(question_id);
+        answer_keys.remove(question_id);
+        question_cache.erase(question_id);
+    }
     return success;
 }
 
 std::vector<Question> Database::get_questions_by_creator(int creator_id) {
+    ReadLease reader(this);
     std::vector<Question> questions;
     const char* sql = "SELECT question_id, content, options, correct_option, difficulty, topic, created_by "
                      "FROM Questions WHERE created_by = ? ORDER BY question_id DESC;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return questions;
     }
     
     sqlite3_bind_int(stmt, 1, creator_id);
     
+    // A listing reads cached copies but does not cache (a scan would evict the hot set)
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         Question q;
-        q.question_id = sqlite3_column_int(stmt, 0);
-        q.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        q.options = json::parse(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
-        q.correct_option = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        q.difficulty = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        q.topic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        q.created_by = sqlite3_column_int(stmt, 6);
+        read_question(stmt, q, 0, false);
         questions.push_back(q);
     }
     
-    sqlite3_finalize(stmt);
     return questions;
 }
 
 std::vector<Question> Database::get_all_questions() {
+    ReadLease reader(this);
     std::vector<Question> questions;
     const char* sql = "SELECT question_id, content, options, correct_option, difficulty, topic, created_by "
                      "FROM Questions ORDER BY question_id DESC;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return questions;
     }
     
+    // A listing reads cached copies but does not cache (a scan would evict the hot set)
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         Question q;
-        q.question_id = sqlite3_column_int(stmt, 0);
-        q.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        q.options = json::parse(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
-        q.correct_option = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        q.difficulty = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        q.topic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        q.created_by = sqlite3_column_int(stmt, 6);
+        read_question(stmt, q, 0, false);
         questions.push_back(q);
     }
     
-    sqlite3_finalize(stmt);
     return questions;
 }
 
 // Practice history operations
 bool Database::save_practice_result(int user_id, int correct_count, int total_questions, 
                                    const std::string& filters_json, float score_percentage) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "INSERT INTO PracticeHistory (user_id, correct_count, total_questions, filters_used, score_percentage) "
                      "VALUES (?, ?, ?, ?, ?);";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -491,7 +712,6 @@ bool Database::save_practice_result(int user_id, int correct_count, int total_qu
     sqlite3_bind_double(stmt, 5, score_percentage);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
@@ -499,11 +719,11 @@ bool Database::save_practice_result(int user_id, int correct_count, int total_qu
 // Test room operations
 bool Database::create_test_room(const std::string& name, int creator_id, int num_questions, 
                                int duration_minutes, const std::string& filters_json, int& room_id) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "INSERT INTO TestRooms (name, creator_id, status, num_questions, duration_minutes, filters_used) "
                      "VALUES (?, ?, 'NOT_STARTED', ?, ?, ?);";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -517,18 +737,17 @@ bool Database::create_test_room(const std::string& name, int creator_id, int num
     if (success) {
         room_id = static_cast<int>(get_last_insert_rowid());
     }
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
 std::vector<TestRoom> Database::get_all_rooms() {
+    ReadLease reader(this);
     std::vector<TestRoom> rooms;
     const char* sql = "SELECT room_id, name, creator_id, status, num_questions, duration_minutes, "
                      "filters_used, start_timestamp, end_timestamp FROM TestRooms ORDER BY created_at DESC;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return rooms;
     }
     
@@ -555,16 +774,15 @@ std::vector<TestRoom> Database::get_all_rooms() {
         rooms.push_back(room);
     }
     
-    sqlite3_finalize(stmt);
     return rooms;
 }
 
 bool Database::get_room_by_id(int room_id, TestRoom& room) {
+    ReadLease reader(this);
     const char* sql = "SELECT room_id, name, creator_id, status, num_questions, duration_minutes, "
                      "filters_used, start_timestamp, end_timestamp FROM TestRooms WHERE room_id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -593,15 +811,14 @@ bool Database::get_room_by_id(int room_id, TestRoom& room) {
         found = true;
     }
     
-    sqlite3_finalize(stmt);
     return found;
 }
 
 bool Database::update_room_status(int room_id, const std::string& status) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "UPDATE TestRooms SET status = ? WHERE room_id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -609,16 +826,15 @@ bool Database::update_room_status(int room_id, const std::string& status) {
     sqlite3_bind_int(stmt, 2, room_id);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
 bool Database::update_room_timestamps(int room_id, const std::string& start_time, const std::string& end_time) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "UPDATE TestRooms SET start_timestamp = ?, end_timestamp = ? WHERE room_id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -627,37 +843,38 @@ bool Database::update_room_timestamps(int room_id, const std::string& start_time
     sqlite3_bind_int(stmt, 3, room_id);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
 // Room participant operations
 bool Database::add_participant(int room_id, int user_id) {
-    const char* sql = "INSERT INTO RoomParticipants (room_id, user_id, status) VALUES (?, ?, 'JOINED');";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    // Checked in the same statement: once start_room has committed, no one joins
+    const char* sql = "INSERT INTO RoomParticipants (room_id, user_id, status) SELECT ?, ?, 'JOINED' "
+                      "WHERE EXISTS (SELECT 1 FROM TestRooms WHERE room_id = ? AND status = 'NOT_STARTED');";
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
     sqlite3_bind_int(stmt, 1, room_id);
     sqlite3_bind_int(stmt, 2, user_id);
+    sqlite3_bind_int(stmt, 3, room_id);
     
-    bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
+    bool success = sqlite3_step(stmt) == SQLITE_DONE && sqlite3_changes(db) == 1;
     
     return success;
 }
 
 std::vector<std::string> Database::get_room_participants(int room_id) {
+    ReadLease reader(this);
     std::vector<std::string> participants;
     const char* sql = "SELECT u.username FROM RoomParticipants rp "
                      "JOIN Users u ON rp.user_id = u.user_id "
                      "WHERE rp.room_id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return participants;
     }
     
@@ -667,15 +884,32 @@ std::vector<std::string> Database::get_room_participants(int room_id) {
         participants.push_back(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0)));
     }
     
-    sqlite3_finalize(stmt);
     return participants;
 }
 
+std::vector<int> Database::get_room_participant_ids(int room_id) {
+    ReadLease reader(this);
+    std::vector<int> user_ids;
+    const char* sql = "SELECT user_id FROM RoomParticipants WHERE room_id = ? ORDER BY user_id;";
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
+        return user_ids;
+    }
+    
+    sqlite3_bind_int(stmt, 1, room_id);
+    
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        user_ids.push_back(sqlite3_column_int(stmt, 0));
+    }
+    
+    return user_ids;
+}
+
 bool Database::is_user_in_room(int room_id, int user_id) {
+    ReadLease reader(this);
     const char* sql = "SELECT COUNT(*) FROM RoomParticipants WHERE room_id = ? AND user_id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -687,16 +921,15 @@ bool Database::is_user_in_room(int room_id, int user_id) {
         found = sqlite3_column_int(stmt, 0) > 0;
     }
     
-    sqlite3_finalize(stmt);
     return found;
 }
 
 // Room questions operations
 bool Database::add_room_questions(int room_id, const std::vector<int>& question_ids) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "INSERT INTO TestRoomQuestions (room_id, question_id, question_order) VALUES (?, ?, ?);";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -707,24 +940,105 @@ bool Database::add_room_questions(int room_id, const std::vector<int>& question_
         sqlite3_bind_int(stmt, 3, static_cast<int>(i + 1));
         
         if (sqlite3_step(stmt) != SQLITE_DONE) {
-            sqlite3_finalize(stmt);
             return false;
         }
     }
     
-    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool Database::start_room(int room_id, const std::vector<int>& question_ids, const std::string& start_time,
+                          const std::string& end_time, std::vector<int>& user_ids) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    user_ids.clear();
+    if (!execute_sql("BEGIN IMMEDIATE;")) {
+        return false;
+    }
+    
+    // Only from NOT_STARTED: a second START_TEST changes nothing
+    bool started = false;
+    bool success;
+    {
+        CachedStatement stmt(this, "UPDATE TestRooms SET status = 'ONGOING', start_timestamp = ?, end_timestamp = ? "
+                                   "WHERE room_id = ? AND status = 'NOT_STARTED';");
+        success = stmt != nullptr;
+        if (success) {
+            sqlite3_bind_text(stmt, 1, start_time.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_text(stmt, 2, end_time.c_str(), -1, SQLITE_TRANSIENT);
+            sqlite3_bind_int(stmt, 3, room_id);
+            success = sqlite3_step(stmt) == SQLITE_DONE;
+            started = success && sqlite3_changes(db) == 1;
+        }
+    }
+    success = success && started && add_room_questions(room_id, question_ids);
+    if (success) {
+        // Participants at the start (add_participant sees the room ONGOING from now on)
+        CachedStatement stmt(this, "SELECT user_id FROM RoomParticipants WHERE room_id = ? ORDER BY user_id;");
+        success = stmt != nullptr;
+        if (success) {
+            sqlite3_bind_int(stmt, 1, room_id);
+            int rc;
+            while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+                user_ids.push_back(sqlite3_column_int(stmt, 0));
+            }
+            success = rc == SQLITE_DONE;
+        }
+    }
+    
+    if (!success || !execute_sql("COMMIT;")) {
+        if (started) {
+            LOG_ERROR("Failed to start room " + std::to_string(room_id) + ": " + sqlite3_errmsg(db));
+        }
+        execute_sql("ROLLBACK;");
+        user_ids.clear();
+        return false;
+    }
+    return true;
+}
+
+bool Database::cancel_room_start(int room_id) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    if (!execute_sql("BEGIN IMMEDIATE;")) {
+        return false;
+    }
+    
+    bool success;
+    {
+        CachedStatement stmt(this, "DELETE FROM TestRoomQuestions WHERE room_id = ?;");
+        success = stmt != nullptr;
+        if (success) {
+            sqlite3_bind_int(stmt, 1, room_id);
+            success = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+    }
+    if (success) {
+        CachedStatement stmt(this, "UPDATE TestRooms SET status = 'NOT_STARTED', start_timestamp = NULL, "
+                                   "end_timestamp = NULL WHERE room_id = ? AND status = 'ONGOING';");
+        success = stmt != nullptr;
+        if (success) {
+            sqlite3_bind_int(stmt, 1, room_id);
+            success = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+    }
+    
+    if (!success || !execute_sql("COMMIT;")) {
+        LOG_ERROR("Failed to cancel the start of room " + std::to_string(room_id) + ": " + sqlite3_errmsg(db));
+        execute_sql("ROLLBACK;");
+        return false;
+    }
     return true;
 }
 
 std::vector<Question> Database::get_room_questions(int room_id) {
+    uint64_t stamp = question_cache.stamp();
+    ReadLease reader(this);
     std::vector<Question> questions;
     const char* sql = "SELECT q.question_id, q.content, q.options, q.correct_option, q.difficulty, q.topic, q.created_by "
                      "FROM TestRoomQuestions trq "
                      "JOIN Questions q ON trq.question_id = q.question_id "
                      "WHERE trq.room_id = ? ORDER BY trq.question_order;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return questions;
     }
     
@@ -732,28 +1046,20 @@ std::vector<Question> Database::get_room_questions(int room_id) {
     
     while (sqlite3_step(stmt) == SQLITE_ROW) {
         Question q;
-        q.question_id = sqlite3_column_int(stmt, 0);
-        q.content = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1));
-        std::string options_str = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2));
-        q.options = json::parse(options_str);
-        q.correct_option = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 3));
-        q.difficulty = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 4));
-        q.topic = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 5));
-        q.created_by = sqlite3_column_int(stmt, 6);
+        read_question(stmt, q, stamp, true);
         questions.push_back(q);
     }
     
-    sqlite3_finalize(stmt);
     return questions;
 }
 
 // User test answers operations
 bool Database::save_user_answer(int user_id, int room_id, int question_id, const std::string& selected_option) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "INSERT OR REPLACE INTO UserTestAnswers (user_id, room_id, question_id, selected_option, last_updated) "
                      "VALUES (?, ?, ?, ?, CURRENT_TIMESTAMP);";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -763,16 +1069,53 @@ bool Database::save_user_answer(int user_id, int room_id, int question_id, const
     sqlite3_bind_text(stmt, 4, selected_option.c_str(), -1, SQLITE_TRANSIENT);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
+bool Database::save_user_answers(const std::vector<UserAnswer>& answers, size_t& saved) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    saved = 0;
+    const char* sql = "INSERT OR REPLACE INTO UserTestAnswers (user_id, room_id, question_id, selected_option, last_updated) "
+                     "VALUES (?, ?, ?, ?, CURRENT_TIMESTAMP);";
+    
+    // A constraint error only undoes its own statement: the others still commit
+    if (!execute_sql("BEGIN IMMEDIATE;")) {
+        return false;
+    }
+    
+    {
+        CachedStatement stmt(this, sql);
+        if (!stmt) {
+            execute_sql("ROLLBACK;");
+            return false;
+        }
+        
+        for (const UserAnswer& answer : answers) {
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 1, answer.user_id);
+            sqlite3_bind_int(stmt, 2, answer.room_id);
+            sqlite3_bind_int(stmt, 3, answer.question_id);
+            sqlite3_bind_text(stmt, 4, answer.selected_option.c_str(), -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(stmt) == SQLITE_DONE) {
+                saved++;
+            }
+        }
+    }
+    
+    if (!execute_sql("COMMIT;")) {
+        execute_sql("ROLLBACK;");
+        saved = 0;
+        return false;
+    }
+    return true;
+}
+
 bool Database::update_answer_correctness(int user_id, int room_id, int question_id, bool is_correct) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "UPDATE UserTestAnswers SET is_correct = ? WHERE user_id = ? AND room_id = ? AND question_id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -782,16 +1125,15 @@ bool Database::update_answer_correctness(int user_id, int room_id, int question_
     sqlite3_bind_int(stmt, 4, question_id);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
 int Database::get_user_score(int user_id, int room_id) {
+    ReadLease reader(this);
     const char* sql = "SELECT COUNT(*) FROM UserTestAnswers WHERE user_id = ? AND room_id = ? AND is_correct = 1;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return 0;
     }
     
@@ -803,15 +1145,85 @@ int Database::get_user_score(int user_id, int room_id) {
         score = sqlite3_column_int(stmt, 0);
     }
     
-    sqlite3_finalize(stmt);
     return score;
 }
 
+bool Database::finish_room(int room_id, const std::vector<int>& user_ids, const std::vector<int>& question_ids,
+                           const SheetGrades& grades) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
+    if (!execute_sql("BEGIN IMMEDIATE;")) {
+        return false;
+    }
+    
+    // Every answer of the room wrong, then the correct ones (bits of the bitmaps) right
+    bool success = true;
+    {
+        CachedStatement stmt(this, "UPDATE UserTestAnswers SET is_correct = 0 WHERE room_id = ?;");
+        success = stmt != nullptr;
+        if (success) {
+            sqlite3_bind_int(stmt, 1, room_id);
+            success = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+    }
+    {
+        CachedStatement stmt(this, "UPDATE UserTestAnswers SET is_correct = 1 "
+                                   "WHERE user_id = ? AND room_id = ? AND question_id = ?;");
+        success = success && stmt != nullptr;
+        for (size_t row = 0; success && row < user_ids.size(); row++) {
+            const uint64_t* words = grades.bitmaps.data() + row * grades.words_per_sheet;
+            for (size_t w = 0; success && w < grades.words_per_sheet; w++) {
+                for (uint64_t bits = words[w]; success && bits; bits &= bits - 1) {
+                    size_t column = w * 64 + __builtin_ctzll(bits);
+                    sqlite3_reset(stmt);
+                    sqlite3_bind_int(stmt, 1, user_ids[row]);
+                    sqlite3_bind_int(stmt, 2, room_id);
+                    sqlite3_bind_int(stmt, 3, question_ids[column]);
+                    success = sqlite3_step(stmt) == SQLITE_DONE;
+                }
+            }
+        }
+    }
+    {
+        CachedStatement stmt(this, "UPDATE RoomParticipants SET score = ? WHERE room_id = ? AND user_id = ?;");
+        success = success && stmt != nullptr;
+        for (size_t row = 0; success && row < user_ids.size(); row++) {
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 1, static_cast<int>(grades.scores[row]));
+            sqlite3_bind_int(stmt, 2, room_id);
+            sqlite3_bind_int(stmt, 3, user_ids[row]);
+            success = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+    }
+    {
+        CachedStatement stmt(this, "UPDATE RoomParticipants SET status = 'SUBMITTED' WHERE room_id = ?;");
+        success = success && stmt != nullptr;
+        if (success) {
+            sqlite3_bind_int(stmt, 1, room_id);
+            success = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+    }
+    {
+        CachedStatement stmt(this, "UPDATE TestRooms SET status = 'FINISHED' WHERE room_id = ?;");
+        success = success && stmt != nullptr;
+        if (success) {
+            sqlite3_bind_int(stmt, 1, room_id);
+            success = sqlite3_step(stmt) == SQLITE_DONE;
+        }
+    }
+    
+    if (!success || !execute_sql("COMMIT;")) {
+        LOG_ERROR("Failed to finish room " + std::to_string(room_id) + ": " + sqlite3_errmsg(db));
+        execute_sql("ROLLBACK;");
+        return false;
+    }
+    return true;
+}
+
 bool Database::update_participant_score(int room_id, int user_id, int score) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "UPDATE RoomParticipants SET score = ? WHERE room_id = ? AND user_id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -820,16 +1232,15 @@ bool Database::update_participant_score(int room_id, int user_id, int score) {
     sqlite3_bind_int(stmt, 3, user_id);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
 bool Database::update_participant_status(int room_id, int user_id, const std::string& status) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     const char* sql = "UPDATE RoomParticipants SET status = ? WHERE room_id = ? AND user_id = ?;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, sql);
+    if (!stmt) {
         return false;
     }
     
@@ -838,19 +1249,18 @@ bool Database::update_participant_status(int room_id, int user_id, const std::st
     sqlite3_bind_int(stmt, 3, user_id);
     
     bool success = sqlite3_step(stmt) == SQLITE_DONE;
-    sqlite3_finalize(stmt);
     
     return success;
 }
 
 // Statistics operations (placeholder implementations)
 json Database::get_user_practice_history(int user_id) {
+    ReadLease reader(this);
     json history = json::array();
     const char* sql = "SELECT practice_id, correct_count, total_questions, score_percentage, completed_at "
                      "FROM PracticeHistory WHERE user_id = ? ORDER BY completed_at DESC LIMIT 20;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return history;
     }
     
@@ -865,20 +1275,19 @@ json Database::get_user_practice_history(int user_id) {
         history.push_back(item);
     }
     
-    sqlite3_finalize(stmt);
     return history;
 }
 
 json Database::get_user_test_history(int user_id) {
+    ReadLease reader(this);
     json history = json::array();
     const char* sql = "SELECT tr.name, rp.score, tr.num_questions, rp.joined_at "
                      "FROM RoomParticipants rp "
                      "JOIN TestRooms tr ON rp.room_id = tr.room_id "
                      "WHERE rp.user_id = ? AND tr.status = 'FINISHED' "
                      "ORDER BY rp.joined_at DESC LIMIT 20;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return history;
     }
     
@@ -894,11 +1303,11 @@ json Database::get_user_test_history(int user_id) {
         history.push_back(item);
     }
     
-    sqlite3_finalize(stmt);
     return history;
 }
 
 json Database::get_user_statistics(int user_id) {
+    std::lock_guard<std::recursive_mutex> lock(db_mutex);
     (void)user_id; // TODO: Implement statistics aggregation
     json stats;
     stats["score_over_time"] = json::array();
@@ -907,15 +1316,15 @@ json Database::get_user_statistics(int user_id) {
 }
 
 json Database::get_room_results(int room_id) {
+    ReadLease reader(this);
     json results = json::array();
     const char* sql = "SELECT u.username, rp.score, tr.num_questions "
                      "FROM RoomParticipants rp "
                      "JOIN Users u ON rp.user_id = u.user_id "
                      "JOIN TestRooms tr ON rp.room_id = tr.room_id "
                      "WHERE rp.room_id = ? ORDER BY rp.score DESC;";
-    sqlite3_stmt* stmt;
-    
-    if (sqlite3_prepare_v2(db, sql, -1, &stmt, nullptr) != SQLITE_OK) {
+    CachedStatement stmt(this, reader, sql);
+    if (!stmt) {
         return results;
     }
     
@@ -929,7 +1338,6 @@ json Database::get_room_results(int room_id) {
         results.push_back(item);
     }
     
-    sqlite3_finalize(stmt);
     return results;
 }
 
@@ -0,0 +1,113 @@
+#include "../include/epoll_backend.h"
+#include "../include/logger.h"
+#include <unistd.h>
+#include <errno.h>
+
+EpollBackend::EpollBackend() : epoll_fd(-1), listen_fd(-1), wakeup_fd(-1), timer_fd(-1), stats(nullptr) {
+}
+
+EpollBackend::~EpollBackend() {
+    if (epoll_fd >= 0) {
+        close(epoll_fd);
+    }
+}
+
+bool EpollBackend::setup(int listen_socket, int wakeup_eventfd, int timerfd, IoStats* io_stats) {
+    listen_fd = listen_socket;
+    wakeup_fd = wakeup_eventfd;
+    timer_fd = timerfd;
+    stats = io_stats;
+    
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        LOG_ERROR("Failed to create epoll");
+        return false;
+    }
+    
+    // Add server socket to epoll
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.fd = listen_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event) < 0) {
+        LOG_ERROR("Failed to add server socket to epoll");
+        return false;
+    }
+    
+    // Add wakeup eventfd (cross-worker broadcasts and stop requests)
+    event.events = EPOLLIN;
+    event.data.fd = wakeup_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wakeup_fd, &event) < 0) {
+        LOG_ERROR("Failed to add eventfd to epoll");
+        return false;
+    }
+    
+    // Add timerfd (deadlines, idle connections, housekeeping)
+    event.events = EPOLLIN;
+    event.data.fd = timer_fd;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event) < 0) {
+        LOG_ERROR("Failed to add timerfd to epoll");
+        return false;
+    }
+    
+    LOG_INFO("Epoll initialized");
+    return true;
+}
+
+bool EpollBackend::add_client(int fd) {
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLOUT | EPOLLET; // Edge-triggered (EPOLLOUT fires when a full buffer drains)
+    event.data.fd = fd;
+    stats->other_calls++;
+    
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        LOG_ERROR("Failed to add client to epoll");
+        return false;
+    }
+    return true;
+}
+
+void EpollBackend::remove_client(int fd) {
+    stats->other_calls++;
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+bool EpollBackend::wait(std::vector<IoEvent>& events, int timeout_ms) {
+    events.clear();
+    
+    stats->wait_calls++;
+    int nfds = epoll_wait(epoll_fd, ready, MAX_EVENTS, timeout_ms);
+    if (nfds < 0) {
+        if (errno == EINTR) {
+            return true;
+        }
+        LOG_ERROR("epoll_wait failed");
+        return false;
+    }
+    
+    for (int i = 0; i < nfds; ++i) {
+        int fd = ready[i].data.fd;
+        uint32_t flags = ready[i].events;
+        
+        if (fd == listen_fd) {
+            events.push_back(IoEvent{IO_LISTEN_READY, fd, nullptr, 0, false});
+        } else if (fd == wakeup_fd) {
+            events.push_back(IoEvent{IO_WAKEUP, fd, nullptr, 0, false});
+        } else if (fd == timer_fd) {
+            events.push_back(IoEvent{IO_TIMER, fd, nullptr, 0, false});
+        } else {
+            // Writable first: queued output goes out before new requests add more
+            if (flags & EPOLLOUT) {
+                events.push_back(IoEvent{IO_WRITABLE, fd, nullptr, 0, false});
+            }
+            // Errors/hangup surface as a failed recv
+            if (flags & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+                events.push_back(IoEvent{IO_READABLE, fd, nullptr, 0, false});
+            }
+        }
+    }
+    return true;
+}
+
+SendResult EpollBackend::flush(int fd, OutputQueue& queue) {
+    return queue.flush(fd, stats);
+}
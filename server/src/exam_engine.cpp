@@ -0,0 +1,162 @@
+#include "../include/exam_engine.h"
+
+std::shared_ptr<ExamRoom> ExamEngine::find(int room_id) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    auto it = rooms.find(room_id);
+    return it == rooms.end() ? nullptr : it->second;
+}
+
+bool ExamEngine::start(int room_id, const std::vector<int>& question_ids, const std::vector<int>& user_ids,
+                       time_t end_time) {
+    std::shared_ptr<ExamRoom> room = std::make_shared<ExamRoom>();
+    room->room_id = room_id;
+    room->end_time = end_time;
+    room->question_ids = question_ids;
+    room->user_ids = user_ids;
+    room->sheets.reset(user_ids.size(), question_ids.size());
+    room->submitted.assign(user_ids.size(), 0);
+    room->question_slots.reserve(question_ids.size());
+    for (size_t i = 0; i < question_ids.size(); i++) {
+        room->question_slots[question_ids[i]] = static_cast<uint32_t>(i);
+    }
+    room->participant_slots.reserve(user_ids.size());
+    for (size_t i = 0; i < user_ids.size(); i++) {
+        room->participant_slots[user_ids[i]] = static_cast<uint32_t>(i);
+    }
+    
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    return rooms.emplace(room_id, room).second;
+}
+
+ExamChange ExamEngine::apply_locked(ExamRoom& room, uint32_t row, int question_id,
+                                    const std::string& selected_option) {
+    auto column = room.question_slots.find(question_id);
+    if (column == room.question_slots.end()) {
+        return ExamChange::UNKNOWN_QUESTION;
+    }
+    uint8_t option = Grader::encode_option(selected_option);
+    if (option == OPTION_NONE) {
+        return ExamChange::INVALID_OPTION;
+    }
+    
+    room.sheets.set(row, column->second, option);
+    if (sink) {
+        sink(room.user_ids[row], room.room_id, question_id, selected_option);
+    }
+    return ExamChange::OK;
+}
+
+ExamChange ExamEngine::change_answer(int room_id, int user_id, int question_id, const std::string& selected_option) {
+    std::shared_ptr<ExamRoom> room = find(room_id);
+    if (!room) {
+        return ExamChange::NOT_RUNNING;
+    }
+    
+    std::lock_guard<std::mutex> lock(room->mutex);
+    if (room->finished || room->closed) {
+        return ExamChange::NOT_RUNNING;
+    }
+    auto row = room->participant_slots.find(user_id);
+    if (row == room->participant_slots.end()) {
+        return ExamChange::NOT_PARTICIPANT;
+    }
+    if (room->submitted[row->second]) {
+        return ExamChange::SUBMITTED;
+    }
+    return apply_locked(*room, row->second, question_id, selected_option);
+}
+
+ExamChange ExamEngine::submit(int room_id, int user_id, const std::vector<std::pair<int, std::string>>& answers,
+                              bool& all_submitted) {
+    all_submitted = false;
+    std::shared_ptr<ExamRoom> room = find(room_id);
+    if (!room) {
+        return ExamChange::NOT_RUNNING;
+    }
+    
+    std::lock_guard<std::mutex> lock(room->mutex);
+    if (room->finished) {
+        return ExamChange::NOT_RUNNING;
+    }
+    auto row = room->participant_slots.find(user_id);
+    if (row == room->participant_slots.end()) {
+        return ExamChange::NOT_PARTICIPANT;
+    }
+    if (room->submitted[row->second]) {
+        return ExamChange::SUBMITTED;
+    }
+    
+    for (const auto& answer : answers) {
+        apply_locked(*room, row->second, answer.first, answer.second);
+    }
+    room->submitted[row->second] = 1;
+    room->submitted_count++;
+    all_submitted = room->submitted_count == room->user_ids.size();
+    return ExamChange::OK;
+}
+
+bool ExamEngine::withdraw(int room_id, int user_id) {
+    std::shared_ptr<ExamRoom> room = find(room_id);
+    if (!room) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(room->mutex);
+    auto row = room->participant_slots.find(user_id);
+    if (room->finished || row == room->participant_slots.end() || !room->submitted[row->second]) {
+        return false;
+    }
+    room->submitted[row->second] = 0;
+    room->submitted_count--;
+    return true;
+}
+
+std::shared_ptr<ExamRoom> ExamEngine::finish(int room_id) {
+    std::shared_ptr<ExamRoom> room;
+    {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        auto it = rooms.find(room_id);
+        if (it == rooms.end()) {
+            return nullptr;
+        }
+        room = it->second;
+        rooms.erase(it);
+    }
+    
+    // Waits for a change in progress: its answer has reached the sink
+    std::lock_guard<std::mutex> lock(room->mutex);
+    room->finished = true;
+    return room;
+}
+
+void ExamEngine::restore(const std::shared_ptr<ExamRoom>& room) {
+    {
+        std::lock_guard<std::mutex> lock(room->mutex);
+        room->finished = false;
+        room->closed = true;
+    }
+    
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    rooms.emplace(room->room_id, room);
+}
+
+bool ExamEngine::close(int room_id) {
+    std::shared_ptr<ExamRoom> room = find(room_id);
+    if (!room) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(room->mutex);
+    room->closed = true;
+    return !room->finished;
+}
+
+bool ExamEngine::is_running(int room_id) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return rooms.count(room_id) > 0;
+}
+
+size_t ExamEngine::running_count() {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return rooms.size();
+}
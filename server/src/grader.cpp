@@ -0,0 +1,183 @@
+#include "../include/grader.h"
+#include <algorithm>
+#include <mutex>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define GRADER_X86 1
+#endif
+
+// Questions per bitmap word; rows are padded to a multiple of it
+static const size_t SHEET_BLOCK = 64;
+
+uint8_t Grader::encode_option(const std::string& option) {
+    size_t start = option.compare(0, 7, "option_") == 0 ? 7 : 0;
+    if (option.size() != start + 1) {
+        return OPTION_NONE;
+    }
+    char letter = option[start];
+    return letter >= 'a' && letter <= 'd' ? static_cast<uint8_t>(letter - 'a') : OPTION_NONE;
+}
+
+size_t Grader::grade(const uint8_t* selected, const uint8_t* key, size_t count) {
+    size_t correct = 0;
+    for (size_t i = 0; i < count; i++) {
+        correct += selected[i] == key[i] && key[i] != OPTION_NONE;
+    }
+    return correct;
+}
+
+void AnswerSheets::reset(size_t participants, size_t questions) {
+    participant_count = participants;
+    question_count = questions;
+    row_stride = (questions + SHEET_BLOCK - 1) / SHEET_BLOCK * SHEET_BLOCK;
+    cells.assign(participants * row_stride, OPTION_NONE);
+}
+
+// Bit i of the result: selected[i] == key[i] and key[i] is a real option
+static uint64_t grade_block_scalar(const uint8_t* selected, const uint8_t* key) {
+    uint64_t bits = 0;
+    for (size_t i = 0; i < SHEET_BLOCK; i++) {
+        bits |= static_cast<uint64_t>(selected[i] == key[i] && key[i] != OPTION_NONE) << i;
+    }
+    return bits;
+}
+
+#ifdef GRADER_X86
+static uint64_t grade_block_sse2(const uint8_t* selected, const uint8_t* key) {
+    const __m128i none = _mm_set1_epi8(static_cast<char>(OPTION_NONE));
+    uint64_t bits = 0;
+    for (size_t i = 0; i < SHEET_BLOCK; i += 16) {
+        __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(selected + i));
+        __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i*>(key + i));
+        __m128i match = _mm_andnot_si128(_mm_cmpeq_epi8(k, none), _mm_cmpeq_epi8(s, k));
+        bits |= static_cast<uint64_t>(static_cast<uint16_t>(_mm_movemask_epi8(match))) << i;
+    }
+    return bits;
+}
+
+__attribute__((target("avx2")))
+static uint64_t grade_block_avx2(const uint8_t* selected, const uint8_t* key) {
+    const __m256i none = _mm256_set1_epi8(static_cast<char>(OPTION_NONE));
+    uint64_t bits = 0;
+    for (size_t i = 0; i < SHEET_BLOCK; i += 32) {
+        __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(selected + i));
+        __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + i));
+        __m256i match = _mm256_andnot_si256(_mm256_cmpeq_epi8(k, none), _mm256_cmpeq_epi8(s, k));
+        bits |= static_cast<uint64_t>(static_cast<uint32_t>(_mm256_movemask_epi8(match))) << i;
+    }
+    return bits;
+}
+#endif
+
+// One loop per kernel so the block function inlines into it
+template <uint64_t (*grade_block)(const uint8_t*, const uint8_t*)>
+static void grade_rows(const AnswerSheets& sheets, const uint8_t* key, SheetGrades& grades) {
+    for (size_t p = 0; p < sheets.participants(); p++) {
+        const uint8_t* row = sheets.row(p);
+        uint64_t* words = grades.bitmaps.data() + p * grades.words_per_sheet;
+        uint32_t score = 0;
+        for (size_t w = 0; w < grades.words_per_sheet; w++) {
+            words[w] = grade_block(row + w * SHEET_BLOCK, key + w * SHEET_BLOCK);
+            score += static_cast<uint32_t>(__builtin_popcountll(words[w]));
+        }
+        grades.scores[p] = score;
+    }
+}
+
+#ifdef GRADER_X86
+__attribute__((target("avx2,popcnt")))
+static void grade_rows_avx2(const AnswerSheets& sheets, const uint8_t* key, SheetGrades& grades) {
+    grade_rows<grade_block_avx2>(sheets, key, grades);
+}
+#endif
+
+void Grader::grade_sheets(const AnswerSheets& sheets, const uint8_t* key, SheetGrades& grades,
+                          GradeKernel kernel) {
+    grades.words_per_sheet = sheets.stride() / SHEET_BLOCK;
+    grades.scores.assign(sheets.participants(), 0);
+    grades.bitmaps.assign(sheets.participants() * grades.words_per_sheet, 0);
+    
+    // Key padded like the rows: padding never matches
+    std::vector<uint8_t> padded(sheets.stride(), OPTION_NONE);
+    std::copy(key, key + sheets.questions(), padded.begin());
+    
+    if (kernel == GradeKernel::AUTO || !kernel_supported(kernel)) {
+        kernel = kernel == GradeKernel::AUTO ? best_kernel() : GradeKernel::SCALAR;
+    }
+    switch (kernel) {
+#ifdef GRADER_X86
+        case GradeKernel::AVX2:
+            grade_rows_avx2(sheets, padded.data(), grades);
+            break;
+        case GradeKernel::SSE2:
+            grade_rows<grade_block_sse2>(sheets, padded.data(), grades);
+            break;
+#endif
+        default:
+            grade_rows<grade_block_scalar>(sheets, padded.data(), grades);
+            break;
+    }
+}
+
+bool Grader::kernel_supported(GradeKernel kernel) {
+    switch (kernel) {
+        case GradeKernel::AUTO:
+        case GradeKernel::SCALAR:
+            return true;
+#ifdef GRADER_X86
+        case GradeKernel::SSE2:
+            return __builtin_cpu_supports("sse2");
+        case GradeKernel::AVX2:
+            return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt");
+#endif
+        default:
+            return false;
+    }
+}
+
+GradeKernel Grader::best_kernel() {
+    static const GradeKernel best = kernel_supported(GradeKernel::AVX2) ? GradeKernel::AVX2
+                                    : kernel_supported(GradeKernel::SSE2) ? GradeKernel::SSE2
+                                    : GradeKernel::SCALAR;
+    return best;
+}
+
+const char* Grader::kernel_name(GradeKernel kernel) {
+    switch (kernel) {
+        case GradeKernel::AUTO:   return kernel_name(best_kernel());
+        case GradeKernel::SCALAR: return "scalar";
+        case GradeKernel::SSE2:   return "sse2";
+        case GradeKernel::AVX2:   return "avx2";
+    }
+    return "unknown";
+}
+
+void AnswerKeyTable::set(int question_id, const std::string& correct_option) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    keys[question_id] = Grader::encode_option(correct_option);
+}
+
+void AnswerKeyTable::remove(int question_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    keys.erase(question_id);
+}
+
+void AnswerKeyTable::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    keys.clear();
+}
+
+void AnswerKeyTable::lookup(const std::vector<int>& question_ids, std::vector<uint8_t>& key) {
+    key.resize(question_ids.size());
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    for (size_t i = 0; i < question_ids.size(); i++) {
+        auto it = keys.find(question_ids[i]);
+        key[i] = it == keys.end() ? OPTION_NONE : it->second;
+    }
+}
+
+size_t AnswerKeyTable::size() {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return keys.size();
+}
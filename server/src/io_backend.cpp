@@ -0,0 +1,28 @@
+#include "../include/io_backend.h"
+#include "../include/epoll_backend.h"
+#include "../include/uring_backend.h"
+#include "../include/logger.h"
+
+IoBackend* IoBackend::create(IoBackendKind kind) {
+    if (kind == IO_BACKEND_URING) {
+        UringBackend* uring = new UringBackend();
+        if (uring->init()) {
+            return uring;
+        }
+        delete uring;
+        LOG_WARN("io_uring unavailable, falling back to epoll");
+    }
+    return new EpollBackend();
+}
+
+bool IoBackend::parse_kind(const std::string& name, IoBackendKind& kind) {
+    if (name == "epoll") {
+        kind = IO_BACKEND_EPOLL;
+        return true;
+    }
+    if (name == "uring" || name == "io_uring") {
+        kind = IO_BACKEND_URING;
+        return true;
+    }
+    return false;
+}
@@ -1,21 +1,16 @@
-#include "../include/server.h"
+#include "../include/worker_group.h"
 #include "../include/database.h"
 #include "../include/logger.h"
+#include "../include/session.h"
+#include "../include/answer_writer.h"
+#include <algorithm>
+#include <atomic>
 #include <iostream>
+#include <memory>
 #include <signal.h>
+#include <thread>
 #include <unistd.h>
 
-// Global server instance for signal handling
-Server* g_server = nullptr;
-
-void signal_handler(int signum) {
-    LOG_INFO("Received signal " + std::to_string(signum) + ", shutting down...");
-    if (g_server) {
-        g_server->stop();
-    }
-    exit(0);
-}
-
 int main(int argc, char* argv[]) {
     std::cout << "=====================================" << std::endl;
     std::cout << "Online Testing System - Server" << std::endl;
@@ -24,6 +19,19 @@ int main(int argc, char* argv[]) {
     // Parse command line arguments
     int port = 8888; // Default port
     std::string db_path = "testing_app.db"; // Default database
+    int num_workers = 1; // Event loop threads
+    int backlog = DEFAULT_LISTEN_BACKLOG; // Pending connections per listening socket
+    int pool_threads = DEFAULT_POOL_THREADS; // Database handler threads
+    int hash_threads = DEFAULT_HASH_THREADS; // Password hashing threads
+    int kdf_iterations = DEFAULT_KDF_ITERATIONS; // PBKDF2 work factor for new hashes
+    std::string io_name = "epoll"; // Network backend
+    DatabaseConfig db_config; // WAL, read connections, mmap/cache sizes
+    int db_readers = -1; // -1 = one per thread that queries the database
+    std::string token_mode = "db"; // Session tokens: database rows or HMAC-signed
+    std::string token_keys; // Signing keys file (signed tokens)
+    int answer_flush_ms = DEFAULT_ANSWER_FLUSH_MS; // Answer batch interval (0 = write every click)
+    int answer_flush_rows = DEFAULT_ANSWER_FLUSH_ROWS; // Pending answers that trigger an early batch
+    int idle_timeout = 0; // Seconds before a silent connection is closed (0 = never)
     
     for (int i = 1; i < argc; i++) {
         std::string arg = argv[i];
@@ -35,11 +43,106 @@ int main(int argc, char* argv[]) {
             if (i + 1 < argc) {
                 db_path = argv[++i];
             }
+        } else if (arg == "--workers" || arg == "-w") {
+            if (i + 1 < argc) {
+                num_workers = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--backlog" || arg == "-b") {
+            if (i + 1 < argc) {
+                backlog = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--db-threads" || arg == "-t") {
+            if (i + 1 < argc) {
+                pool_threads = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--hash-threads") {
+            if (i + 1 < argc) {
+                hash_threads = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--kdf-iterations") {
+            if (i + 1 < argc) {
+                kdf_iterations = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--io" || arg == "-i") {
+            if (i + 1 < argc) {
+                io_name = argv[++i];
+            }
+        } else if (arg == "--db-readers") {
+            if (i + 1 < argc) {
+                db_readers = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--db-mmap-mb") {
+            if (i + 1 < argc) {
+                db_config.mmap_size = std::atoll(argv[++i]) * 1024 * 1024;
+            }
+        } else if (arg == "--db-cache-mb") {
+            if (i + 1 < argc) {
+                db_config.cache_size_kib = std::atoi(argv[++i]) * 1024;
+            }
+        } else if (arg == "--wal-checkpoint") {
+            if (i + 1 < argc) {
+                db_config.wal_autocheckpoint = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--question-cache") {
+            if (i + 1 < argc) {
+                db_config.question_cache_size = std::max(std::atoll(argv[++i]), 0LL);
+            }
+        } else if (arg == "--no-wal") {
+            db_config.wal = false;
+        } else if (arg == "--answer-flush-ms") {
+            if (i + 1 < argc) {
+                answer_flush_ms = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--answer-flush-rows") {
+            if (i + 1 < argc) {
+                answer_flush_rows = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--idle-timeout") {
+            if (i + 1 < argc) {
+                idle_timeout = std::atoi(argv[++i]);
+            }
+        } else if (arg == "--tokens") {
+            if (i + 1 < argc) {
+                token_mode = argv[++i];
+            }
+        } else if (arg == "--token-keys") {
+            if (i + 1 < argc) {
+                token_keys = argv[++i];
+            }
         } else if (arg == "--help" || arg == "-h") {
             std::cout << "Usage: " << argv[0] << " [options]" << std::endl;
             std::cout << "Options:" << std::endl;
             std::cout << "  --port, -p <port>    Server port (default: 8888)" << std::endl;
             std::cout << "  --db, -d <path>      Database path (default: testing_app.db)" << std::endl;
+            std::cout << "  --workers, -w <n>    Event loop threads (default: 1)" << std::endl;
+            std::cout << "  --backlog, -b <n>    Listen backlog per worker (default: " << DEFAULT_LISTEN_BACKLOG
+                      << ", capped by net.core.somaxconn)" << std::endl;
+            std::cout << "  --db-threads, -t <n> Database handler threads (default: " << DEFAULT_POOL_THREADS
+                      << ", 0 = run on event loop)" << std::endl;
+            std::cout << "  --hash-threads <n>   Password hashing threads (default: " << DEFAULT_HASH_THREADS
+                      << ", 0 = hash on event loop)" << std::endl;
+            std::cout << "  --kdf-iterations <n> PBKDF2 iterations for new password hashes (default: "
+                      << DEFAULT_KDF_ITERATIONS << ")" << std::endl;
+            std::cout << "  --io, -i <backend>   Network backend: epoll or uring (default: epoll)" << std::endl;
+            std::cout << "  --db-readers <n>     Read-only database connections (default: workers + db threads"
+                      << " + hash threads, 0 = reads use the writer)" << std::endl;
+            std::cout << "  --db-mmap-mb <n>     SQLite mmap_size per connection in MiB (default: "
+                      << (DEFAULT_DB_MMAP_SIZE >> 20) << ")" << std::endl;
+            std::cout << "  --db-cache-mb <n>    SQLite page cache per connection in MiB (default: "
+                      << (DEFAULT_DB_CACHE_KIB >> 10) << ")" << std::endl;
+            std::cout << "  --wal-checkpoint <n> WAL pages before an automatic checkpoint (default: "
+                      << DEFAULT_WAL_AUTOCHECKPOINT << ")" << std::endl;
+            std::cout << "  --question-cache <n> Decoded questions kept in memory, 0 = off (default: "
+                      << DEFAULT_QUESTION_CACHE_SIZE << ")" << std::endl;
+            std::cout << "  --no-wal             Keep the rollback journal (no read connections)" << std::endl;
+            std::cout << "  --answer-flush-ms <n>   Answer batch interval in ms, 0 = write every click (default: "
+                      << DEFAULT_ANSWER_FLUSH_MS << ")" << std::endl;
+            std::cout << "  --answer-flush-rows <n> Pending answers that start a batch early (default: "
+                      << DEFAULT_ANSWER_FLUSH_ROWS << ")" << std::endl;
+            std::cout << "  --idle-timeout <s>   Close connections silent for this many seconds, 0 = never"
+                      << " (default: 0)" << std::endl;
+            std::cout << "  --tokens <mode>      Session tokens: db or signed (default: db)" << std::endl;
+            std::cout << "  --token-keys <file>  Signing keys, \"<key id> <secret>\" per line, last one signs" << std::endl;
             std::cout << "  --help, -h           Show this help message" << std::endl;
             return 0;
         }
@@ -47,8 +150,43 @@ int main(int argc, char* argv[]) {
     
     std::cout << "Port: " << port << std::endl;
     std::cout << "Database: " << db_path << std::endl;
+    std::cout << "Workers: " << num_workers << std::endl;
+    std::cout << "Backlog: " << backlog << std::endl;
+    std::cout << "DB threads: " << pool_threads << std::endl;
+    std::cout << "Hash threads: " << hash_threads << " (" << kdf_iterations << " iterations)" << std::endl;
+    std::cout << "I/O backend: " << io_name << std::endl;
+    std::cout << "Tokens: " << token_mode << std::endl;
+    if (idle_timeout > 0) {
+        std::cout << "Idle timeout: " << idle_timeout << " s" << std::endl;
+    }
+    if (answer_flush_ms > 0) {
+        std::cout << "Answer batches: every " << answer_flush_ms << " ms or " << answer_flush_rows << " answers" << std::endl;
+    } else {
+        std::cout << "Answer batches: off" << std::endl;
+    }
     std::cout << "=====================================" << std::endl;
     
+    IoBackendKind io_kind;
+    if (!IoBackend::parse_kind(io_name, io_kind)) {
+        std::cerr << "Unknown I/O backend: " << io_name << " (expected epoll or uring)" << std::endl;
+        return 1;
+    }
+    if (token_mode != "db" && token_mode != "signed") {
+        std::cerr << "Unknown token mode: " << token_mode << " (expected db or signed)" << std::endl;
+        return 1;
+    }
+    
+    SessionManager::set_kdf_iterations(kdf_iterations);
+    
+    // Shutdown signals: blocked before any thread starts (every thread
+    // inherits the mask) and taken by sigwait below, so no handler ever
+    // interrupts a worker holding a lock or inside SQLite
+    sigset_t shutdown_signals;
+    sigemptyset(&shutdown_signals);
+    sigaddset(&shutdown_signals, SIGINT);
+    sigaddset(&shutdown_signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &shutdown_signals, nullptr);
+    
     // Initialize logger
     Logger::get_instance()->set_min_level(INFO);
     LOG_INFO("=== Server Starting ===");
@@ -66,24 +204,69 @@ int main(int argc, char* argv[]) {
         return 1;
     }
     
+    // Every event loop and pool thread may query: one reader each
+    db_config.read_connections = db_readers >= 0 ? db_readers
+        : num_workers + std::max(pool_threads, 0) + std::max(hash_threads, 0);
+    if (!db.configure(db_config)) {
+        LOG_ERROR("Failed to configure database");
+        return 1;
+    }
+    
     LOG_INFO("Database initialized successfully");
     
+    // Signed tokens: keys from the file, or a random one for this run
+    // (declared before the server: outlives its workers)
+    TokenSigner signer;
+    if (token_mode == "signed") {
+        bool keys_ok = token_keys.empty() ? signer.generate_key() : signer.load_key_file(token_keys);
+        if (!keys_ok) {
+            LOG_ERROR("Failed to load token keys");
+            return 1;
+        }
+    }
+    
+    // Answer write-behind queue (declared before the server: outlives its workers)
+    std::unique_ptr<AnswerWriter> answer_writer;
+    if (answer_flush_ms > 0) {
+        answer_writer.reset(new AnswerWriter(&db, answer_flush_ms, std::max(answer_flush_rows, 1)));
+    }
+    
     // Create server
     LOG_INFO("Creating server on port " + std::to_string(port) + "...");
-    Server server(port, &db);
-    g_server = &server;
+    WorkerGroup server(port, &db, num_workers, backlog, pool_threads, io_kind, hash_threads);
+    if (token_mode == "signed") {
+        server.set_token_signer(&signer);
+    }
+    if (answer_writer) {
+        server.set_answer_writer(answer_writer.get());
+    }
+    server.set_idle_timeout(idle_timeout);
     
-    // Setup signal handlers
-    signal(SIGINT, signal_handler);
-    signal(SIGTERM, signal_handler);
+    // SIGINT / SIGTERM stop the event loops; start() then returns and the
+    // destructors run (the answer writer stores what is still queued)
+    std::atomic<bool> exiting(false);
+    std::thread signal_thread([&server, &exiting, shutdown_signals]() {
+        int signum = 0;
+        if (sigwait(&shutdown_signals, &signum) == 0 && !exiting) {
+            LOG_INFO("Received signal " + std::to_string(signum) + ", shutting down...");
+            server.stop();
+        }
+    });
     
     // Start server (blocking)
     LOG_INFO("Starting server...");
-    if (!server.start()) {
+    bool started = server.start();
+    
+    // Release the signal thread before the server goes away
+    exiting = true;
+    pthread_kill(signal_thread.native_handle(), SIGTERM);
+    signal_thread.join();
+    
+    if (!started) {
         LOG_ERROR("Failed to start server");
         return 1;
     }
-    
+    LOG_INFO("=== Server Stopped ===");
     return 0;
 }
 
@@ -1,6 +1,7 @@
 #include "../include/protocol.h"
 #include "../include/logger.h"
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <cstring>
@@ -21,29 +22,15 @@ bool Protocol::send_exact(int sockfd, const char* buffer, size_t length) {
     return true;
 }
 
-#include <poll.h>
-
 bool Protocol::recv_exact(int sockfd, char* buffer, size_t length) {
     size_t total_received = 0;
     while (total_received < length) {
         ssize_t received = recv(sockfd, buffer + total_received, length - total_received, 0);
         if (received < 0) {
-            // Non-blocking socket: EAGAIN/EWOULDBLOCK means no data available yet
+            // Non-blocking socket: EAGAIN/EWOULDBLOCK means no data available yet.
+            // Never wait here - it would stall every other client on the loop.
             if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // If we have already received some data (or we are in the middle of a message body known by header),
-                // we should wait a bit for the rest instead of failing immediately.
-                // Using poll to wait up to 500ms for data
-                struct pollfd pfd;
-                pfd.fd = sockfd;
-                pfd.events = POLLIN;
-                int ret = poll(&pfd, 1, 500); // Wait 500ms
-                
-                if (ret > 0 && (pfd.revents & POLLIN)) {
-                    continue; // Data available, try recv again
-                }
-                
-                // Still no data after wait, or error
-                return false; 
+                return false;
             }
             // Other error
             LOG_ERROR("recv() failed: " + std::string(strerror(errno)));
@@ -58,29 +45,66 @@ bool Protocol::recv_exact(int sockfd, char* buffer, size_t length) {
     return true;
 }
 
+void Protocol::write_header(char* header, uint16_t msg_type, uint32_t payload_length) {
+    // Write as raw bytes (network byte order) to avoid struct padding
+    uint16_t msg_type_net = htons(msg_type);
+    uint32_t payload_length_net = htonl(payload_length);
+    memcpy(header, &msg_type_net, 2);
+    memcpy(header + 2, &payload_length_net, 4);
+}
+
+SharedPayload Protocol::serialize(const json& payload) {
+    return std::make_shared<const std::string>(payload.dump());
+}
+
 bool Protocol::send_message(int sockfd, uint16_t msg_type, const json& payload) {
     try {
         // Serialize payload to JSON string
         std::string payload_str = payload.dump();
         uint32_t payload_length = payload_str.length();
         
-        // Prepare header (network byte order) - write as raw bytes to avoid struct padding
         char header_buf[6];
-        uint16_t msg_type_net = htons(msg_type);
-        uint32_t payload_length_net = htonl(payload_length);
-        memcpy(header_buf, &msg_type_net, 2);
-        memcpy(header_buf + 2, &payload_length_net, 4);
+        write_header(header_buf, msg_type, payload_length);
         
-        // Send header (6 bytes)
-        if (!send_exact(sockfd, header_buf, 6)) {
-            return false;
-        }
+        // Header + payload in one vectored send (no Nagle stall between them)
+        struct iovec iov[2];
+        iov[0].iov_base = header_buf;
+        iov[0].iov_len = 6;
+        iov[1].iov_base = const_cast<char*>(payload_str.data());
+        iov[1].iov_len = payload_length;
         
-        // Send payload (if any)
-        if (payload_length > 0) {
-            if (!send_exact(sockfd, payload_str.c_str(), payload_length)) {
+        struct msghdr msg_hdr;
+        memset(&msg_hdr, 0, sizeof(msg_hdr));
+        msg_hdr.msg_iov = iov;
+        msg_hdr.msg_iovlen = payload_length > 0 ? 2 : 1;
+        
+        size_t remaining = 6 + payload_length;
+        while (remaining > 0) {
+            ssize_t sent = sendmsg(sockfd, &msg_hdr, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) {
+                continue;
+            }
+            if (sent <= 0) {
+                if (sent < 0) {
+                    LOG_ERROR("sendmsg() failed: " + std::string(strerror(errno)));
+                }
                 return false;
             }
+            
+            // Partial write: advance the iovecs
+            remaining -= sent;
+            size_t advance = sent;
+            while (advance > 0 && msg_hdr.msg_iovlen > 0) {
+                if (advance >= msg_hdr.msg_iov[0].iov_len) {
+                    advance -= msg_hdr.msg_iov[0].iov_len;
+                    msg_hdr.msg_iov++;
+                    msg_hdr.msg_iovlen--;
+                } else {
+                    msg_hdr.msg_iov[0].iov_base = static_cast<char*>(msg_hdr.msg_iov[0].iov_base) + advance;
+                    msg_hdr.msg_iov[0].iov_len -= advance;
+                    advance = 0;
+                }
+            }
         }
         
         LOG_DEBUG("Sent message type " + std::to_string(msg_type) + 
@@ -121,7 +145,7 @@ RecvResult Protocol::recv_message(int sockfd, Message& msg) {
         uint32_t payload_length = ntohl(payload_length_raw);
         
         // Validate payload length (max 2MB to prevent DoS)
-        if (payload_length > 2 * 1024 * 1024) {
+        if (payload_length > MAX_PAYLOAD_SIZE) {
             LOG_ERROR("Payload too large: " + std::to_string(payload_length) + " bytes");
             return RECV_ERROR;
         }
@@ -174,6 +198,222 @@ bool Protocol::has_data_available(int sockfd) {
     }
 }
 
+OutputQueue::OutputQueue() : head_offset(0), pending_bytes(0) {
+}
+
+void OutputQueue::push(uint16_t msg_type, std::string payload) {
+    push(msg_type, std::make_shared<const std::string>(std::move(payload)));
+}
+
+void OutputQueue::push(uint16_t msg_type, const SharedPayload& payload) {
+    frames.emplace_back();
+    OutFrame& frame = frames.back();
+    Protocol::write_header(frame.header, msg_type, payload->size());
+    frame.payload = payload;
+    pending_bytes += frame.size();
+}
+
+void OutputQueue::consume(size_t n) {
+    pending_bytes -= n;
+    while (n > 0) {
+        size_t left = frames.front().size() - head_offset;
+        if (n < left) {
+            head_offset += n;
+            return;
+        }
+        n -= left;
+        frames.pop_front();
+        head_offset = 0;
+    }
+}
+
+size_t OutputQueue::gather(const OutFrame* frames, size_t count, size_t head_offset,
+                           struct iovec* iov, size_t max_iovecs) {
+    size_t used = 0;
+    size_t offset = head_offset;
+    for (size_t i = 0; i < count && used + 2 <= max_iovecs; ++i) {
+        const OutFrame& frame = frames[i];
+        if (offset < 6) {
+            iov[used].iov_base = const_cast<char*>(frame.header + offset);
+            iov[used].iov_len = 6 - offset;
+            used++;
+            if (!frame.payload->empty()) {
+                iov[used].iov_base = const_cast<char*>(frame.payload->data());
+                iov[used].iov_len = frame.payload->size();
+                used++;
+            }
+        } else {
+            iov[used].iov_base = const_cast<char*>(frame.payload->data() + (offset - 6));
+            iov[used].iov_len = frame.payload->size() - (offset - 6);
+            used++;
+        }
+        offset = 0;
+    }
+    return used;
+}
+
+size_t OutputQueue::snapshot(std::vector<OutFrame>& out, size_t max_frames) const {
+    size_t count = 0;
+    for (auto it = frames.begin(); it != frames.end() && count < max_frames; ++it, ++count) {
+        out.push_back(*it);
+    }
+    return count;
+}
+
+SendResult OutputQueue::flush(int sockfd, IoStats* stats) {
+    // Up to 32 frames (64 iovecs) per syscall
+    const size_t MAX_IOVECS = 64;
+    struct iovec iov[MAX_IOVECS];
+    
+    while (!frames.empty()) {
+        size_t count = 0;
+        size_t offset = head_offset;
+        for (auto it = frames.begin(); it != frames.end() && count + 2 <= MAX_IOVECS; ++it) {
+            count += gather(&*it, 1, offset, iov + count, MAX_IOVECS - count);
+            offset = 0;
+        }
+        
+        struct msghdr msg_hdr;
+        memset(&msg_hdr, 0, sizeof(msg_hdr));
+        msg_hdr.msg_iov = iov;
+        msg_hdr.msg_iovlen = count;
+        
+        ssize_t sent = sendmsg(sockfd, &msg_hdr, MSG_NOSIGNAL);
+        if (stats) {
+            stats->send_calls++;
+        }
+        if (sent < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                return SEND_PENDING;
+            }
+            LOG_ERROR("sendmsg() failed: " + std::string(strerror(errno)));
+            return SEND_ERROR;
+        }
+        
+        if (stats) {
+            stats->bytes_sent += sent;
+        }
+        consume(sent);
+    }
+    return SEND_DONE;
+}
+
+FrameDecoder::FrameDecoder() : read_pos(0), current_state(READ_HEADER), msg_type(0), payload_length(0) {
+}
+
+RecvResult FrameDecoder::fill(int sockfd, size_t max_buffered, IoStats* stats) {
+    bool got_data = false;
+    char chunk[16384];
+    
+    // Edge-triggered epoll: drain the socket until EAGAIN (or the limit,
+    // in which case the caller must remember to come back)
+    while (max_buffered == 0 || buffered() < max_buffered) {
+        ssize_t received = recv(sockfd, chunk, sizeof(chunk), 0);
+        if (stats) {
+            stats->recv_calls++;
+        }
+        if (received > 0) {
+            feed(chunk, received);
+            got_data = true;
+            continue;
+        }
+        if (received == 0) {
+            return RECV_ERROR; // EOF - connection closed
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return got_data ? RECV_SUCCESS : RECV_NO_DATA;
+        }
+        LOG_ERROR("recv() failed: " + std::string(strerror(errno)));
+        return RECV_ERROR;
+    }
+    return RECV_SUCCESS;
+}
+
+bool FrameDecoder::has_frame() const {
+    if (current_state == READ_PAYLOAD) {
+        return buffered() >= payload_length;
+    }
+    if (buffered() < 6) {
+        return false;
+    }
+    
+    uint32_t payload_length_raw;
+    memcpy(&payload_length_raw, buffer.data() + read_pos + 2, 4);
+    uint32_t length = ntohl(payload_length_raw);
+    return length > MAX_PAYLOAD_SIZE || buffered() - 6 >= length;
+}
+
+void FrameDecoder::feed(const char* data, size_t length) {
+    buffer.insert(buffer.end(), data, data + length);
+}
+
+void FrameDecoder::compact() {
+    if (read_pos == 0) {
+        return;
+    }
+    if (read_pos >= buffer.size()) {
+        buffer.clear();
+    } else {
+        buffer.erase(buffer.begin(), buffer.begin() + read_pos);
+    }
+    read_pos = 0;
+}
+
+RecvResult FrameDecoder::next(Message& msg) {
+    if (current_state == READ_HEADER) {
+        if (buffered() < 6) {
+            compact();
+            return RECV_INCOMPLETE;
+        }
+        
+        uint16_t msg_type_raw;
+        uint32_t payload_length_raw;
+        memcpy(&msg_type_raw, buffer.data() + read_pos, 2);
+        memcpy(&payload_length_raw, buffer.data() + read_pos + 2, 4);
+        msg_type = ntohs(msg_type_raw);
+        payload_length = ntohl(payload_length_raw);
+        
+        if (payload_length > MAX_PAYLOAD_SIZE) {
+            LOG_ERROR("Payload too large: " + std::to_string(payload_length) + " bytes");
+            return RECV_ERROR;
+        }
+        
+        read_pos += 6;
+        current_state = READ_PAYLOAD;
+    }
+    
+    if (buffered() < payload_length) {
+        compact();
+        return RECV_INCOMPLETE;
+    }
+    
+    const char* payload_start = buffer.data() + read_pos;
+    read_pos += payload_length;
+    current_state = READ_HEADER;
+    
+    msg.type = msg_type;
+    if (payload_length > 0) {
+        try {
+            msg.payload = json::parse(payload_start, payload_start + payload_length);
+        } catch (const json::exception& e) {
+            LOG_ERROR("Failed to parse JSON: " + std::string(e.what()));
+            return RECV_ERROR;
+        }
+    } else {
+        msg.payload = json::object();
+    }
+    
+    LOG_DEBUG("Decoded message type " + std::to_string(msg.type) + 
+              " with " + std::to_string(payload_length) + " bytes payload");
+    return RECV_SUCCESS;
+}
+
 json Protocol::create_error_response(int error_code, const std::string& message) {
     json response;
     response["code"] = error_code;
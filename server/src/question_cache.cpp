@@ -0,0 +1,113 @@
+#include "../include/question_cache.h"
+
+QuestionCache::QuestionCache(size_t capacity) : shard_capacity(0) {
+    set_capacity(capacity);
+}
+
+QuestionCache::Shard& QuestionCache::shard_for(int question_id) {
+    // Ids are sequential: consecutive ids land on different shards
+    return shards[static_cast<uint32_t>(question_id) & (QUESTION_CACHE_SHARDS - 1)];
+}
+
+void QuestionCache::set_capacity(size_t capacity) {
+    size_t per_shard = (capacity + QUESTION_CACHE_SHARDS - 1) / QUESTION_CACHE_SHARDS;
+    shard_capacity.store(per_shard, std::memory_order_relaxed);
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        while (shard.lru.size() > per_shard) {
+            shard.entries.erase(shard.lru.back().question_id);
+            shard.lru.pop_back();
+            evictions.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+size_t QuestionCache::capacity() const {
+    return shard_capacity.load(std::memory_order_relaxed) * QUESTION_CACHE_SHARDS;
+}
+
+bool QuestionCache::get(int question_id, Question& question) {
+    if (shard_capacity.load(std::memory_order_relaxed) == 0) {
+        return false;
+    }
+    Shard& shard = shard_for(question_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.entries.find(question_id);
+    if (it == shard.entries.end()) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    question = *it->second;
+    hits.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void QuestionCache::insert_locked(Shard& shard, const Question& question) {
+    size_t per_shard = shard_capacity.load(std::memory_order_relaxed);
+    if (per_shard == 0) {
+        return;
+    }
+    auto it = shard.entries.find(question.question_id);
+    if (it != shard.entries.end()) {
+        *it->second = question;
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return;
+    }
+    if (shard.lru.size() >= per_shard) {
+        shard.entries.erase(shard.lru.back().question_id);
+        shard.lru.pop_back();
+        evictions.fetch_add(1, std::memory_order_relaxed);
+    }
+    shard.lru.push_front(question);
+    shard.entries[question.question_id] = shard.lru.begin();
+}
+
+void QuestionCache::put(const Question& question, uint64_t stamp) {
+    Shard& shard = shard_for(question.question_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if (generation.load(std::memory_order_acquire) == stamp) {
+        insert_locked(shard, question);
+    }
+}
+
+void QuestionCache::put(const Question& question) {
+    Shard& shard = shard_for(question.question_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    insert_locked(shard, question);
+}
+
+void QuestionCache::erase(int question_id) {
+    Shard& shard = shard_for(question_id);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    generation.fetch_add(1, std::memory_order_acq_rel);     // Even if absent: a reader may be about to put it
+    auto it = shard.entries.find(question_id);
+    if (it != shard.entries.end()) {
+        shard.lru.erase(it->second);
+        shard.entries.erase(it);
+        invalidations.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void QuestionCache::clear() {
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        generation.fetch_add(1, std::memory_order_acq_rel);
+        shard.lru.clear();
+        shard.entries.clear();
+    }
+}
+
+QuestionCacheStats QuestionCache::get_stats() {
+    QuestionCacheStats stats;
+    stats.hits = hits.load(std::memory_order_relaxed);
+    stats.misses = misses.load(std::memory_order_relaxed);
+    stats.evictions = evictions.load(std::memory_order_relaxed);
+    stats.invalidations = invalidations.load(std::memory_order_relaxed);
+    stats.capacity = capacity();
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.size += shard.lru.size();
+    }
+    return stats;
+}
@@ -0,0 +1,135 @@
+#include "../include/question_index.h"
+#include <algorithm>
+#include <mutex>
+#include <random>
+#include <unordered_set>
+
+static bool is_wildcard(const std::string& filter) {
+    return filter.empty() || filter == "all";
+}
+
+static std::mt19937_64& thread_rng() {
+    static thread_local std::mt19937_64 rng(std::random_device{}());
+    return rng;
+}
+
+void QuestionIndex::add(int question_id, const std::string& topic, const std::string& difficulty) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    remove_locked(question_id);
+    Partition& partition = partitions[PartitionKey(topic, difficulty)];
+    partition.push_back(question_id);
+    locations[question_id] = Location{&partition, partition.size() - 1};
+}
+
+void QuestionIndex::remove(int question_id) {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    remove_locked(question_id);
+}
+
+void QuestionIndex::remove_locked(int question_id) {
+    auto it = locations.find(question_id);
+    if (it == locations.end()) {
+        return;
+    }
+    Partition& partition = *it->second.partition;
+    size_t position = it->second.position;
+    locations.erase(it);
+    
+    int last = partition.back();
+    partition.pop_back();
+    if (last != question_id) {
+        partition[position] = last;
+        locations[last].position = position;
+    }
+    // Empty partitions stay: sampling skips them and topics are few
+}
+
+void QuestionIndex::clear() {
+    std::unique_lock<std::shared_mutex> lock(mutex);
+    partitions.clear();
+    locations.clear();
+}
+
+std::vector<int> QuestionIndex::sample(int count, const std::string& topic, const std::string& difficulty) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    std::vector<int> result;
+    
+    // Matching partitions, viewed as one range [0, total)
+    std::vector<const Partition*> matched;
+    std::vector<size_t> ends;
+    size_t total = 0;
+    for (const auto& entry : partitions) {
+        if ((is_wildcard(topic) || entry.first.first == topic) &&
+            (is_wildcard(difficulty) || entry.first.second == difficulty) && !entry.second.empty()) {
+            total += entry.second.size();
+            matched.push_back(&entry.second);
+            ends.push_back(total);
+        }
+    }
+    if (count <= 0 || total == 0) {
+        return result;
+    }
+    size_t k = std::min(static_cast<size_t>(count), total);
+    std::mt19937_64& rng = thread_rng();
+    
+    auto id_at = [&](size_t index) {
+        size_t p = std::upper_bound(ends.begin(), ends.end(), index) - ends.begin();
+        size_t start = p == 0 ? 0 : ends[p - 1];
+        return (*matched[p])[index - start];
+    };
+    
+    result.reserve(k);
+    if (k * 2 >= total) {
+        // Most of the range: partial Fisher-Yates over a copy (O(total) = O(k))
+        std::vector<int> ids;
+        ids.reserve(total);
+        for (const Partition* partition : matched) {
+            ids.insert(ids.end(), partition->begin(), partition->end());
+        }
+        for (size_t i = 0; i < k; i++) {
+            std::uniform_int_distribution<size_t> pick(i, total - 1);
+            std::swap(ids[i], ids[pick(rng)]);
+            result.push_back(ids[i]);
+        }
+        return result;
+    }
+    
+    // Floyd: k distinct indices with k draws, no copy of the range
+    std::unordered_set<size_t> chosen;
+    chosen.reserve(k * 2);
+    std::vector<size_t> indices;
+    indices.reserve(k);
+    for (size_t j = total - k; j < total; j++) {
+        std::uniform_int_distribution<size_t> pick(0, j);
+        size_t t = pick(rng);
+        if (!chosen.insert(t).second) {
+            t = j;      // Taken already: j itself is new (never drawn before)
+            chosen.insert(j);
+        }
+        indices.push_back(t);
+    }
+    
+    // Floyd picks a uniform set, not a uniform order
+    std::shuffle(indices.begin(), indices.end(), rng);
+    for (size_t index : indices) {
+        result.push_back(id_at(index));
+    }
+    return result;
+}
+
+size_t QuestionIndex::count(const std::string& topic, const std::string& difficulty) {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    size_t total = 0;
+    for (const auto& entry : partitions) {
+        if ((is_wildcard(topic) || entry.first.first == topic) &&
+            (is_wildcard(difficulty) || entry.first.second == difficulty)) {
+            total += entry.second.size();
+        }
+    }
+    return total;
+}
+
+size_t QuestionIndex::size() {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    return locations.size();
+}
@@ -0,0 +1,39 @@
+#include "../include/question_payload.h"
+
+std::shared_ptr<const std::string> QuestionPayload::client_json(const Question& question) {
+    json item;
+    item["q_id"] = question.question_id;
+    item["content"] = question.content;
+    for (int i = 0; i < QuestionOptions::COUNT; i++) {
+        if (question.options.has(i)) {
+            item[std::string("option_") + QuestionOptions::key(i)] = question.options.text[i];
+        }
+    }
+    return std::make_shared<const std::string>(item.dump());
+}
+
+SharedPayload QuestionPayload::build(const json& fields, const std::vector<Question>& questions) {
+    // Fragments of rows decoded before they were built are serialized here
+    std::vector<std::shared_ptr<const std::string>> fragments;
+    fragments.reserve(questions.size());
+    size_t length = 0;
+    for (const Question& question : questions) {
+        fragments.push_back(question.client_json ? question.client_json : client_json(question));
+        length += fragments.back()->size() + 1;
+    }
+    
+    // "{...fields" + ",\"questions\":[" + a,b,c + "]}"
+    std::string head = fields.is_object() ? fields.dump() : "{}";
+    std::string out;
+    out.reserve(head.size() + length + 16);
+    out.append(head, 0, head.size() - 1);
+    out += head.size() > 2 ? ",\"questions\":[" : "\"questions\":[";
+    for (size_t i = 0; i < fragments.size(); i++) {
+        if (i > 0) {
+            out += ',';
+        }
+        out += *fragments[i];
+    }
+    out += "]}";
+    return std::make_shared<const std::string>(std::move(out));
+}
@@ -3,17 +3,121 @@
 #include "../include/session.h"
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
 #include <cstring>
+#include <cstdio>
 #include <algorithm>
+#include <functional>
 
-Server::Server(int port, Database* database) : server_fd(-1), epoll_fd(-1), port(port), db(database) {
+// Set while a handler runs on a pool: send_message() appends the reply
+// here instead of touching the connection (owned by the event loop)
+static thread_local TaskCompletion* pool_task = nullptr;
+
+// Set while a pool thread runs a handler: the connection's login state as
+// it was when the request was offloaded
+static thread_local const ConnectionAuth* pool_auth = nullptr;
+
+// CLOCK_MONOTONIC in timer wheel ticks
+static uint64_t monotonic_tick() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (static_cast<uint64_t>(now.tv_sec) * 1000 + now.tv_nsec / 1000000) / TIMER_TICK_MS;
+}
+
+// System-wide count of connections dropped because an accept queue was full
+// (TcpExt ListenOverflows in /proc/net/netstat), 0 if unavailable
+static uint64_t read_listen_overflows() {
+    FILE* file = fopen("/proc/net/netstat", "r");
+    if (!file) {
+        return 0;
+    }
+    
+    // TcpExt: appears twice, a line of field names then a line of values
+    char names[4096];
+    char values[4096];
+    uint64_t overflows = 0;
+    while (fgets(names, sizeof(names), file)) {
+        if (strncmp(names, "TcpExt:", 7) != 0 || !fgets(values, sizeof(values), file)) {
+            continue;
+        }
+        char* name_save = nullptr;
+        char* value_save = nullptr;
+        char* name = strtok_r(names, " \n", &name_save);
+        char* value = strtok_r(values, " \n", &value_save);
+        while (name && value) {
+            if (strcmp(name, "ListenOverflows") == 0) {
+                overflows = strtoull(value, nullptr, 10);
+                break;
+            }
+            name = strtok_r(nullptr, " \n", &name_save);
+            value = strtok_r(nullptr, " \n", &value_save);
+        }
+        break;
+    }
+    fclose(file);
+    return overflows;
+}
+
+Server::Server(int port, Database* database, int worker_id, bool reuse_port, int backlog,
+               IoBackendKind io_kind)
+    : server_fd(-1), wakeup_fd(-1), timer_fd(-1), port(port), backlog(backlog), spare_fd(-1),
+      worker_id(worker_id), reuse_port(reuse_port), db(database), io_kind(io_kind), running(false),
+      timers(monotonic_tick()), timer_fd_tick(UINT64_MAX), idle_timeout(0),
+      task_pool(nullptr), hash_pool(nullptr), session_cache(nullptr), token_signer(nullptr), answer_writer(nullptr),
+      exam_engine(nullptr), loop_clock(time(nullptr)),
+      listen_overflows_logged(0) {
 }
 
 Server::~Server() {
-    stop();
+    close_all();
+    
+    // Kept open until now: pool tasks may still signal it after the loop stopped
+    if (wakeup_fd >= 0) {
+        close(wakeup_fd);
+        wakeup_fd = -1;
+    }
+}
+
+void Server::set_task_pool(TaskPool* pool) {
+    task_pool = pool;
+}
+
+void Server::set_hash_pool(TaskPool* pool) {
+    hash_pool = pool;
+}
+
+void Server::set_session_cache(SessionCache* cache) {
+    session_cache = cache;
+}
+
+void Server::set_token_signer(TokenSigner* signer) {
+    token_signer = signer;
+}
+
+void Server::set_answer_writer(AnswerWriter* writer) {
+    answer_writer = writer;
+}
+
+void Server::set_exam_engine(ExamEngine* engine) {
+    exam_engine = engine;
+}
+
+void Server::set_idle_timeout(int seconds) {
+    idle_timeout = std::max(seconds, 0);
+}
+
+void Server::set_peers(const std::vector<Server*>& workers) {
+    peers.clear();
+    for (Server* worker : workers) {
+        if (worker != this) {
+            peers.push_back(worker);
+        }
+    }
 }
 
 bool Server::setup_server_socket() {
@@ -31,6 +135,12 @@ bool Server::setup_server_socket() {
         return false;
     }
     
+    // Every worker binds its own listening socket; the kernel spreads accepts
+    if (reuse_port && setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        LOG_ERROR("Failed to set SO_REUSEPORT");
+        return false;
+    }
+    
     // Bind socket
     struct sockaddr_in address;
     address.sin_family = AF_INET;
@@ -42,73 +152,117 @@ bool Server::setup_server_socket() {
         return false;
     }
     
-    // Listen
-    if (listen(server_fd, 10) < 0) {
+    // Listen (a whole class joining at once must fit in the accept queue)
+    if (listen(server_fd, backlog) < 0) {
         LOG_ERROR("Failed to listen on socket");
         return false;
     }
     
+    // Held in reserve: on EMFILE it is released so pending connections can
+    // be accepted and closed instead of spinning on a readable listen socket
+    spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    listen_overflows_logged = read_listen_overflows();
+    
     // Set non-blocking
     int flags = fcntl(server_fd, F_GETFL, 0);
     fcntl(server_fd, F_SETFL, flags | O_NONBLOCK);
     
-    LOG_INFO("Server listening on port " + std::to_string(port));
+    LOG_INFO("Worker " + std::to_string(worker_id) + " listening on port " + std::to_string(port) +
+             " (backlog " + std::to_string(backlog) + ")");
     return true;
 }
 
-bool Server::setup_epoll() {
-    epoll_fd = epoll_create1(0);
-    if (epoll_fd < 0) {
-        LOG_ERROR("Failed to create epoll");
+bool Server::setup_io() {
+    // Wakeup eventfd (cross-worker broadcasts and stop requests)
+    wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup_fd < 0) {
+        LOG_ERROR("Failed to create eventfd");
         return false;
     }
     
-    // Add server socket to epoll
-    struct epoll_event event;
-    event.events = EPOLLIN;
-    event.data.fd = server_fd;
+    // Timer wheel expiries (set by run_timers)
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0) {
+        LOG_ERROR("Failed to create timerfd");
+        return false;
+    }
     
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, server_fd, &event) < 0) {
-        LOG_ERROR("Failed to add server socket to epoll");
+    io.reset(IoBackend::create(io_kind));
+    if (!io->setup(server_fd, wakeup_fd, timer_fd, &io_stats)) {
         return false;
     }
     
-    LOG_INFO("Epoll initialized");
+    LOG_INFO("Worker " + std::to_string(worker_id) + " using " + io->name() + " backend");
     return true;
 }
 
 void Server::handle_new_connection() {
-    struct sockaddr_in client_addr;
-    socklen_t client_len = sizeof(client_addr);
+    accept_stats.batches++;
     
-    int client_fd = accept(server_fd, (struct sockaddr*)&client_addr, &client_len);
-    if (client_fd < 0) {
-        if (errno != EAGAIN && errno != EWOULDBLOCK) {
-            LOG_ERROR("Failed to accept connection");
+    // For a listening socket TCP_INFO reports the accept queue:
+    // tcpi_unacked = current length, tcpi_sacked = backlog limit
+    struct tcp_info info;
+    socklen_t info_len = sizeof(info);
+    if (getsockopt(server_fd, IPPROTO_TCP, TCP_INFO, &info, &info_len) == 0) {
+        accept_stats.max_queue = std::max(accept_stats.max_queue, info.tcpi_unacked);
+        if (info.tcpi_sacked > 0 && info.tcpi_unacked >= info.tcpi_sacked) {
+            accept_stats.queue_full++;
         }
-        return;
     }
     
-    // Set non-blocking
-    int flags = fcntl(client_fd, F_GETFL, 0);
-    fcntl(client_fd, F_SETFL, flags | O_NONBLOCK);
-    
-    // Add to epoll
-    struct epoll_event event;
-    event.events = EPOLLIN | EPOLLET; // Edge-triggered
-    event.data.fd = client_fd;
+    // Drain the queue; anything left over keeps the (level-triggered)
+    // listening socket readable for the next loop iteration
+    for (int i = 0; i < MAX_ACCEPTS_PER_EVENT; i++) {
+        io_stats.other_calls++;
+        int client_fd = accept4(server_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client_fd >= 0) {
+            accept_stats.accepted++;
+            add_client(client_fd);
+            continue;
+        }
+        
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            break;
+        } else if (errno == EINTR || errno == ECONNABORTED) {
+            continue;
+        } else if ((errno == EMFILE || errno == ENFILE) && spare_fd >= 0) {
+            // Out of fds: accept with the spare one and close at once, so the
+            // client gets a reset instead of waiting in a queue we cannot drain
+            close(spare_fd);
+            int shed_fd = accept4(server_fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (shed_fd >= 0) {
+                close(shed_fd);
+                accept_stats.shed++;
+            }
+            spare_fd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+            LOG_WARN("Out of file descriptors, dropped incoming connection");
+            break;
+        }
+        
+        accept_stats.errors++;
+        LOG_ERROR("Failed to accept connection: " + std::string(strerror(errno)));
+        break;
+    }
+}
+
+void Server::add_client(int client_fd) {
+    // Output is already coalesced per loop iteration, Nagle would only add latency
+    int nodelay = 1;
+    setsockopt(client_fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    io_stats.other_calls++;
     
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, client_fd, &event) < 0) {
-        LOG_ERROR("Failed to add client to epoll");
+    if (!io->add_client(client_fd)) {
         close(client_fd);
         return;
     }
     
     // Create client info
-    ClientInfo client;
+    ClientInfo& client = clients.insert(client_fd);
     client.sockfd = client_fd;
-    client.user_id = -1;
-    clients[client_fd] = client;
+    client.last_active = loop_clock.load(std::memory_order_relaxed);
+    if (idle_timeout > 0) {
+        client.idle_timer = schedule_timer(idle_timeout * 1000ULL, TIMER_IDLE, client_fd, clients.generation(client_fd));
+    }
     
     LOG_INFO("New connection accepted: fd=" + std::to_string(client_fd));
 }
@@ -116,16 +270,27 @@ void Server::handle_new_connection() {
 void Server::handle_client_disconnect(int client_fd) {
     LOG_INFO("Client disconnected: fd=" + std::to_string(client_fd));
     
-    // Remove from room_clients map
-    for (auto& pair : room_clients) {
-        pair.second.erase(client_fd);
+    // Remove from the rooms this connection joined (not every room)
+    ClientInfo* client = clients.find(client_fd);
+    if (client) {
+        timers.cancel(client->idle_timer);
+        for (int room_id : client->rooms) {
+            auto room = room_clients.find(room_id);
+            if (room == room_clients.end()) {
+                continue;
+            }
+            room->second.erase(client_fd);
+            if (room->second.empty()) {
+                room_clients.erase(room);
+            }
+        }
+        
+        // Free the slot (bumps its generation)
+        clients.erase(client_fd);
     }
     
-    // Remove from clients map
-    clients.erase(client_fd);
-    
-    // Remove from epoll
-    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client_fd, nullptr);
+    // Stop watching (cancels operations still in flight on io_uring)
+    io->remove_client(client_fd);
     
     // Close socket
     close(client_fd);
@@ -140,203 +305,1031 @@ void Server::handle_client_message(int client_fd) {
     // 5. Sau khi có đủ payload_length byte, trích xuất chuỗi JSON từ bộ đệm
     // 6. Phân tích (parse) chuỗi JSON và xử lý logic
     // 7. Lặp lại từ bước 1 (vì bộ đệm có thể còn dữ liệu của gói tin tiếp theo)
+    //
+    // The bytes live in the connection's FrameDecoder: we only consume what
+    // is available now, a partial frame stays buffered until the next EPOLLIN.
+    // Work beyond one round's budget is remembered on the ready list, since
+    // edge-triggered epoll will not report the same bytes again.
+    
+    ClientInfo* client = clients.find(client_fd);
+    if (!client || client->closing) {
+        return;
+    }
+    
+    client->recv_pending = true;
+    client->last_active = loop_clock.load(std::memory_order_relaxed);
+    service_client(client_fd);
+}
+
+void Server::service_client(int client_fd) {
+    ClientInfo* client = clients.find(client_fd);
+    if (!client || client->closing) {
+        return;
+    }
+    
+    // Read while the socket has data, up to the input limit. More is read
+    // once buffered frames are consumed; a frame still being assembled may
+    // always take another INPUT_BUFFER_LIMIT bytes.
+    size_t limit = INPUT_BUFFER_LIMIT;
+    if (!client->decoder.has_frame()) {
+        limit += client->decoder.buffered();
+    }
+    if (client->recv_pending && client->decoder.buffered() < limit) {
+        RecvResult io_result = client->decoder.fill(client_fd, limit, &io_stats);
+        if (io_result == RECV_ERROR) {
+            // Peer closed (or socket error): finish the complete frames first
+            client->recv_pending = false;
+            client->input_closed = true;
+        } else {
+            client->recv_pending = client->decoder.buffered() >= limit;
+        }
+    }
+    
+    process_messages(client_fd);
+    
+    client = clients.find(client_fd);
+    if (!client || client->closing) {
+        return;
+    }
+    if (client->recv_paused && (client->decoder.buffered() < INPUT_BUFFER_LIMIT ||
+                                !client->decoder.has_frame())) {
+        client->recv_paused = false;
+        io->resume_recv(client_fd);
+    }
+    if (client->busy) {
+        // Busy connections are resumed by their completion
+        return;
+    }
+    
+    bool more = client->recv_pending || client->decoder.has_frame();
+    if (client->input_closed && !more) {
+        handle_client_disconnect(client_fd);
+    } else if (more) {
+        schedule_ready(client_fd, *client);
+    }
+}
+
+void Server::schedule_ready(int client_fd, ClientInfo& client) {
+    if (client.ready_listed) {
+        return;
+    }
+    client.ready_listed = true;
+    ready_list.push_back(std::make_pair(client_fd, clients.generation(client_fd)));
+}
+
+void Server::run_ready_round(const std::vector<std::pair<int, uint32_t>>& round) {
+    for (const auto& entry : round) {
+        // Skip connections closed (or fds reused) since they were listed
+        ClientInfo* client = clients.find(entry.first, entry.second);
+        if (!client) {
+            continue;
+        }
+        client->ready_listed = false;
+        service_client(entry.first);
+    }
+}
+
+void Server::process_messages(int client_fd) {
+    ClientInfo* client = clients.find(client_fd);
+    if (!client || client->closing) {
+        return;
+    }
     
     int messages_processed = 0;
-    const int MAX_MESSAGES_PER_LOOP = 1000; // Giới hạn để tránh infinite loop (tăng lên vì có thể có nhiều messages)
     
-    // Bước 7: Lặp lại từ bước 1 - xử lý tất cả messages có sẵn trong buffer
-    while (messages_processed < MAX_MESSAGES_PER_LOOP) {
+    // Bước 7: Lặp lại từ bước 1 - xử lý các messages có sẵn trong buffer, tối đa
+    // MESSAGE_BUDGET_PER_ROUND mỗi vòng để một client không chiếm cả event loop.
+    // While a handler is on the task pool the rest waits, to keep replies in order.
+    while (messages_processed < MESSAGE_BUDGET_PER_ROUND && !client->busy) {
         Message msg;
-        RecvResult result = Protocol::recv_message(client_fd, msg);
+        RecvResult result = client->decoder.next(msg);
         
-        if (result == RECV_NO_DATA) {
-            // Không còn data trong buffer (EAGAIN) - đây là trường hợp bình thường
-            // Dừng loop và chờ event tiếp theo từ epoll
+        if (result == RECV_INCOMPLETE) {
+            // Không còn frame hoàn chỉnh - chờ event tiếp theo từ epoll
             break;
         } else if (result == RECV_ERROR) {
-            // Lỗi hoặc connection closed - disconnect client
+            // Invalid frame (too large or bad JSON) - disconnect client
             handle_client_disconnect(client_fd);
             return;
-        } else if (result == RECV_INCOMPLETE) {
-            // Partial message - không nên xảy ra với TCP, nhưng log và disconnect để an toàn
-            LOG_ERROR("Incomplete message received, disconnecting client");
-            handle_client_disconnect(client_fd);
+        }
+        
+        // Bước 6: Phân tích (parse) chuỗi JSON và xử lý logic
+        messages_processed++;
+        LOG_INFO("Received message type " + std::to_string(msg.type) + " from fd=" + std::to_string(client_fd));
+        dispatch_message(client_fd, msg);
+        
+        // Output overflowed while handling: stop reading, it will be closed
+        if (client->closing) {
             return;
-        } else if (result == RECV_SUCCESS) {
-            // Bước 6: Phân tích (parse) chuỗi JSON và xử lý logic
-            messages_processed++;
-            LOG_INFO("Received message type " + std::to_string(msg.type) + " from fd=" + std::to_string(client_fd));
-            
-            // Route message based on type
-            switch (msg.type) {
-                case C2S_REGISTER:
-                    handle_register(client_fd, msg.payload);
-                    break;
-                case C2S_LOGIN:
-                    handle_login(client_fd, msg.payload);
-                    break;
-                case C2S_LOGOUT:
-                    handle_logout(client_fd, msg.payload);
-                    break;
-                case C2S_PRACTICE_REQUEST:
-                    handle_practice_request(client_fd, msg.payload);
-                    break;
-                case C2S_PRACTICE_SUBMIT:
-                    handle_practice_submit(client_fd, msg.payload);
-                    break;
-                case C2S_LIST_ROOMS:
-                    handle_list_rooms(client_fd, msg.payload);
-                    break;
-                case C2S_CREATE_ROOM:
-                    handle_create_room(client_fd, msg.payload);
-                    break;
-                case C2S_JOIN_ROOM:
-                    handle_join_room(client_fd, msg.payload);
-                    break;
-                case C2S_START_TEST:
-                    handle_start_test(client_fd, msg.payload);
-                    break;
-                case C2S_CHANGE_ANSWER:
-                    handle_change_answer(client_fd, msg.payload);
-                    break;
-                case C2S_SUBMIT_TEST:
-                    handle_submit_test(client_fd, msg.payload);
-                    break;
-                case C2S_GET_HISTORY:
-                    handle_get_history(client_fd, msg.payload);
-                    break;
-                case C2S_GET_STATS:
-                    handle_get_stats(client_fd, msg.payload);
-                    break;
-                case C2S_VIEW_ROOM_RESULTS:
-                    handle_view_room_results(client_fd, msg.payload);
-                    break;
-                // Question Management
-                case C2S_LIST_QUESTIONS:
-                    handle_list_questions(client_fd, msg.payload);
-                    break;
-                case C2S_CREATE_QUESTION:
-                    handle_create_question(client_fd, msg.payload);
-                    break;
-                case C2S_UPDATE_QUESTION:
-                    handle_update_question(client_fd, msg.payload);
-                    break;
-                case C2S_DELETE_QUESTION:
-                    handle_delete_question(client_fd, msg.payload);
-                    break;
-                default:
-                    LOG_WARN("Unknown message type: " + std::to_string(msg.type));
-                    json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Unknown message type");
-                    Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
-                    break;
+        }
+    }
+    
+    if (messages_processed > 1) {
+        LOG_DEBUG("Processed " + std::to_string(messages_processed) + " messages in one round (following 'Lặp lại từ bước 1' rule)");
+    }
+}
+
+// Handlers that talk to the database; replies, broadcasts, session
+// binding and room membership are applied by the event loop with the
+// completion
+Server::Handler Server::pool_handler(uint16_t msg_type) const {
+    switch (msg_type) {
+        case C2S_REGISTER:          return &Server::handle_register;    // Unless hash_pool is set
+        case C2S_LOGOUT:            return &Server::handle_logout;
+        case C2S_PRACTICE_REQUEST:  return &Server::handle_practice_request;
+        case C2S_PRACTICE_SUBMIT:   return &Server::handle_practice_submit;
+        case C2S_LIST_ROOMS:        return &Server::handle_list_rooms;
+        case C2S_CREATE_ROOM:       return &Server::handle_create_room;
+        case C2S_JOIN_ROOM:         return &Server::handle_join_room;
+        case C2S_GET_HISTORY:       return &Server::handle_get_history;
+        case C2S_GET_STATS:         return &Server::handle_get_stats;
+        case C2S_VIEW_ROOM_RESULTS: return &Server::handle_view_room_results;
+        case C2S_START_TEST:        return &Server::handle_start_test;
+        case C2S_CHANGE_ANSWER:     // Inline with the write-behind queue (O(1), no database)
+            return answer_writer ? nullptr : &Server::handle_change_answer;
+        case C2S_SUBMIT_TEST:       return &Server::handle_submit_test;
+        case C2S_LIST_QUESTIONS:    return &Server::handle_list_questions;
+        case C2S_CREATE_QUESTION:   return &Server::handle_create_question;
+        case C2S_UPDATE_QUESTION:   return &Server::handle_update_question;
+        case C2S_DELETE_QUESTION:   return &Server::handle_delete_question;
+        default:                    return nullptr;
+    }
+}
+
+// Handlers dominated by the password KDF
+Server::Handler Server::hash_handler(uint16_t msg_type) {
+    switch (msg_type) {
+        case C2S_REGISTER:          return &Server::handle_register;
+        case C2S_LOGIN:             return &Server::handle_login;
+        default:                    return nullptr;
+    }
+}
+
+void Server::dispatch_message(int client_fd, Message& msg) {
+    // Password hashing runs on its own pool
+    if (hash_pool) {
+        Handler handler = hash_handler(msg.type);
+        ClientInfo* client = clients.find(client_fd);
+        if (handler && client) {
+            offload_message(client_fd, *client, hash_pool, handler, msg);
+            return;
+        }
+    }
+    
+    // Database-bound handlers run on the task pool
+    if (task_pool) {
+        Handler handler = pool_handler(msg.type);
+        ClientInfo* client = clients.find(client_fd);
+        if (handler && client) {
+            offload_message(client_fd, *client, task_pool, handler, msg);
+            return;
+        }
+    }
+    
+    // Route message based on type
+    switch (msg.type) {
+        case C2S_REGISTER:
+            handle_register(client_fd, msg.payload);
+            break;
+        case C2S_LOGIN:
+            handle_login(client_fd, msg.payload);
+            break;
+        case C2S_LOGOUT:
+            handle_logout(client_fd, msg.payload);
+            break;
+        case C2S_PRACTICE_REQUEST:
+            handle_practice_request(client_fd, msg.payload);
+            break;
+        case C2S_PRACTICE_SUBMIT:
+            handle_practice_submit(client_fd, msg.payload);
+            break;
+        case C2S_LIST_ROOMS:
+            handle_list_rooms(client_fd, msg.payload);
+            break;
+        case C2S_CREATE_ROOM:
+            handle_create_room(client_fd, msg.payload);
+            break;
+        case C2S_JOIN_ROOM:
+            handle_join_room(client_fd, msg.payload);
+            break;
+        case C2S_START_TEST:
+            handle_start_test(client_fd, msg.payload);
+            break;
+        case C2S_CHANGE_ANSWER:
+            handle_change_answer(client_fd, msg.payload);
+            break;
+        case C2S_SUBMIT_TEST:
+            handle_submit_test(client_fd, msg.payload);
+            break;
+        case C2S_GET_HISTORY:
+            handle_get_history(client_fd, msg.payload);
+            break;
+        case C2S_GET_STATS:
+            handle_get_stats(client_fd, msg.payload);
+            break;
+        case C2S_VIEW_ROOM_RESULTS:
+            handle_view_room_results(client_fd, msg.payload);
+            break;
+        // Question Management
+        case C2S_LIST_QUESTIONS:
+            handle_list_questions(client_fd, msg.payload);
+            break;
+        case C2S_CREATE_QUESTION:
+            handle_create_question(client_fd, msg.payload);
+            break;
+        case C2S_UPDATE_QUESTION:
+            handle_update_question(client_fd, msg.payload);
+            break;
+        case C2S_DELETE_QUESTION:
+            handle_delete_question(client_fd, msg.payload);
+            break;
+        default:
+            LOG_WARN("Unknown message type: " + std::to_string(msg.type));
+            json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Unknown message type");
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            break;
+    }
+}
+
+void Server::offload_message(int client_fd, ClientInfo& client, TaskPool* pool, Handler handler, Message& msg) {
+    client.busy = true;
+    uint32_t generation = clients.generation(client_fd);
+    
+    std::shared_ptr<json> payload = std::make_shared<json>(std::move(msg.payload));
+    ConnectionAuth auth = client.auth;
+    pool->submit([this, client_fd, generation, handler, payload, auth]() {
+        TaskCompletion done;
+        done.client_fd = client_fd;
+        done.generation = generation;
+        
+        pool_task = &done;
+        pool_auth = &auth;
+        (this->*handler)(client_fd, *payload);
+        pool_auth = nullptr;
+        pool_task = nullptr;
+        
+        completions.push(std::move(done));
+        wake();
+    });
+}
+
+void Server::handle_completions() {
+    std::vector<TaskCompletion> finished;
+    completions.pop_all(finished);
+    
+    for (TaskCompletion& done : finished) {
+        if (done.exam_room_id) {
+            schedule_timer(done.exam_deadline_ms, TIMER_EXAM_DEADLINE, done.exam_room_id);
+        }
+        
+        // Closed while the handler ran (the fd may even belong to someone else now)
+        ClientInfo* client = clients.find(done.client_fd, done.generation);
+        if (client) {
+            client->busy = false;
+            if (done.logged_in) {
+                bind_login(done.client_fd, done.auth, done.username);
             }
-            
-            // Sau khi xử lý xong, tiếp tục loop để xử lý message tiếp theo (nếu có)
-            // Đây chính là "Lặp lại từ bước 1" trong quy định
+            if (done.logged_out) {
+                clear_login(done.client_fd, done.logout_token);
+            }
+            if (done.joined_room_id) {
+                add_room_member(done.client_fd, done.joined_room_id);
+            }
+            for (const QueuedReply& reply : done.replies) {
+                send_shared(done.client_fd, reply.msg_type, reply.payload);
+            }
+        }
+        for (const QueuedBroadcast& broadcast : done.broadcasts) {
+            broadcast_shared(broadcast.room_id, broadcast.msg_type, broadcast.payload);
+        }
+        
+        // Frames that arrived meanwhile
+        if (clients.find(done.client_fd, done.generation)) {
+            service_client(done.client_fd);
+        }
+    }
+}
+
+void Server::bind_login(int client_fd, const ConnectionAuth& auth, const std::string& username) {
+    // Pool thread: the connection belongs to the event loop
+    if (pool_task) {
+        pool_task->logged_in = true;
+        pool_task->auth = auth;
+        pool_task->username = username;
+        return;
+    }
+    
+    ClientInfo* client = clients.find(client_fd);
+    if (client) {
+        client->auth = auth;
+        client->auth.revision = session_cache ? session_cache->revision() : 0;
+        client->username = username;
+    }
+}
+
+void Server::clear_login(int client_fd, const std::string& session_token) {
+    // Pool thread: the connection belongs to the event loop
+    if (pool_task) {
+        pool_task->logged_out = true;
+        pool_task->logout_token = session_token;
+        return;
+    }
+    
+    ClientInfo* client = clients.find(client_fd);
+    if (client && client->auth.session_token == session_token) {
+        client->auth = ConnectionAuth();
+    }
+}
+
+void Server::add_room_member(int client_fd, int room_id) {
+    if (pool_task) {
+        pool_task->joined_room_id = room_id;
+        return;
+    }
+    
+    // room_clients and the connection's reverse index
+    ClientInfo* client = clients.find(client_fd);
+    if (client) {
+        room_clients[room_id].insert(client_fd);
+        client->rooms.insert(room_id);
+    }
+}
+
+void Server::send_message(int client_fd, uint16_t msg_type, const json& payload) {
+    SharedPayload serialized;
+    try {
+        serialized = Protocol::serialize(payload);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to send message: " + std::string(e.what()));
+        return;
+    }
+    
+    send_serialized(client_fd, msg_type, serialized);
+}
+
+void Server::send_serialized(int client_fd, uint16_t msg_type, const SharedPayload& payload) {
+    // On a pool thread: handed to the event loop with the completion
+    if (pool_task) {
+        pool_task->replies.push_back(QueuedReply{msg_type, payload});
+        return;
+    }
+    send_shared(client_fd, msg_type, payload);
+}
+
+void Server::send_shared(int client_fd, uint16_t msg_type, const SharedPayload& payload) {
+    ClientInfo* found = clients.find(client_fd);
+    if (!found || found->closing) {
+        return;
+    }
+    ClientInfo& client = *found;
+    
+    client.outbox.push(msg_type, payload);
+    io_stats.messages_queued++;
+    
+    if (client.outbox.pending() > OUTPUT_HIGH_WATER_MARK) {
+        LOG_WARN("Output buffer over high-water mark (" + std::to_string(client.outbox.pending()) +
+                 " bytes), disconnecting fd=" + std::to_string(client_fd));
+        schedule_close(client_fd);
+        return;
+    }
+    
+    // Written once at the end of the loop iteration, together with
+    // everything else queued for this connection meanwhile
+    if (!client.flush_scheduled) {
+        client.flush_scheduled = true;
+        dirty_fds.push_back(client_fd);
+    }
+}
+
+void Server::flush_dirty() {
+    std::vector<int> to_flush;
+    to_flush.swap(dirty_fds);
+    
+    for (int client_fd : to_flush) {
+        ClientInfo* found = clients.find(client_fd);
+        if (!found) {
+            continue;
+        }
+        ClientInfo& client = *found;
+        client.flush_scheduled = false;
+        if (client.closing || client.outbox.empty()) {
+            continue;
+        }
+        
+        // SEND_PENDING: the rest goes out on IO_WRITABLE / IO_SENT
+        if (io->flush(client_fd, client.outbox) == SEND_ERROR) {
+            schedule_close(client_fd);
+        }
+    }
+}
+
+void Server::log_io_stats() {
+    uint64_t messages = io_stats.messages_queued - io_stats_logged.messages_queued;
+    uint64_t calls = io_stats.send_calls - io_stats_logged.send_calls;
+    uint64_t bytes = io_stats.bytes_sent - io_stats_logged.bytes_sent;
+    uint64_t syscalls = io_stats.syscalls() - io_stats_logged.syscalls();
+    io_stats_logged = io_stats;
+    
+    if (messages == 0) {
+        return;
+    }
+    
+    // io_uring sends need no sendmsg() syscall: they ride on io_uring_enter()
+    char ratio[32];
+    char total_ratio[32];
+    snprintf(ratio, sizeof(ratio), "%.3f", (double)calls / messages);
+    snprintf(total_ratio, sizeof(total_ratio), "%.3f", (double)syscalls / messages);
+    LOG_INFO("Worker " + std::to_string(worker_id) + " send stats (" + io->name() + "): " +
+             std::to_string(messages) + " messages, " + std::to_string(calls) + " sendmsg calls (" +
+             ratio + " per message), " + std::to_string(syscalls) + " syscalls in total (" +
+             total_ratio + " per message), " + std::to_string(bytes) + " bytes");
+}
+
+void Server::log_accept_stats() {
+    uint64_t accepted = accept_stats.accepted - accept_stats_logged.accepted;
+    uint64_t batches = accept_stats.batches - accept_stats_logged.batches;
+    uint64_t queue_full = accept_stats.queue_full - accept_stats_logged.queue_full;
+    uint64_t shed = accept_stats.shed - accept_stats_logged.shed;
+    uint64_t errors = accept_stats.errors - accept_stats_logged.errors;
+    uint32_t max_queue = accept_stats.max_queue;
+    accept_stats_logged = accept_stats;
+    accept_stats.max_queue = 0;
+    
+    // Overflow drops never reach accept(); the kernel counter is host-wide,
+    // so only the first worker reports it
+    uint64_t overflows = 0;
+    if (worker_id == 0) {
+        uint64_t total = read_listen_overflows();
+        overflows = total - std::min(total, listen_overflows_logged);
+        listen_overflows_logged = total;
+    }
+    
+    if (accepted == 0 && overflows == 0 && shed == 0 && errors == 0) {
+        return;
+    }
+    
+    std::string message = "Worker " + std::to_string(worker_id) + " accept stats: " +
+                          std::to_string(accepted) + " accepted in " + std::to_string(batches) +
+                          " batches, max queue " + std::to_string(max_queue) + "/" + std::to_string(backlog) +
+                          ", queue full " + std::to_string(queue_full) + " times, " +
+                          std::to_string(shed) + " shed, " + std::to_string(errors) + " errors";
+    if (worker_id == 0) {
+        message += ", " + std::to_string(overflows) + " listen overflows (host-wide)";
+    }
+    
+    if (overflows > 0 || queue_full > 0 || shed > 0) {
+        LOG_WARN(message + " - consider a larger --backlog or more --workers");
+    } else {
+        LOG_INFO(message);
+    }
+}
+
+void Server::log_answer_stats() {
+    if (!answer_writer) {
+        return;
+    }
+    AnswerWriterStats stats = answer_writer->get_stats();
+    uint64_t enqueued = stats.enqueued - answer_stats_logged.enqueued;
+    uint64_t rows = stats.rows_written - answer_stats_logged.rows_written;
+    uint64_t flushes = stats.flushes - answer_stats_logged.flushes;
+    uint64_t failed = stats.failed_rows - answer_stats_logged.failed_rows;
+    uint64_t failed_flushes = stats.failed_flushes - answer_stats_logged.failed_flushes;
+    answer_stats_logged = stats;
+    
+    if (enqueued == 0 && flushes == 0 && failed_flushes == 0) {
+        return;
+    }
+    
+    char latency[64];
+    snprintf(latency, sizeof(latency), "last flush %.2f ms, max %.2f ms", stats.last_flush_ms, stats.max_flush_ms);
+    LOG_INFO("Answer writer: " + std::to_string(enqueued) + " answers, " + std::to_string(rows) + " rows in " +
+             std::to_string(flushes) + " flushes (" + std::to_string(failed) + " rejected, " +
+             std::to_string(failed_flushes) + " failed), queue depth " +
+             std::to_string(stats.queue_depth) + " (max " + std::to_string(stats.max_queue_depth) + "), " + latency);
+}
+
+void Server::log_question_cache_stats() {
+    QuestionCacheStats stats = db->question_cache_stats();
+    QuestionCacheStats window;
+    window.hits = stats.hits - question_stats_logged.hits;
+    window.misses = stats.misses - question_stats_logged.misses;
+    uint64_t evictions = stats.evictions - question_stats_logged.evictions;
+    uint64_t invalidations = stats.invalidations - question_stats_logged.invalidations;
+    question_stats_logged = stats;
+    
+    if (window.hits + window.misses == 0) {
+        return;
+    }
+    
+    char rates[64];
+    snprintf(rates, sizeof(rates), "hit rate %.1f%% (%.1f%% since start)", window.hit_rate() * 100,
+             stats.hit_rate() * 100);
+    LOG_INFO("Question cache: " + std::to_string(window.hits) + " hits, " + std::to_string(window.misses) +
+             " misses, " + rates + ", " + std::to_string(evictions) + " evicted, " + std::to_string(invalidations) +
+             " invalidated, " + std::to_string(stats.size) + "/" + std::to_string(stats.capacity) + " cached");
+}
+
+void Server::handle_client_writable(int client_fd) {
+    ClientInfo* client = clients.find(client_fd);
+    if (!client || client->closing || client->outbox.empty()) {
+        return;
+    }
+    
+    if (io->flush(client_fd, client->outbox) == SEND_ERROR) {
+        schedule_close(client_fd);
+    }
+}
+
+void Server::handle_client_data(int client_fd, const char* data, size_t length) {
+    ClientInfo* client = clients.find(client_fd);
+    if (!client || client->closing) {
+        return;
+    }
+    
+    // Already read by the kernel: no recv() to schedule, just frames to handle.
+    // Past the input limit with frames to work through, stop receiving
+    // (a frame still being assembled may always complete).
+    client->decoder.feed(data, length);
+    client->last_active = loop_clock.load(std::memory_order_relaxed);
+    if (!client->recv_paused && client->decoder.has_frame() &&
+        client->decoder.buffered() >= INPUT_BUFFER_LIMIT) {
+        client->recv_paused = true;
+        io->pause_recv(client_fd);
+    }
+    service_client(client_fd);
+}
+
+void Server::handle_client_sent(int client_fd, size_t written, bool failed) {
+    ClientInfo* client = clients.find(client_fd);
+    if (!client) {
+        return;
+    }
+    
+    client->outbox.consume(written);
+    if (failed) {
+        schedule_close(client_fd);
+        return;
+    }
+    
+    // Output queued while the send was in flight
+    if (!client->closing && !client->outbox.empty() && io->flush(client_fd, client->outbox) == SEND_ERROR) {
+        schedule_close(client_fd);
+    }
+}
+
+TimerId Server::schedule_timer(uint64_t delay_ms, TimerKind kind, int key, uint32_t generation) {
+    uint64_t expires = monotonic_tick() + (delay_ms + TIMER_TICK_MS - 1) / TIMER_TICK_MS;
+    return timers.schedule(expires, TimerEvent{kind, key, generation});
+}
+
+void Server::post_timer(uint64_t delay_ms, TimerKind kind, int key) {
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex);
+        posted_timers.emplace_back(delay_ms, TimerEvent{kind, key, 0});
+    }
+    wake();
+}
+
+void Server::arm_exam_deadline(int room_id, uint64_t delay_ms) {
+    // Pool thread: the wheel belongs to the event loop
+    if (pool_task) {
+        pool_task->exam_room_id = room_id;
+        pool_task->exam_deadline_ms = delay_ms;
+        return;
+    }
+    schedule_timer(delay_ms, TIMER_EXAM_DEADLINE, room_id);
+}
+
+void Server::run_timers() {
+    fired_timers.clear();
+    timers.advance(monotonic_tick(), fired_timers);
+    for (const TimerEvent& event : fired_timers) {
+        handle_timer(event);
+    }
+    
+    // One timerfd_settime() per change of the earliest expiry, not per timer
+    uint64_t next = timers.next_expiry();
+    if (next == timer_fd_tick) {
+        return;
+    }
+    struct itimerspec spec;
+    memset(&spec, 0, sizeof(spec));     // All zero: disarm
+    if (next != UINT64_MAX) {
+        uint64_t ms = next * TIMER_TICK_MS;
+        spec.it_value.tv_sec = ms / 1000;
+        spec.it_value.tv_nsec = (ms % 1000) * 1000000;
+    }
+    io_stats.other_calls++;
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr) < 0) {
+        LOG_ERROR("timerfd_settime failed: " + std::string(strerror(errno)));
+        return;
+    }
+    timer_fd_tick = next;
+}
+
+void Server::handle_timer(const TimerEvent& event) {
+    switch (event.kind) {
+        case TIMER_HOUSEKEEPING:
+            housekeeping();
+            break;
+        case TIMER_EXAM_DEADLINE:
+            handle_exam_deadline(event.key);
+            break;
+        case TIMER_EXAM_GRACE:
+        case TIMER_EXAM_RETRY:
+            // No-op if the last sheet came in first
+            schedule_finish_exam(event.key);
+            break;
+        case TIMER_IDLE:
+            check_idle(event.key, event.generation);
+            break;
+    }
+}
+
+void Server::housekeeping() {
+    time_t now = loop_clock.load(std::memory_order_relaxed);
+    
+    // Cleanup expired sessions (shared database, first worker only)
+    if (worker_id == 0) {
+        db->cleanup_expired_sessions();
+        if (session_cache) {
+            session_cache->purge_expired(now);
+        }
+        if (token_signer) {
+            token_signer->purge_revoked(now);
         }
     }
+    log_io_stats();
+    log_accept_stats();
+    if (worker_id == 0) {
+        log_answer_stats();
+        log_question_cache_stats();
+    }
     
-    if (messages_processed > 1) {
-        LOG_DEBUG("Processed " + std::to_string(messages_processed) + " messages in one loop (following 'Lặp lại từ bước 1' rule)");
+    schedule_timer(HOUSEKEEPING_INTERVAL_MS, TIMER_HOUSEKEEPING, 0);
+}
+
+void Server::check_idle(int client_fd, uint32_t generation) {
+    ClientInfo* client = clients.find(client_fd, generation);
+    if (!client || client->closing) {
+        return;
     }
+    client->idle_timer = 0;
     
-    if (messages_processed >= MAX_MESSAGES_PER_LOOP) {
-        LOG_WARN("Reached MAX_MESSAGES_PER_LOOP limit, stopping to prevent infinite loop");
+    // Activity only stamps last_active; the timer checks it when it fires
+    time_t idle_for = loop_clock.load(std::memory_order_relaxed) - client->last_active;
+    if (idle_for >= idle_timeout && !client->busy) {
+        LOG_INFO("Closing idle connection: fd=" + std::to_string(client_fd));
+        schedule_close(client_fd);
+        return;
     }
+    time_t remaining = std::max<time_t>(idle_timeout - idle_for, 1);
+    client->idle_timer = schedule_timer(remaining * 1000ULL, TIMER_IDLE, client_fd, generation);
 }
 
-bool Server::validate_session(int client_fd, const std::string& session_token, int& user_id, std::string& role) {
-    if (!db->is_session_valid(session_token)) {
-        json error = Protocol::create_error_response(ERR_INVALID_SESSION, "Invalid or expired session");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
-        return false;
+void Server::schedule_close(int client_fd) {
+    ClientInfo* client = clients.find(client_fd);
+    if (!client || client->closing) {
+        return;
+    }
+    client->closing = true;
+    pending_close.push_back(std::make_pair(client_fd, clients.generation(client_fd)));
+}
+
+void Server::close_pending() {
+    std::vector<std::pair<int, uint32_t>> to_close;
+    to_close.swap(pending_close);
+    
+    for (const auto& entry : to_close) {
+        // The fd may have been closed and reused by a new connection meanwhile
+        if (clients.find(entry.first, entry.second)) {
+            handle_client_disconnect(entry.first);
+        }
+    }
+}
+
+const ConnectionAuth* Server::connection_auth(int client_fd) {
+    if (pool_auth) {
+        return pool_auth;
+    }
+    ClientInfo* client = clients.find(client_fd);
+    return client ? &client->auth : nullptr;
+}
+
+bool Server::validate_session(int client_fd, const std::string& token, int& user_id, std::string& role) {
+    time_t now = loop_clock.load(std::memory_order_relaxed);
+    uint64_t revision = session_cache ? session_cache->revision() : 0;
+    
+    // Fastest path: the connection logged in with this token
+    const ConnectionAuth* auth = connection_auth(client_fd);
+    bool bound = auth && auth->user_id >= 0 && (token.empty() || token == auth->session_token);
+    if (bound && now < auth->expiry && auth->revision == revision) {
+        user_id = auth->user_id;
+        role = auth->role;
+        return true;
+    }
+    
+    // Token mismatch, expiry or a logout somewhere: check with the store
+    const std::string& session_token = token.empty() && auth ? auth->session_token : token;
+    
+    // Signed token: the claims are in the token, only the MAC needs checking
+    if (token_signer && TokenSigner::is_signed(session_token)) {
+        SignedToken claims;
+        if (!token_signer->verify(session_token, now, claims)) {
+            json error = Protocol::create_error_response(ERR_INVALID_SESSION, "Invalid or expired session");
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            return false;
+        }
+        if (bound && !pool_auth) {
+            clients.find(client_fd)->auth.revision = revision;
+        }
+        user_id = claims.user_id;
+        role = claims.role;
+        return true;
     }
     
-    user_id = db->get_user_id_from_session(session_token);
-    if (user_id < 0) {
-        json error = Protocol::create_error_response(ERR_INVALID_SESSION, "Invalid session");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+    // Fast path: one hash lookup, no database access
+    CachedSession cached;
+    if (session_cache && session_cache->get(session_token, now, cached)) {
+        if (bound && !pool_auth) {
+            // Still valid: skip the lookup again until the next revocation
+            clients.find(client_fd)->auth.revision = revision;
+        }
+        user_id = cached.user_id;
+        role = cached.role;
+        return true;
+    }
+    
+    // Not cached (created before a restart, or no cache): load it once
+    Session session;
+    if (!db->get_session(session_token, session) ||
+        now >= SessionManager::parse_timestamp(session.expiry_timestamp)) {
+        json error = Protocol::create_error_response(ERR_INVALID_SESSION, "Invalid or expired session");
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
         return false;
     }
     
     User user;
-    if (!db->get_user_by_id(user_id, user)) {
+    if (!db->get_user_by_id(session.user_id, user)) {
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "User not found");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
         return false;
     }
     
+    if (session_cache) {
+        cached.user_id = user.user_id;
+        cached.role = user.role;
+        cached.expiry = SessionManager::parse_timestamp(session.expiry_timestamp);
+        session_cache->put(session_token, cached);
+    }
+    
+    user_id = user.user_id;
     role = user.role;
     return true;
 }
 
 void Server::broadcast_to_room(int room_id, uint16_t msg_type, const json& payload) {
-    if (room_clients.find(room_id) == room_clients.end()) {
+    // Serialize once: every member (on every worker) shares this buffer
+    SharedPayload serialized;
+    try {
+        serialized = Protocol::serialize(payload);
+    } catch (const std::exception& e) {
+        LOG_ERROR("Failed to serialize broadcast: " + std::string(e.what()));
         return;
     }
     
-    for (int client_fd : room_clients[room_id]) {
-        Protocol::send_message(client_fd, msg_type, payload);
+    broadcast_shared(room_id, msg_type, serialized);
+}
+
+void Server::broadcast_shared(int room_id, uint16_t msg_type, const SharedPayload& payload) {
+    // Local members belong to the event loop as well
+    if (pool_task) {
+        pool_task->broadcasts.push_back(QueuedBroadcast{room_id, msg_type, payload});
+        return;
+    }
+    
+    deliver_broadcast(room_id, msg_type, payload);
+    
+    // Room members may be connected to other workers
+    for (Server* peer : peers) {
+        peer->post_broadcast(room_id, msg_type, payload);
     }
 }
 
 void Server::broadcast_to_all(uint16_t msg_type, const json& payload) {
-    for (const auto& pair : clients) {
-        Protocol::send_message(pair.first, msg_type, payload);
+    broadcast_to_room(-1, msg_type, payload);
+}
+
+void Server::deliver_broadcast(int room_id, uint16_t msg_type, const SharedPayload& payload) {
+    if (room_id < 0) {
+        clients.for_each([&](int client_fd, ClientInfo&) {
+            send_shared(client_fd, msg_type, payload);
+        });
+        return;
+    }
+    
+    auto it = room_clients.find(room_id);
+    if (it == room_clients.end()) {
+        return;
+    }
+    
+    for (int client_fd : it->second) {
+        send_shared(client_fd, msg_type, payload);
     }
 }
 
-bool Server::start() {
+void Server::deliver_per_user(int room_id, uint16_t msg_type, const UserPayloads& payloads) {
+    auto it = room_clients.find(room_id);
+    if (it == room_clients.end()) {
+        return;
+    }
+    
+    for (int client_fd : it->second) {
+        ClientInfo* client = clients.find(client_fd);
+        if (!client) {
+            continue;
+        }
+        auto payload = payloads.find(client->auth.user_id);
+        if (payload != payloads.end()) {
+            send_shared(client_fd, msg_type, payload->second);
+        }
+    }
+}
+
+void Server::post_broadcast(int room_id, uint16_t msg_type, const SharedPayload& payload,
+                            const std::shared_ptr<const UserPayloads>& per_user) {
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex);
+        inbox.push_back(RoomBroadcast{room_id, msg_type, payload, per_user});
+    }
+    wake();
+}
+
+void Server::publish_to_room(int room_id, uint16_t msg_type, const SharedPayload& payload,
+                             const std::shared_ptr<const UserPayloads>& per_user) {
+    post_broadcast(room_id, msg_type, payload, per_user);
+    for (Server* peer : peers) {
+        peer->post_broadcast(room_id, msg_type, payload, per_user);
+    }
+}
+
+void Server::wake() {
+    uint64_t one = 1;
+    if (write(wakeup_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        LOG_ERROR("Failed to signal worker " + std::to_string(worker_id));
+    }
+}
+
+void Server::handle_inbox() {
+    uint64_t count;
+    while (read(wakeup_fd, &count, sizeof(count)) > 0) {
+    }
+    
+    std::vector<RoomBroadcast> pending;
+    std::vector<std::pair<uint64_t, TimerEvent>> timers_posted;
+    {
+        std::lock_guard<std::mutex> lock(inbox_mutex);
+        pending.swap(inbox);
+        timers_posted.swap(posted_timers);
+    }
+    
+    for (const auto& timer : timers_posted) {
+        schedule_timer(timer.first, static_cast<TimerKind>(timer.second.kind), timer.second.key);
+    }
+    
+    for (const auto& item : pending) {
+        if (item.per_user) {
+            deliver_per_user(item.room_id, item.msg_type, *item.per_user);
+        } else {
+            deliver_broadcast(item.room_id, item.msg_type, item.payload);
+        }
+    }
+}
+
+bool Server::setup() {
     if (!setup_server_socket()) {
         return false;
     }
     
-    if (!setup_epoll()) {
+    if (!setup_io()) {
         return false;
     }
     
-    LOG_INFO("Server started successfully");
+    running = true;
+    return true;
+}
+
+void Server::run() {
+    LOG_INFO("Worker " + std::to_string(worker_id) + " started successfully");
     
-    struct epoll_event events[MAX_EVENTS];
+    std::vector<IoEvent> events;
+    schedule_timer(HOUSEKEEPING_INTERVAL_MS, TIMER_HOUSEKEEPING, 0);
     
     // Main event loop
-    while (true) {
-        int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
-        if (nfds < 0) {
-            if (errno == EINTR) {
-                continue;
-            }
-            LOG_ERROR("epoll_wait failed");
+    while (running) {
+        // Connections left with work by the previous iteration get one more
+        // round after this batch of events; don't sleep while there are any
+        std::vector<std::pair<int, uint32_t>> ready_round;
+        ready_round.swap(ready_list);
+        
+        // Timers wake the loop through timer_fd
+        if (!io->wait(events, ready_round.empty() ? -1 : 0)) {
             break;
         }
+        loop_clock.store(time(nullptr), std::memory_order_relaxed);
         
-        for (int i = 0; i < nfds; ++i) {
-            if (events[i].data.fd == server_fd) {
-                // New connection
-                handle_new_connection();
-            } else {
-                // Client message
-                handle_client_message(events[i].data.fd);
+        for (const IoEvent& event : events) {
+            switch (event.type) {
+                case IO_LISTEN_READY:
+                    // New connection
+                    handle_new_connection();
+                    break;
+                case IO_ACCEPTED:
+                    // Accepted by the kernel already (io_uring)
+                    if (event.fd >= 0) {
+                        accept_stats.accepted++;
+                        add_client(event.fd);
+                    } else if (event.fd != -ECONNABORTED && event.fd != -EINTR) {
+                        accept_stats.errors++;
+                        LOG_ERROR("Failed to accept connection: " + std::string(strerror(-event.fd)));
+                    }
+                    break;
+                case IO_WAKEUP:
+                    // Broadcasts from other workers, finished pool handlers (or stop request)
+                    handle_inbox();
+                    handle_completions();
+                    break;
+                case IO_TIMER: {
+                    // Due timers run after this batch (run_timers)
+                    uint64_t expirations;
+                    if (read(timer_fd, &expirations, sizeof(expirations)) < 0) {
+                        // Nothing to clear (already read)
+                    }
+                    break;
+                }
+                case IO_WRITABLE:
+                    // Socket writable again: flush queued output
+                    handle_client_writable(event.fd);
+                    break;
+                case IO_READABLE:
+                    // Client message (errors/hangup surface as a failed recv)
+                    handle_client_message(event.fd);
+                    break;
+                case IO_DATA:
+                    handle_client_data(event.fd, event.data, event.length);
+                    break;
+                case IO_CLOSED: {
+                    ClientInfo* client = clients.find(event.fd);
+                    if (client) {
+                        client->input_closed = true;
+                        service_client(event.fd);
+                    }
+                    break;
+                }
+                case IO_SENT:
+                    handle_client_sent(event.fd, event.length, event.error);
+                    break;
             }
         }
         
-        // Cleanup expired sessions periodically
-        static int cleanup_counter = 0;
-        if (++cleanup_counter >= 1000) {
-            db->cleanup_expired_sessions();
-            cleanup_counter = 0;
-        }
+        run_ready_round(ready_round);
+        run_timers();
+        
+        flush_dirty();
+        close_pending();
+    }
+    
+    close_all();
+}
+
+bool Server::start() {
+    if (!setup()) {
+        return false;
     }
     
+    run();
     return true;
 }
 
 void Server::stop() {
-    // Close all client connections
-    for (const auto& pair : clients) {
-        close(pair.first);
+    running = false;
+    
+    // Wake the backend's wait so the loop notices the flag
+    if (wakeup_fd >= 0) {
+        uint64_t one = 1;
+        if (write(wakeup_fd, &one, sizeof(one)) < 0) {
+            // Loop will exit on next event
+        }
     }
+}
+
+void Server::close_all() {
+    // Close all client connections
+    clients.for_each([](int client_fd, ClientInfo&) {
+        close(client_fd);
+    });
     clients.clear();
+    room_clients.clear();
     
     // Close server socket
     if (server_fd >= 0) {
@@ -344,13 +1337,21 @@ void Server::stop() {
         server_fd = -1;
     }
     
-    // Close epoll
-    if (epoll_fd >= 0) {
-        close(epoll_fd);
-        epoll_fd = -1;
+    if (spare_fd >= 0) {
+        close(spare_fd);
+        spare_fd = -1;
+    }
+    
+    // Release the backend (io_uring drops operations still in flight)
+    if (io) {
+        io.reset();
+        LOG_INFO("Worker " + std::to_string(worker_id) + " stopped");
     }
     
-    LOG_INFO("Server stopped");
+    if (timer_fd >= 0) {
+        close(timer_fd);
+        timer_fd = -1;
+    }
 }
 
 // Authentication handlers
@@ -365,22 +1366,30 @@ void Server::handle_register(int client_fd, const json& payload) {
             role = "USER";
         }
         
+        // Taken: answer without paying for the KDF
+        User existing;
+        if (db->get_user_by_username(username, existing)) {
+            json error = Protocol::create_error_response(ERR_USERNAME_EXISTS, "Username already exists");
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            return;
+        }
+        
         // Hash password
         std::string hashed_password = SessionManager::hash_password(password);
         
         // Create user
         if (db->create_user(username, hashed_password, role)) {
             json response = Protocol::create_success_response("Registration successful");
-            Protocol::send_message(client_fd, S2C_RESPONSE_OK, response);
+            send_message(client_fd, S2C_RESPONSE_OK, response);
             LOG_INFO("User registered: " + username);
         } else {
             json error = Protocol::create_error_response(ERR_USERNAME_EXISTS, "Username already exists");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
         }
     } catch (const std::exception& e) {
         LOG_ERROR("handle_register error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
@@ -393,7 +1402,7 @@ void Server::handle_login(int client_fd, const json& payload) {
         if (!db->get_user_by_username(username, user)) {
             LOG_WARN("Login failed: User not found - " + username);
             json error = Protocol::create_error_response(ERR_LOGIN_FAILED, "Invalid username or password");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
@@ -401,53 +1410,92 @@ void Server::handle_login(int client_fd, const json& payload) {
         if (!SessionManager::verify_password(password, user.hashed_password)) {
             LOG_WARN("Login failed: Password mismatch for user - " + username);
             json error = Protocol::create_error_response(ERR_LOGIN_FAILED, "Invalid username or password");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
+        // Old SHA-256 (or weaker KDF) hash: upgrade it now that we know the password
+        if (SessionManager::needs_rehash(user.hashed_password)) {
+            if (db->update_password_hash(user.user_id, SessionManager::hash_password(password))) {
+                LOG_INFO("Password hash upgraded for user: " + username);
+            }
+        }
+        
         // Generate session token
-        std::string token = SessionManager::generate_token(32);
-        if (!db->create_session(token, user.user_id, 86400)) { // 24 hours
-            json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Failed to create session");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
-            return;
+        std::string token;
+        time_t expiry = time(nullptr) + SESSION_EXPIRY_SECONDS;
+        if (token_signer) {
+            // Self-contained: nothing to store
+            token = token_signer->issue(user.user_id, user.role, expiry);
+        } else {
+            token = SessionManager::generate_token(32);
+            if (!db->create_session(token, user.user_id, SESSION_EXPIRY_SECONDS)) {
+                json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Failed to create session");
+                send_message(client_fd, S2C_RESPONSE_ERROR, error);
+                return;
+            }
+        }
+        
+        // Later requests validate against the cache only
+        if (session_cache && !token_signer) {
+            CachedSession cached;
+            cached.user_id = user.user_id;
+            cached.role = user.role;
+            cached.expiry = expiry;
+            session_cache->put(token, cached);
         }
         
-        // Update client info
-        clients[client_fd].session_token = token;
-        clients[client_fd].user_id = user.user_id;
-        clients[client_fd].username = user.username;
-        clients[client_fd].role = user.role;
+        // Bind the session to the connection: later requests on it are
+        // authorized without a lookup
+        ConnectionAuth auth;
+        auth.session_token = token;
+        auth.user_id = user.user_id;
+        auth.role = user.role;
+        auth.expiry = expiry;
+        bind_login(client_fd, auth, user.username);
         
         // Send response
         json response;
         response["session_token"] = token;
         response["username"] = user.username;
         response["role"] = user.role;
-        Protocol::send_message(client_fd, S2C_LOGIN_OK, response);
+        send_message(client_fd, S2C_LOGIN_OK, response);
         
         LOG_INFO("User logged in: " + username);
     } catch (const std::exception& e) {
         LOG_ERROR("handle_login error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
 void Server::handle_logout(int client_fd, const json& payload) {
     try {
-        std::string session_token = payload["session_token"];
+        const ConnectionAuth* auth = connection_auth(client_fd);
+        std::string session_token = payload.value("session_token", "");
+        if (session_token.empty() && auth) {
+            session_token = auth->session_token;
+        }
+        
+        SignedToken claims;
+        if (token_signer && token_signer->verify(session_token, time(nullptr), claims)) {
+            // Nothing stored: remember it as revoked until it would expire anyway
+            token_signer->revoke(session_token, claims.expiry);
+        } else {
+            // Database first, so a concurrent cache miss cannot bring it back
+            db->delete_session(session_token);
+        }
         
-        db->delete_session(session_token);
+        // Bumps the revision: connections bound to the token check it again
+        if (session_cache) {
+            session_cache->erase(session_token);
+        }
         
         // Clear client info
-        if (clients.find(client_fd) != clients.end()) {
-            clients[client_fd].session_token = "";
-            clients[client_fd].user_id = -1;
-        }
+        clear_login(client_fd, session_token);
         
         json response = Protocol::create_success_response("Logged out successfully");
-        Protocol::send_message(client_fd, S2C_RESPONSE_OK, response);
+        send_message(client_fd, S2C_RESPONSE_OK, response);
         
         LOG_INFO("User logged out: fd=" + std::to_string(client_fd));
     } catch (const std::exception& e) {
@@ -458,7 +1506,7 @@ void Server::handle_logout(int client_fd, const json& payload) {
 // Practice mode handlers
 void Server::handle_practice_request(int client_fd, const json& payload) {
     try {
-        std::string session_token = payload["session_token"];
+        std::string session_token = payload.value("session_token", "");
         int user_id;
         std::string role;
         
@@ -475,38 +1523,25 @@ void Server::handle_practice_request(int client_fd, const json& payload) {
         
         if (questions.empty()) {
             json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "No questions available");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
-        // Prepare response
+        // Prepare response: pre-serialized questions (without correct answer)
         json response;
         response["duration_seconds"] = 1800; // 30 minutes
-        response["questions"] = json::array();
-        
-        for (const auto& q : questions) {
-            json question_json;
-            question_json["q_id"] = q.question_id;
-            question_json["content"] = q.content;
-            // Add options (without correct answer)
-            for (auto it = q.options.begin(); it != q.options.end(); ++it) {
-                question_json["option_" + it.key()] = it.value();
-            }
-            response["questions"].push_back(question_json);
-        }
-        
-        Protocol::send_message(client_fd, S2C_PRACTICE_QUESTIONS, response);
+        send_serialized(client_fd, S2C_PRACTICE_QUESTIONS, QuestionPayload::build(response, questions));
         LOG_INFO("Practice questions sent to user " + std::to_string(user_id));
     } catch (const std::exception& e) {
         LOG_ERROR("handle_practice_request error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
 void Server::handle_practice_submit(int client_fd, const json& payload) {
     try {
-        std::string session_token = payload["session_token"];
+        std::string session_token = payload.value("session_token", "");
         int user_id;
         std::string role;
         
@@ -515,21 +1550,20 @@ void Server::handle_practice_submit(int client_fd, const json& payload) {
         }
         
         json answers = payload["answers"];
-        int correct_count = 0;
         int total_questions = answers.size();
         
-        // Check each answer
+        // Whole answer key in one lookup, then one pass over both vectors
+        std::vector<int> question_ids;
+        std::vector<uint8_t> selected;
+        question_ids.reserve(answers.size());
+        selected.reserve(answers.size());
         for (const auto& answer : answers) {
-            int q_id = answer["q_id"];
-            std::string selected = answer["selected_option"];
-            
-            Question question;
-            if (db->get_question_by_id(q_id, question)) {
-                if (selected == "option_" + question.correct_option) {
-                    correct_count++;
-                }
-            }
+            question_ids.push_back(answer["q_id"]);
+            selected.push_back(Grader::encode_option(answer["selected_option"]));
         }
+        std::vector<uint8_t> key;
+        db->get_answer_key(question_ids, key);
+        int correct_count = static_cast<int>(Grader::grade(selected.data(), key.data(), selected.size()));
         
         // Save to history
         float score_percentage = (float)correct_count / total_questions * 100.0f;
@@ -542,21 +1576,21 @@ void Server::handle_practice_submit(int client_fd, const json& payload) {
         json response;
         response["correct_count"] = correct_count;
         response["total_questions"] = total_questions;
-        Protocol::send_message(client_fd, S2C_PRACTICE_RESULT, response);
+        send_message(client_fd, S2C_PRACTICE_RESULT, response);
         
         LOG_INFO("Practice submitted: user=" + std::to_string(user_id) + 
                 ", score=" + std::to_string(correct_count) + "/" + std::to_string(total_questions));
     } catch (const std::exception& e) {
         LOG_ERROR("handle_practice_submit error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
 // Test room handlers
 void Server::handle_list_rooms(int client_fd, const json& payload) {
     try {
-        std::string session_token = payload["session_token"];
+        std::string session_token = payload.value("session_token", "");
         int user_id;
         std::string role;
         
@@ -579,18 +1613,18 @@ void Server::handle_list_rooms(int client_fd, const json& payload) {
             response["rooms"].push_back(room_json);
         }
         
-        Protocol::send_message(client_fd, S2C_ROOM_LIST, response);
+        send_message(client_fd, S2C_ROOM_LIST, response);
         LOG_INFO("Room list sent to user " + std::to_string(user_id));
     } catch (const std::exception& e) {
         LOG_ERROR("handle_list_rooms error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
 void Server::handle_create_room(int client_fd, const json& payload) {
     try {
-        std::string session_token = payload["session_token"];
+        std::string session_token = payload.value("session_token", "");
         int user_id;
         std::string role;
         
@@ -602,7 +1636,7 @@ void Server::handle_create_room(int client_fd, const json& payload) {
         if (role != "TEACHER") {
             LOG_WARN("Permission denied: User " + std::to_string(user_id) + " is not a TEACHER");
             json error = Protocol::create_error_response(ERR_NOT_ROOM_OWNER, "Only teachers can create rooms");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
@@ -629,24 +1663,24 @@ void Server::handle_create_room(int client_fd, const json& payload) {
             json response;
             response["room_id"] = room_id;
             response["message"] = "Room created successfully";
-            Protocol::send_message(client_fd, S2C_ROOM_CREATED, response);
+            send_message(client_fd, S2C_ROOM_CREATED, response);
             
             LOG_INFO("Room created: id=" + std::to_string(room_id) + ", name=" + name);
         } else {
             LOG_ERROR("Database create_test_room failed");
             json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Failed to create room");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
         }
     } catch (const std::exception& e) {
         LOG_ERROR("handle_create_room error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
 void Server::handle_join_room(int client_fd, const json& payload) {
     try {
-        std::string session_token = payload["session_token"];
+        std::string session_token = payload.value("session_token", "");
         int user_id;
         std::string role;
         
@@ -660,26 +1694,25 @@ void Server::handle_join_room(int client_fd, const json& payload) {
         TestRoom room;
         if (!db->get_room_by_id(room_id, room)) {
             json error = Protocol::create_error_response(ERR_ROOM_NOT_FOUND, "Room not found");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
         // Check if room not started
         if (room.status != "NOT_STARTED") {
             json error = Protocol::create_error_response(ERR_ROOM_STARTED, "Room already started or finished");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
         // Add participant
         if (!db->add_participant(room_id, user_id)) {
             json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Failed to join room");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
-        // Add to room_clients
-        room_clients[room_id].insert(client_fd);
+        add_room_member(client_fd, room_id);
         
         // Get all participants
         std::vector<std::string> participants = db->get_room_participants(room_id);
@@ -689,7 +1722,7 @@ void Server::handle_join_room(int client_fd, const json& payload) {
         response["room_id"] = room_id;
         response["room_name"] = room.name;
         response["participants"] = participants;
-        Protocol::send_message(client_fd, S2C_JOIN_OK, response);
+        send_message(client_fd, S2C_JOIN_OK, response);
         
         // Broadcast to other participants
         User user;
@@ -703,34 +1736,278 @@ void Server::handle_join_room(int client_fd, const json& payload) {
     } catch (const std::exception& e) {
         LOG_ERROR("handle_join_room error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
+    }
+}
+
+// Exam sheets live in the ExamEngine from START_TEST until the exam ends
+// (everyone submitted, or end_timestamp passed); UserTestAnswers is
+// written behind it through the engine's sink.
+static json exam_error(ExamChange result) {
+    switch (result) {
+        case ExamChange::NOT_RUNNING:
+            return Protocol::create_error_response(ERR_ROOM_NOT_FOUND, "No test in progress in this room");
+        case ExamChange::NOT_PARTICIPANT:
+            return Protocol::create_error_response(ERR_PERMISSION_DENIED, "Not a participant of this room");
+        case ExamChange::UNKNOWN_QUESTION:
+            return Protocol::create_error_response(ERR_QUESTION_NOT_FOUND, "Question is not part of this test");
+        case ExamChange::SUBMITTED:
+            return Protocol::create_error_response(ERR_PERMISSION_DENIED, "Test already submitted");
+        default:
+            return Protocol::create_error_response(ERR_SYSTEM_ERROR, "Invalid option");
     }
 }
 
-// Placeholder handlers (to be implemented in Phase 5)
 void Server::handle_start_test(int client_fd, const json& payload) {
-    (void)payload; // Will be used in Phase 5
-    LOG_INFO("handle_start_test called (not implemented yet)");
-    json response = Protocol::create_success_response("Start test - not implemented");
-    Protocol::send_message(client_fd, S2C_RESPONSE_OK, response);
+    try {
+        std::string session_token = payload.value("session_token", "");
+        int user_id;
+        std::string role;
+        
+        if (!validate_session(client_fd, session_token, user_id, role)) {
+            return;
+        }
+        
+        int room_id = payload["room_id"];
+        
+        TestRoom room;
+        if (!db->get_room_by_id(room_id, room)) {
+            json error = Protocol::create_error_response(ERR_ROOM_NOT_FOUND, "Room not found");
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            return;
+        }
+        
+        if (room.creator_id != user_id) {
+            json error = Protocol::create_error_response(ERR_NOT_ROOM_OWNER, "Only the room owner can start the test");
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            return;
+        }
+        
+        if (room.status != "NOT_STARTED" || !exam_engine) {
+            json error = Protocol::create_error_response(ERR_ROOM_STARTED, "Room already started or finished");
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            return;
+        }
+        
+        // The exam: drawn with the filters chosen at room creation
+        std::string topic = "all";
+        std::string difficulty = "all";
+        if (room.filters_used.is_object()) {
+            topic = room.filters_used.value("topic", "all");
+            difficulty = room.filters_used.value("difficulty", "all");
+        }
+        std::vector<Question> questions = db->get_random_questions(room.num_questions, topic, difficulty);
+        if (questions.empty()) {
+            json error = Protocol::create_error_response(ERR_QUESTION_NOT_FOUND, "No questions match this room");
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            return;
+        }
+        
+        std::vector<int> question_ids;
+        for (const auto& q : questions) {
+            question_ids.push_back(q.question_id);
+        }
+        
+        // The database decides: only one START_TEST moves the room out of
+        // NOT_STARTED, and it gets the final participant list (later joins fail)
+        int duration_seconds = room.duration_minutes * 60;
+        time_t end_time = time(nullptr) + duration_seconds;
+        std::vector<int> user_ids;
+        if (!db->start_room(room_id, question_ids, SessionManager::get_current_timestamp(),
+                            SessionManager::get_future_timestamp(duration_seconds), user_ids)) {
+            json error = Protocol::create_error_response(ERR_ROOM_STARTED, "Room already started or finished");
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            return;
+        }
+        
+        // Nobody has seen the room running yet: TEST_STARTED goes out below
+        if (!exam_engine->start(room_id, question_ids, user_ids, end_time)) {
+            db->cancel_room_start(room_id);
+            LOG_ERROR("Test not started: room=" + std::to_string(room_id) + " is already in the exam engine");
+            json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Failed to start the test");
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            return;
+        }
+        arm_exam_deadline(room_id, duration_seconds * 1000ULL);
+        
+        // Same question format as S2C_PRACTICE_QUESTIONS, serialized once for the room
+        json fields;
+        fields["room_id"] = room_id;
+        fields["end_timestamp"] = static_cast<int64_t>(end_time);
+        fields["duration_seconds"] = duration_seconds;
+        broadcast_shared(room_id, S2C_TEST_STARTED, QuestionPayload::build(fields, questions));
+        
+        json status;
+        status["room_id"] = room_id;
+        status["new_status"] = "ONGOING";
+        broadcast_to_all(S2C_ROOM_STATUS_CHANGED, status);
+        
+        LOG_INFO("Test started: room=" + std::to_string(room_id) + ", participants=" +
+                 std::to_string(user_ids.size()) + ", questions=" + std::to_string(question_ids.size()));
+    } catch (const std::exception& e) {
+        LOG_ERROR("handle_start_test error: " + std::string(e.what()));
+        json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
+    }
 }
 
 void Server::handle_change_answer(int client_fd, const json& payload) {
-    (void)client_fd; // Will be used in Phase 5
-    (void)payload;   // Will be used in Phase 5
-    LOG_INFO("handle_change_answer called (not implemented yet)");
+    try {
+        std::string session_token = payload.value("session_token", "");
+        int user_id;
+        std::string role;
+        
+        if (!validate_session(client_fd, session_token, user_id, role)) {
+            return;
+        }
+        
+        int room_id = payload["room_id"];
+        int question_id = payload["q_id"];
+        std::string selected_option = payload["selected_option"];
+        
+        // No reply on success (the client does not wait for one)
+        ExamChange result = exam_engine ? exam_engine->change_answer(room_id, user_id, question_id, selected_option)
+                                        : ExamChange::NOT_RUNNING;
+        if (result != ExamChange::OK) {
+            send_message(client_fd, S2C_RESPONSE_ERROR, exam_error(result));
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("handle_change_answer error: " + std::string(e.what()));
+        json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
+    }
 }
 
 void Server::handle_submit_test(int client_fd, const json& payload) {
-    (void)payload; // Will be used in Phase 5
-    LOG_INFO("handle_submit_test called (not implemented yet)");
-    json response = Protocol::create_success_response("Submit test - not implemented");
-    Protocol::send_message(client_fd, S2C_RESPONSE_OK, response);
+    try {
+        std::string session_token = payload.value("session_token", "");
+        int user_id;
+        std::string role;
+        
+        if (!validate_session(client_fd, session_token, user_id, role)) {
+            return;
+        }
+        
+        int room_id = payload["room_id"];
+        
+        // Final answers sent with the submission
+        std::vector<std::pair<int, std::string>> answers;
+        if (payload.contains("answers") && payload["answers"].is_array()) {
+            for (const auto& answer : payload["answers"]) {
+                answers.emplace_back(answer["q_id"], answer["selected_option"]);
+            }
+        }
+        
+        bool all_submitted = false;
+        ExamChange result = exam_engine ? exam_engine->submit(room_id, user_id, answers, all_submitted)
+                                        : ExamChange::NOT_RUNNING;
+        if (result != ExamChange::OK) {
+            send_message(client_fd, S2C_RESPONSE_ERROR, exam_error(result));
+            return;
+        }
+
+        // The final answers are stored before the sheet counts as handed in;
+        // if they cannot be, the sheet stays open and the client may retry
+        if (answer_writer && !answer_writer->flush()) {
+            exam_engine->withdraw(room_id, user_id);
+            json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Answers not stored, please submit again");
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            return;
+        }
+        db->update_participant_status(room_id, user_id, "SUBMITTED");
+        
+        json response = Protocol::create_success_response("Test submitted");
+        send_message(client_fd, S2C_RESPONSE_OK, response);
+        LOG_INFO("User " + std::to_string(user_id) + " submitted room " + std::to_string(room_id));
+        
+        // Last sheet in: no need to wait for end_timestamp
+        if (all_submitted) {
+            schedule_finish_exam(room_id);
+        }
+    } catch (const std::exception& e) {
+        LOG_ERROR("handle_submit_test error: " + std::string(e.what()));
+        json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
+    }
+}
+
+void Server::finish_exam(int room_id) {
+    std::shared_ptr<ExamRoom> room = exam_engine ? exam_engine->finish(room_id) : nullptr;
+    if (!room) {
+        return;     // Not running, or ended by another thread
+    }
+    
+    // Graded from the sheets in memory; the queued answers are stored
+    // first so is_correct lands on every row
+    bool stored = !answer_writer || answer_writer->flush();
+    std::vector<uint8_t> key;
+    SheetGrades grades;
+    if (stored) {
+        db->get_answer_key(room->question_ids, key);
+        Grader::grade_sheets(room->sheets, key.data(), grades);
+        stored = db->finish_room(room_id, room->user_ids, room->question_ids, grades);
+    }
+    if (!stored) {
+        // Nothing announced yet: keep the room running (closed) and try again
+        exam_engine->restore(room);
+        LOG_WARN("Test results not stored: room=" + std::to_string(room_id) + ", retrying in " +
+                 std::to_string(EXAM_FINISH_RETRY_MS) + " ms");
+        post_timer(EXAM_FINISH_RETRY_MS, TIMER_EXAM_RETRY, room_id);
+        return;
+    }
+    
+    json ended;
+    ended["room_id"] = room_id;
+    ended["message"] = "Test ended";
+    publish_to_room(room_id, S2C_TEST_ENDED, Protocol::serialize(ended));
+    
+    // Rank: 1 + participants with a higher score
+    std::vector<uint32_t> ranking(grades.scores);
+    std::sort(ranking.begin(), ranking.end(), std::greater<uint32_t>());
+    std::shared_ptr<UserPayloads> results = std::make_shared<UserPayloads>();
+    for (size_t row = 0; row < room->user_ids.size(); row++) {
+        uint32_t score = grades.scores[row];
+        json result;
+        result["room_id"] = room_id;
+        result["correct_count"] = score;
+        result["total_questions"] = room->question_ids.size();
+        result["rank"] = 1 + (std::lower_bound(ranking.begin(), ranking.end(), score, std::greater<uint32_t>()) -
+                              ranking.begin());
+        (*results)[room->user_ids[row]] = Protocol::serialize(result);
+    }
+    publish_to_room(room_id, S2C_YOUR_RESULT, nullptr, results);
+    
+    json status;
+    status["room_id"] = room_id;
+    status["new_status"] = "FINISHED";
+    publish_to_room(-1, S2C_ROOM_STATUS_CHANGED, Protocol::serialize(status));
+    
+    LOG_INFO("Test ended: room=" + std::to_string(room_id) + ", submitted=" + std::to_string(room->submitted_count) +
+             "/" + std::to_string(room->user_ids.size()));
+}
+
+void Server::handle_exam_deadline(int room_id) {
+    if (!exam_engine || !exam_engine->close(room_id)) {
+        return;     // Every sheet was handed in already
+    }
+    LOG_INFO("Test time is up: room=" + std::to_string(room_id));
+    schedule_timer(EXAM_GRACE_SECONDS * 1000, TIMER_EXAM_GRACE, room_id);
+}
+
+void Server::schedule_finish_exam(int room_id) {
+    // Grading writes to the database: off the event loop when there is a pool.
+    // From a pool handler the task queues behind it, so the handler's reply
+    // is normally delivered before the results.
+    if (task_pool) {
+        task_pool->submit([this, room_id]() { finish_exam(room_id); });
+    } else {
+        finish_exam(room_id);
+    }
 }
 
 void Server::handle_get_history(int client_fd, const json& payload) {
     try {
-        std::string session_token = payload["session_token"];
+        std::string session_token = payload.value("session_token", "");
         int user_id;
         std::string role;
         
@@ -747,17 +2024,17 @@ void Server::handle_get_history(int client_fd, const json& payload) {
         
         json response;
         response["history"] = history;
-        Protocol::send_message(client_fd, S2C_HISTORY_DATA, response);
+        send_message(client_fd, S2C_HISTORY_DATA, response);
     } catch (const std::exception& e) {
         LOG_ERROR("handle_get_history error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
 void Server::handle_get_stats(int client_fd, const json& payload) {
     try {
-        std::string session_token = payload["session_token"];
+        std::string session_token = payload.value("session_token", "");
         int user_id;
         std::string role;
         
@@ -766,17 +2043,17 @@ void Server::handle_get_stats(int client_fd, const json& payload) {
         }
         
         json stats = db->get_user_statistics(user_id);
-        Protocol::send_message(client_fd, S2C_STATS_DATA, stats);
+        send_message(client_fd, S2C_STATS_DATA, stats);
     } catch (const std::exception& e) {
         LOG_ERROR("handle_get_stats error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
 void Server::handle_view_room_results(int client_fd, const json& payload) {
     try {
-        std::string session_token = payload["session_token"];
+        std::string session_token = payload.value("session_token", "");
         int user_id;
         std::string role;
         
@@ -789,7 +2066,7 @@ void Server::handle_view_room_results(int client_fd, const json& payload) {
         TestRoom room;
         if (!db->get_room_by_id(room_id, room)) {
             json error = Protocol::create_error_response(ERR_ROOM_NOT_FOUND, "Room not found");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
@@ -798,21 +2075,18 @@ void Server::handle_view_room_results(int client_fd, const json& payload) {
         response["room_id"] = room_id;
         response["room_name"] = room.name;
         response["results"] = results;
-        Protocol::send_message(client_fd, S2C_ROOM_RESULTS_DATA, response);
+        send_message(client_fd, S2C_ROOM_RESULTS_DATA, response);
     } catch (const std::exception& e) {
         LOG_ERROR("handle_view_room_results error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
 // Question Management Handlers
 void Server::handle_list_questions(int client_fd, const json& payload) {
     try {
-        std::string session_token = "";
-        if (payload.contains("session_token")) {
-            session_token = payload["session_token"];
-        }
+        std::string session_token = payload.value("session_token", "");
         
         int user_id;
         std::string role;
@@ -823,7 +2097,7 @@ void Server::handle_list_questions(int client_fd, const json& payload) {
         
         if (role != "TEACHER") {
             json error = Protocol::create_error_response(ERR_PERMISSION_DENIED, "Only teachers can view questions");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
@@ -839,31 +2113,29 @@ void Server::handle_list_questions(int client_fd, const json& payload) {
             item["correct_answer"] = q.correct_option;
             
             // Unpack options
-            if (q.options.contains("a")) item["option_a"] = q.options["a"];
-            if (q.options.contains("b")) item["option_b"] = q.options["b"];
-            if (q.options.contains("c")) item["option_c"] = q.options["c"];
-            if (q.options.contains("d")) item["option_d"] = q.options["d"];
+            for (int i = 0; i < QuestionOptions::COUNT; i++) {
+                if (q.options.has(i)) {
+                    item[std::string("option_") + QuestionOptions::key(i)] = q.options.text[i];
+                }
+            }
             
             question_list.push_back(item);
         }
         
         json response;
         response["questions"] = question_list;
-        Protocol::send_message(client_fd, S2C_QUESTIONS_LIST, response);
+        send_message(client_fd, S2C_QUESTIONS_LIST, response);
         LOG_INFO("Sent question list to teacher: " + std::to_string(user_id));
     } catch (const std::exception& e) {
         LOG_ERROR("handle_list_questions error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "System error");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
 void Server::handle_create_question(int client_fd, const json& payload) {
     try {
-        std::string session_token = "";
-        if (payload.contains("session_token")) {
-            session_token = payload["session_token"];
-        }
+        std::string session_token = payload.value("session_token", "");
         
         int user_id;
         std::string role;
@@ -876,7 +2148,7 @@ void Server::handle_create_question(int client_fd, const json& payload) {
         if (role != "TEACHER") {
             LOG_WARN("Permission denied: User " + std::to_string(user_id) + " is not a TEACHER");
             json error = Protocol::create_error_response(ERR_PERMISSION_DENIED, "Only teachers can create questions");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
@@ -885,7 +2157,7 @@ void Server::handle_create_question(int client_fd, const json& payload) {
             !payload.contains("difficulty") || !payload.contains("correct_answer")) {
             LOG_WARN("Missing required fields in create_question payload");
             json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Missing required fields");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
@@ -910,26 +2182,23 @@ void Server::handle_create_question(int client_fd, const json& payload) {
             json response;
             response["question_id"] = question_id;
             response["message"] = "Question created successfully";
-            Protocol::send_message(client_fd, S2C_QUESTION_CREATED, response);
+            send_message(client_fd, S2C_QUESTION_CREATED, response);
             LOG_INFO("Question created by user " + std::to_string(user_id) + ": " + std::to_string(question_id));
         } else {
             LOG_ERROR("Database create_question failed");
             json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Failed to create question");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
         }
     } catch (const std::exception& e) {
         LOG_ERROR("handle_create_question error: " + std::string(e.what()));
         json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Invalid data format");
-        Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+        send_message(client_fd, S2C_RESPONSE_ERROR, error);
     }
 }
 
 void Server::handle_update_question(int client_fd, const json& payload) {
     try {
-        std::string session_token = "";
-        if (payload.contains("session_token")) {
-            session_token = payload["session_token"];
-        }
+        std::string session_token = payload.value("session_token", "");
         
         int user_id;
         std::string role;
@@ -940,13 +2209,13 @@ void Server::handle_update_question(int client_fd, const json& payload) {
         
         if (role != "TEACHER") {
             json error = Protocol::create_error_response(ERR_PERMISSION_DENIED, "Only teachers can update questions");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
         if (!payload.contains("question_id")) {
              json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Missing question_id");
-             Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+             send_message(client_fd, S2C_RESPONSE_ERROR, error);
              return;
         }
         
@@ -956,13 +2225,13 @@ void Server::handle_update_question(int client_fd, const json& payload) {
         Question q;
         if (!db->get_question_by_id(question_id, q)) {
             json error = Protocol::create_error_response(ERR_QUESTION_NOT_FOUND, "Question not found");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
         if (q.created_by != user_id) {
             json error = Protocol::create_error_response(ERR_PERMISSION_DENIED, "You can only edit your own questions");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
@@ -970,7 +2239,7 @@ void Server::handle_update_question(int client_fd, const json& payload) {
         if (!payload.contains("question_text") || !payload.contains("subject") || 
             !payload.contains("difficulty") || !payload.contains("correct_answer")) {
             json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Missing required fields");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
@@ -994,11 +2263,11 @@ void Server::handle_update_question(int client_fd, const json& payload) {
             json response;
             response["question_id"] = question_id;
             response["message"] = "Question updated successfully";
-            Protocol::send_message(client_fd, S2C_QUESTION_UPDATED, response);
+            send_message(client_fd, S2C_QUESTION_UPDATED, response);
             LOG_INFO("Question updated: " + std::to_string(question_id));
         } else {
             json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Failed to update question");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
         }
     } catch (const std::exception& e) {
         LOG_ERROR("handle_update_question error: " + std::string(e.what()));
@@ -1007,7 +2276,7 @@ void Server::handle_update_question(int client_fd, const json& payload) {
 
 void Server::handle_delete_question(int client_fd, const json& payload) {
     try {
-        std::string session_token = payload["session_token"];
+        std::string session_token = payload.value("session_token", "");
         int user_id;
         std::string role;
         
@@ -1017,7 +2286,7 @@ void Server::handle_delete_question(int client_fd, const json& payload) {
         
         if (role != "TEACHER") {
             json error = Protocol::create_error_response(ERR_PERMISSION_DENIED, "Only teachers can delete questions");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
@@ -1027,13 +2296,13 @@ void Server::handle_delete_question(int client_fd, const json& payload) {
         Question q;
         if (!db->get_question_by_id(question_id, q)) {
             json error = Protocol::create_error_response(ERR_QUESTION_NOT_FOUND, "Question not found");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
         if (q.created_by != user_id) {
             json error = Protocol::create_error_response(ERR_PERMISSION_DENIED, "You can only delete your own questions");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
             return;
         }
         
@@ -1041,11 +2310,11 @@ void Server::handle_delete_question(int client_fd, const json& payload) {
             json response;
             response["question_id"] = question_id;
             response["message"] = "Question deleted successfully";
-            Protocol::send_message(client_fd, S2C_QUESTION_DELETED, response);
+            send_message(client_fd, S2C_QUESTION_DELETED, response);
             LOG_INFO("Question deleted: " + std::to_string(question_id));
         } else {
             json error = Protocol::create_error_response(ERR_SYSTEM_ERROR, "Failed to delete question");
-            Protocol::send_message(client_fd, S2C_RESPONSE_ERROR, error);
+            send_message(client_fd, S2C_RESPONSE_ERROR, error);
         }
     } catch (const std::exception& e) {
         LOG_ERROR("handle_delete_question error: " + std::string(e.what()));
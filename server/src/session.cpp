@@ -3,13 +3,67 @@
 #include <sstream>
 #include <iomanip>
 #include <ctime>
+#include <stdexcept>
+#include <atomic>
+#include <cstdlib>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/rand.h>
 #include <openssl/sha.h>
 
+#define KDF_PREFIX "pbkdf2_sha256$"
+
+static std::atomic<int> kdf_work_factor(DEFAULT_KDF_ITERATIONS);
+
+static std::string to_hex(const unsigned char* data, size_t length) {
+    std::stringstream ss;
+    for (size_t i = 0; i < length; ++i) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << (int)data[i];
+    }
+    return ss.str();
+}
+
+static std::string pbkdf2_hex(const std::string& password, const std::string& salt, int iterations) {
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    PKCS5_PBKDF2_HMAC(password.data(), static_cast<int>(password.size()),
+                      reinterpret_cast<const unsigned char*>(salt.data()), static_cast<int>(salt.size()),
+                      iterations, EVP_sha256(), sizeof(hash), hash);
+    return to_hex(hash, sizeof(hash));
+}
+
+// Hashes written before the KDF: unsalted SHA-256 as 64 hex digits
+static std::string sha256_hex(const std::string& password) {
+    unsigned char hash[SHA256_DIGEST_LENGTH];
+    SHA256(reinterpret_cast<const unsigned char*>(password.c_str()), password.length(), hash);
+    return to_hex(hash, sizeof(hash));
+}
+
+// Split "pbkdf2_sha256$<iterations>$<salt>$<hash>"
+static bool parse_kdf_hash(const std::string& stored, int& iterations, std::string& salt, std::string& hash) {
+    if (stored.compare(0, sizeof(KDF_PREFIX) - 1, KDF_PREFIX) != 0) {
+        return false;
+    }
+    size_t salt_pos = stored.find('$', sizeof(KDF_PREFIX) - 1);
+    size_t hash_pos = salt_pos == std::string::npos ? std::string::npos : stored.find('$', salt_pos + 1);
+    if (hash_pos == std::string::npos) {
+        return false;
+    }
+    iterations = atoi(stored.c_str() + sizeof(KDF_PREFIX) - 1);
+    salt = stored.substr(salt_pos + 1, hash_pos - salt_pos - 1);
+    hash = stored.substr(hash_pos + 1);
+    return iterations > 0 && !salt.empty() && !hash.empty();
+}
+
+static bool equal_constant_time(const std::string& a, const std::string& b) {
+    return a.size() == b.size() && CRYPTO_memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
 std::string SessionManager::generate_token(size_t length) {
     static const char chars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz";
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
-    static std::uniform_int_distribution<> dis(0, sizeof(chars) - 2);
+    // Per-thread generator: tokens are created from several worker threads
+    static thread_local std::random_device rd;
+    static thread_local std::mt19937 gen(rd());
+    static thread_local std::uniform_int_distribution<> dis(0, sizeof(chars) - 2);
     
     std::string token;
     token.reserve(length);
@@ -20,45 +74,69 @@ std::string SessionManager::generate_token(size_t length) {
 }
 
 std::string SessionManager::hash_password(const std::string& password) {
-    unsigned char hash[SHA256_DIGEST_LENGTH];
-    SHA256(reinterpret_cast<const unsigned char*>(password.c_str()), 
-           password.length(), hash);
-    
-    std::stringstream ss;
-    for (int i = 0; i < SHA256_DIGEST_LENGTH; ++i) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
+    unsigned char salt_bytes[KDF_SALT_BYTES];
+    if (RAND_bytes(salt_bytes, sizeof(salt_bytes)) != 1) {
+        throw std::runtime_error("RAND_bytes failed");
     }
-    return ss.str();
+    
+    // The salt is stored (and fed to the KDF) as hex text
+    std::string salt = to_hex(salt_bytes, sizeof(salt_bytes));
+    int iterations = kdf_iterations();
+    return KDF_PREFIX + std::to_string(iterations) + "$" + salt + "$" + pbkdf2_hex(password, salt, iterations);
 }
 
 bool SessionManager::verify_password(const std::string& password, const std::string& hash) {
-    return hash_password(password) == hash;
+    int iterations;
+    std::string salt;
+    std::string expected;
+    if (parse_kdf_hash(hash, iterations, salt, expected)) {
+        return equal_constant_time(pbkdf2_hex(password, salt, iterations), expected);
+    }
+    return equal_constant_time(sha256_hex(password), hash);
+}
+
+bool SessionManager::needs_rehash(const std::string& hash) {
+    int iterations;
+    std::string salt;
+    std::string expected;
+    return !parse_kdf_hash(hash, iterations, salt, expected) || iterations < kdf_iterations();
+}
+
+void SessionManager::set_kdf_iterations(int iterations) {
+    kdf_work_factor.store(iterations > 0 ? iterations : DEFAULT_KDF_ITERATIONS);
+}
+
+int SessionManager::kdf_iterations() {
+    return kdf_work_factor.load(std::memory_order_relaxed);
 }
 
 std::string SessionManager::get_current_timestamp() {
     time_t now = time(nullptr);
     char buf[80];
-    struct tm* tm_info = gmtime(&now);
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", tm_info);
+    struct tm tm_info;
+    gmtime_r(&now, &tm_info);
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm_info);
     return std::string(buf);
 }
 
 std::string SessionManager::get_future_timestamp(int seconds) {
     time_t future = time(nullptr) + seconds;
     char buf[80];
-    struct tm* tm_info = gmtime(&future);
-    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", tm_info);
+    struct tm tm_info;
+    gmtime_r(&future, &tm_info);
+    strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm_info);
     return std::string(buf);
 }
 
-bool SessionManager::is_timestamp_expired(const std::string& timestamp) {
-    // Parse timestamp string
+time_t SessionManager::parse_timestamp(const std::string& timestamp) {
     struct tm tm_time = {};
     strptime(timestamp.c_str(), "%Y-%m-%d %H:%M:%S", &tm_time);
-    time_t expiry_time = timegm(&tm_time);
-    
+    return timegm(&tm_time);
+}
+
+bool SessionManager::is_timestamp_expired(const std::string& timestamp) {
     // Compare with current time
     time_t now = time(nullptr);
-    return now >= expiry_time;
+    return now >= parse_timestamp(timestamp);
 }
 
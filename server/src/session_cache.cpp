@@ -0,0 +1,63 @@
+#include "../include/session_cache.h"
+#include <functional>
+
+SessionCache::Shard& SessionCache::shard_for(const std::string& token) {
+    // Tokens are random, any bits of the hash will do
+    size_t hash = std::hash<std::string>()(token);
+    return shards[(hash >> 8) & (SESSION_CACHE_SHARDS - 1)];
+}
+
+void SessionCache::put(const std::string& token, const CachedSession& session) {
+    Shard& shard = shard_for(token);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.sessions[token] = session;
+}
+
+bool SessionCache::get(const std::string& token, time_t now, CachedSession& session) {
+    Shard& shard = shard_for(token);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.sessions.find(token);
+    if (it == shard.sessions.end()) {
+        return false;
+    }
+    if (now >= it->second.expiry) {
+        shard.sessions.erase(it);
+        return false;
+    }
+    session = it->second;
+    return true;
+}
+
+void SessionCache::erase(const std::string& token) {
+    Shard& shard = shard_for(token);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.sessions.erase(token);
+    }
+    revocations.fetch_add(1, std::memory_order_release);
+}
+
+size_t SessionCache::purge_expired(time_t now) {
+    size_t removed = 0;
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.sessions.begin(); it != shard.sessions.end();) {
+            if (now >= it->second.expiry) {
+                it = shard.sessions.erase(it);
+                removed++;
+            } else {
+                ++it;
+            }
+        }
+    }
+    return removed;
+}
+
+size_t SessionCache::size() {
+    size_t total = 0;
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.sessions.size();
+    }
+    return total;
+}
@@ -0,0 +1,114 @@
+#include "../include/task_pool.h"
+#include "../include/logger.h"
+
+// Index of the pool thread running this code (-1 outside the pool), so a
+// task submitting follow-up work keeps it on its own deque
+static thread_local int current_worker = -1;
+
+TaskPool::TaskPool(int num_threads)
+    : next_queue(0), queued(0), stopping(false), executed(0), stolen(0) {
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    
+    for (int i = 0; i < num_threads; ++i) {
+        queues.emplace_back(new WorkQueue());
+    }
+    for (int i = 0; i < num_threads; ++i) {
+        threads.emplace_back([this, i]() { worker_loop(i); });
+    }
+    
+    LOG_INFO("Task pool started with " + std::to_string(num_threads) + " thread(s)");
+}
+
+TaskPool::~TaskPool() {
+    shutdown();
+}
+
+void TaskPool::submit(Task task) {
+    int index = current_worker;
+    if (index < 0) {
+        index = static_cast<int>(next_queue.fetch_add(1, std::memory_order_relaxed) % queues.size());
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    queued.fetch_add(1);
+    
+    // Taking sleep_mutex orders the increment before a sleeper's predicate check
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+    }
+    wake.notify_one();
+}
+
+bool TaskPool::take(int index, Task& task) {
+    {
+        WorkQueue& own = *queues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.front());
+            own.tasks.pop_front();
+            return true;
+        }
+    }
+    
+    int count = static_cast<int>(queues.size());
+    for (int offset = 1; offset < count; ++offset) {
+        WorkQueue& victim = *queues[(index + offset) % count];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskPool::worker_loop(int index) {
+    current_worker = index;
+    
+    while (true) {
+        Task task;
+        if (take(index, task)) {
+            queued.fetch_sub(1);
+            try {
+                task();
+            } catch (const std::exception& e) {
+                LOG_ERROR("Task pool: task failed: " + std::string(e.what()));
+            }
+            executed.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+        
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        if (stopping && queued.load() == 0) {
+            break;
+        }
+        wake.wait(lock, [this]() { return stopping || queued.load() > 0; });
+    }
+    
+    current_worker = -1;
+}
+
+void TaskPool::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(sleep_mutex);
+        if (stopping) {
+            return;
+        }
+        stopping = true;
+    }
+    wake.notify_all();
+    
+    for (auto& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads.clear();
+}
@@ -0,0 +1,218 @@
+#include "../include/timer_wheel.h"
+
+static const uint64_t SLOT_MASK = TIMER_WHEEL_SLOTS - 1;
+static const unsigned BLOCK_BITS = TIMER_WHEEL_BITS;            // Level 1 slot: 256 ticks
+static const unsigned SPAN_BITS = 2 * TIMER_WHEEL_BITS;         // Level 2 slot: 65536 ticks
+static const uint64_t SPAN_MASK = (1ULL << SPAN_BITS) - 1;
+
+static void set_bit(uint64_t* bits, uint32_t slot) {
+    bits[slot / 64] |= 1ULL << (slot % 64);
+}
+
+static void clear_bit(uint64_t* bits, uint32_t slot) {
+    bits[slot / 64] &= ~(1ULL << (slot % 64));
+}
+
+TimerWheel::TimerWheel(uint64_t now) : current(now), armed(0) {
+    for (uint64_t& bits : occupied) {
+        bits = 0;
+    }
+}
+
+int TimerWheel::ring_distance(uint32_t first_slot, uint32_t slot_count, uint32_t start) const {
+    const uint64_t* bits = occupied + first_slot / 64;
+    unsigned words = slot_count / 64;
+    unsigned first_word = start / 64;
+    for (unsigned i = 0; i <= words; i++) {
+        unsigned word = (first_word + i) % words;
+        uint64_t mask = bits[word];
+        if (i == 0) {
+            mask &= ~0ULL << (start % 64);          // From start on
+        } else if (i == words) {
+            mask &= ~(~0ULL << (start % 64));       // Wrapped: before start
+        }
+        if (mask) {
+            unsigned slot = word * 64 + __builtin_ctzll(mask);
+            return (slot - start) & (slot_count - 1);
+        }
+    }
+    return -1;
+}
+
+void TimerWheel::link(uint32_t index) {
+    Node& node = nodes[index];
+    if (node.expires > current + TIMER_WHEEL_RANGE) {
+        node.expires = current + TIMER_WHEEL_RANGE;
+    }
+    
+    // Level by distance in blocks: level 0 holds this block and the next
+    uint64_t blocks = (node.expires >> BLOCK_BITS) - (current >> BLOCK_BITS);
+    uint32_t slot;
+    if (blocks <= 1) {
+        slot = node.expires & (LEVEL1 - 1);
+    } else if (blocks <= TIMER_WHEEL_SLOTS) {
+        slot = LEVEL1 + ((node.expires >> BLOCK_BITS) & SLOT_MASK);
+    } else {
+        slot = LEVEL2 + ((node.expires >> SPAN_BITS) & SLOT_MASK);
+    }
+    
+    node.slot = slot;
+    node.position = static_cast<uint32_t>(slots[slot].size());
+    slots[slot].push_back(index);
+    set_bit(occupied, slot);
+}
+
+void TimerWheel::unlink(uint32_t index) {
+    Node& node = nodes[index];
+    std::vector<uint32_t>& entries = slots[node.slot];
+    uint32_t moved = entries.back();
+    entries[node.position] = moved;
+    nodes[moved].position = node.position;
+    entries.pop_back();
+    if (entries.empty()) {
+        clear_bit(occupied, node.slot);
+    }
+}
+
+void TimerWheel::release(uint32_t index) {
+    Node& node = nodes[index];
+    node.slot = NIL;
+    node.serial++;
+    free_nodes.push_back(index);
+    armed--;
+}
+
+void TimerWheel::refile(uint32_t slot) {
+    if (slots[slot].empty()) {
+        return;
+    }
+    clear_bit(occupied, slot);
+    
+    // Swapped with a spare array so both keep their capacity
+    refiling.swap(slots[slot]);
+    for (uint32_t index : refiling) {
+        link(index);
+    }
+    refiling.clear();
+}
+
+void TimerWheel::drain_next_block() {
+    uint32_t slot = LEVEL1 + (((current >> BLOCK_BITS) + 1) & SLOT_MASK);
+    std::vector<uint32_t>& entries = slots[slot];
+    if (entries.empty()) {
+        return;
+    }
+    
+    // An even share over the ticks left in this block
+    uint64_t ticks_left = TIMER_WHEEL_SLOTS - (current & SLOT_MASK);
+    size_t count = (entries.size() + ticks_left - 1) / ticks_left;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t index = entries.back();
+        entries.pop_back();
+        link(index);
+    }
+    if (entries.empty()) {
+        clear_bit(occupied, slot);
+    }
+}
+
+TimerId TimerWheel::schedule(uint64_t expires, const TimerEvent& event) {
+    uint32_t index;
+    if (!free_nodes.empty()) {
+        index = free_nodes.back();
+        free_nodes.pop_back();
+    } else {
+        index = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back();
+    }
+    
+    Node& node = nodes[index];
+    node.expires = expires > current ? expires : current + 1;
+    node.event = event;
+    link(index);
+    armed++;
+    return (static_cast<uint64_t>(node.serial) << 32) | (index + 1);
+}
+
+bool TimerWheel::cancel(TimerId id) {
+    uint32_t index = static_cast<uint32_t>(id) - 1;
+    if (id == 0 || index >= nodes.size()) {
+        return false;
+    }
+    Node& node = nodes[index];
+    if (node.slot == NIL || node.serial != static_cast<uint32_t>(id >> 32)) {
+        return false;
+    }
+    unlink(index);
+    release(index);
+    return true;
+}
+
+void TimerWheel::advance(uint64_t now, std::vector<TimerEvent>& fired) {
+    if (now <= current) {
+        return;
+    }
+    
+    while (current < now) {
+        // Ticks with nothing to fire or move down are skipped
+        uint64_t next = next_expiry();
+        if (next > now) {
+            current = now;
+            break;
+        }
+        current = next;
+        
+        if ((current & SLOT_MASK) == 0) {
+            // Block boundary: what is left of this block at level 1 moves down,
+            // and a level-2 slot one block before its span
+            refile(LEVEL1 + ((current >> BLOCK_BITS) & SLOT_MASK));
+            if ((current & SPAN_MASK) == SPAN_MASK + 1 - TIMER_WHEEL_SLOTS) {
+                refile(LEVEL2 + (((current >> SPAN_BITS) + 1) & SLOT_MASK));
+            }
+        }
+        
+        // Level 0 slot: every timer in it is due now
+        uint32_t slot = current & (LEVEL1 - 1);
+        clear_bit(occupied, slot);
+        for (uint32_t index : slots[slot]) {
+            fired.push_back(nodes[index].event);
+            release(index);
+        }
+        slots[slot].clear();
+    }
+    drain_next_block();
+}
+
+uint64_t TimerWheel::next_expiry() const {
+    if (armed == 0) {
+        return UINT64_MAX;
+    }
+    
+    // Level 0 slots in tick order, starting after the current one
+    uint64_t next = UINT64_MAX;
+    int distance = ring_distance(0, LEVEL1, (current + 1) & (LEVEL1 - 1));
+    if (distance >= 0) {
+        next = current + 1 + distance;
+    }
+    
+    // First block with timers still at level 1: its boundary
+    uint64_t block = (current >> BLOCK_BITS) + 1;
+    distance = ring_distance(LEVEL1, TIMER_WHEEL_SLOTS, block & SLOT_MASK);
+    if (distance >= 0) {
+        uint64_t boundary = (block + distance) << BLOCK_BITS;
+        if (boundary < next) {
+            next = boundary;
+        }
+    }
+    
+    // First level-2 slot: the last block before its span
+    uint64_t span = (current >> SPAN_BITS) + 1;
+    distance = ring_distance(LEVEL2, TIMER_WHEEL_SLOTS, span & SLOT_MASK);
+    if (distance >= 0) {
+        uint64_t refile_at = ((span + distance) << SPAN_BITS) - TIMER_WHEEL_SLOTS;
+        if (refile_at < next) {
+            next = refile_at;
+        }
+    }
+    return next;
+}
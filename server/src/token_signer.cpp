@@ -0,0 +1,181 @@
+#include "../include/token_signer.h"
+#include "../include/logger.h"
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+
+TokenSigner::TokenSigner() : current_key(0) {
+}
+
+std::string TokenSigner::hmac_hex(const std::string& key, const std::string& data) {
+    unsigned char mac[EVP_MAX_MD_SIZE];
+    unsigned int length = 0;
+    HMAC(EVP_sha256(), key.data(), static_cast<int>(key.size()),
+         reinterpret_cast<const unsigned char*>(data.data()), data.size(), mac, &length);
+    
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(length * 2, '0');
+    for (unsigned int i = 0; i < length; ++i) {
+        hex[2 * i] = digits[mac[i] >> 4];
+        hex[2 * i + 1] = digits[mac[i] & 0x0f];
+    }
+    return hex;
+}
+
+bool TokenSigner::add_key(uint32_t key_id, const std::string& secret) {
+    if (secret.size() < 16) {
+        LOG_ERROR("Token key " + std::to_string(key_id) + " is too short (16 bytes minimum)");
+        return false;
+    }
+    keys[key_id] = secret;
+    current_key = key_id;
+    return true;
+}
+
+bool TokenSigner::load_key_file(const std::string& path) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        LOG_ERROR("Cannot open token key file: " + path);
+        return false;
+    }
+    
+    std::string line;
+    int loaded = 0;
+    while (std::getline(file, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream fields(line);
+        uint32_t key_id;
+        std::string secret;
+        if (!(fields >> key_id >> secret) || !add_key(key_id, secret)) {
+            LOG_ERROR("Invalid token key line in " + path);
+            return false;
+        }
+        loaded++;
+    }
+    
+    if (loaded == 0) {
+        LOG_ERROR("No token keys in " + path);
+        return false;
+    }
+    LOG_INFO("Loaded " + std::to_string(loaded) + " token key(s), signing with key " +
+             std::to_string(current_key));
+    return true;
+}
+
+bool TokenSigner::generate_key() {
+    unsigned char secret[32];
+    if (RAND_bytes(secret, sizeof(secret)) != 1) {
+        LOG_ERROR("Failed to generate a token key");
+        return false;
+    }
+    
+    static const char digits[] = "0123456789abcdef";
+    std::string hex;
+    for (unsigned char byte : secret) {
+        hex += digits[byte >> 4];
+        hex += digits[byte & 0x0f];
+    }
+    LOG_WARN("No --token-keys file: signing with a random key, tokens are lost on restart");
+    return add_key(1, hex);
+}
+
+bool TokenSigner::is_signed(const std::string& token) {
+    return token.compare(0, sizeof(SIGNED_TOKEN_PREFIX) - 1, SIGNED_TOKEN_PREFIX) == 0;
+}
+
+std::string TokenSigner::issue(int user_id, const std::string& role, time_t expiry) const {
+    std::string body = SIGNED_TOKEN_PREFIX + std::to_string(current_key) + "." + std::to_string(user_id) +
+                       "." + role + "." + std::to_string(static_cast<long long>(expiry));
+    return body + "." + hmac_hex(keys.at(current_key), body);
+}
+
+bool TokenSigner::verify(const std::string& token, time_t now, SignedToken& claims) {
+    if (!is_signed(token)) {
+        return false;
+    }
+    
+    // s1.<key id>.<user id>.<role>.<expiry>.<mac>
+    size_t mac_pos = token.rfind('.');
+    if (mac_pos == std::string::npos) {
+        return false;
+    }
+    std::string body = token.substr(0, mac_pos);
+    std::string mac = token.substr(mac_pos + 1);
+    
+    std::vector<std::string> fields;
+    size_t start = sizeof(SIGNED_TOKEN_PREFIX) - 1;
+    while (true) {
+        size_t dot = body.find('.', start);
+        fields.push_back(body.substr(start, dot == std::string::npos ? std::string::npos : dot - start));
+        if (dot == std::string::npos) {
+            break;
+        }
+        start = dot + 1;
+    }
+    if (fields.size() != 4) {
+        return false;
+    }
+    
+    char* end = nullptr;
+    unsigned long key_id = strtoul(fields[0].c_str(), &end, 10);
+    if (*end != '\0' || fields[0].empty()) {
+        return false;
+    }
+    auto key = keys.find(static_cast<uint32_t>(key_id));
+    if (key == keys.end()) {
+        return false;   // Unknown or retired key
+    }
+    
+    // Constant-time compare: no timing hint about how much of a forged MAC matched
+    std::string expected = hmac_hex(key->second, body);
+    if (mac.size() != expected.size() || CRYPTO_memcmp(mac.data(), expected.data(), mac.size()) != 0) {
+        return false;
+    }
+    
+    claims.key_id = static_cast<uint32_t>(key_id);
+    claims.user_id = atoi(fields[1].c_str());
+    claims.role = fields[2];
+    claims.expiry = static_cast<time_t>(strtoll(fields[3].c_str(), nullptr, 10));
+    if (now >= claims.expiry) {
+        return false;
+    }
+    
+    std::lock_guard<std::mutex> lock(revoked_mutex);
+    return revoked.empty() || revoked.find(mac) == revoked.end();
+}
+
+void TokenSigner::revoke(const std::string& token, time_t expiry) {
+    size_t mac_pos = token.rfind('.');
+    if (mac_pos == std::string::npos) {
+        return;
+    }
+    std::lock_guard<std::mutex> lock(revoked_mutex);
+    revoked[token.substr(mac_pos + 1)] = expiry;
+}
+
+size_t TokenSigner::purge_revoked(time_t now) {
+    std::lock_guard<std::mutex> lock(revoked_mutex);
+    size_t removed = 0;
+    for (auto it = revoked.begin(); it != revoked.end();) {
+        if (now >= it->second) {
+            it = revoked.erase(it);
+            removed++;
+        } else {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+size_t TokenSigner::revoked_count() {
+    std::lock_guard<std::mutex> lock(revoked_mutex);
+    return revoked.size();
+}
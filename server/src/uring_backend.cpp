@@ -0,0 +1,609 @@
+#include "../include/uring_backend.h"
+#include "../include/logger.h"
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <cstring>
+#include <algorithm>
+
+// Operation kind in the low 3 bits of user_data. Recv ops carry
+// (generation << 32 | fd << 3), send ops the InflightSend pointer.
+enum UringTag {
+    TAG_ACCEPT = 1,
+    TAG_WAKEUP = 2,
+    TAG_RECV = 3,
+    TAG_SEND = 4,
+    TAG_CANCEL = 5,
+    TAG_TIMER = 6
+};
+
+static const uint64_t TAG_MASK = 7;
+static const unsigned short BUF_GROUP = 0;
+
+static uint64_t recv_user_data(int fd, uint32_t generation) {
+    return ((uint64_t)generation << 32) | ((uint64_t)fd << 3) | TAG_RECV;
+}
+
+UringBackend::UringBackend()
+    : ring_fd(-1), listen_fd(-1), wakeup_fd(-1), timer_fd(-1), stats(nullptr),
+      sq_ring(MAP_FAILED), sq_ring_size(0), sq_head(nullptr), sq_tail(nullptr), sq_mask(nullptr),
+      sq_array(nullptr), sq_flags(nullptr), sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+      sqes_size(0), sq_entries(0), sq_local_tail(0), sq_unsubmitted(0),
+      cq_ring(MAP_FAILED), cq_ring_size(0), cq_head(nullptr), cq_tail(nullptr), cq_mask(nullptr),
+      cqes(nullptr), buf_ring(static_cast<struct io_uring_buf_ring*>(MAP_FAILED)), buffers(nullptr),
+      buf_tail(0), inflight(0), rearm_accept(false), rearm_wakeup(false), rearm_timer(false) {
+}
+
+UringBackend::~UringBackend() {
+    release();
+}
+
+bool UringBackend::drain() {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY;
+    sqe->user_data = TAG_CANCEL;
+    
+    std::vector<IoEvent> discarded;
+    while (inflight > 0) {
+        int ret = enter(sq_unsubmitted, 1);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            LOG_ERROR("io_uring_enter (drain) failed: " + std::string(strerror(errno)));
+            return false;
+        }
+        reap(discarded);
+        discarded.clear();
+    }
+    return true;
+}
+
+void UringBackend::release() {
+    // Until the last completion the kernel may still receive into the
+    // buffers and read the sends' iovecs: closing the ring alone does not
+    // wait for that. If draining fails they are leaked rather than freed.
+    bool drained = inflight == 0 || drain();
+    if (ring_fd >= 0) {
+        close(ring_fd);
+        ring_fd = -1;
+    }
+    
+    if (drained) {
+        conns.for_each([](int, UringConn& conn) {
+            delete conn.send;
+            conn.send = nullptr;
+        });
+        for (InflightSend* send : orphaned_sends) {
+            delete send;
+        }
+    }
+    conns.clear();
+    orphaned_sends.clear();
+    
+    if (buf_ring != MAP_FAILED) {
+        munmap(buf_ring, URING_BUF_COUNT * sizeof(struct io_uring_buf));
+        buf_ring = static_cast<struct io_uring_buf_ring*>(MAP_FAILED);
+    }
+    if (drained) {
+        delete[] buffers;
+    }
+    buffers = nullptr;
+    
+    if (sqes != MAP_FAILED) {
+        munmap(sqes, sqes_size);
+        sqes = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+    }
+    if (cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+        munmap(cq_ring, cq_ring_size);
+    }
+    cq_ring = MAP_FAILED;
+    if (sq_ring != MAP_FAILED) {
+        munmap(sq_ring, sq_ring_size);
+        sq_ring = MAP_FAILED;
+    }
+}
+
+bool UringBackend::init() {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_SUBMIT_ALL | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = URING_CQ_ENTRIES;
+    
+    ring_fd = syscall(__NR_io_uring_setup, URING_SQ_ENTRIES, &params);
+    if (ring_fd < 0) {
+        LOG_WARN("io_uring_setup failed: " + std::string(strerror(errno)));
+        return false;
+    }
+    if (!(params.features & IORING_FEAT_NODROP)) {
+        LOG_WARN("io_uring: kernel too old (no IORING_FEAT_NODROP)");
+        release();
+        return false;
+    }
+    
+    // Map the rings (one mapping serves both on current kernels)
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap && cq_ring_size > sq_ring_size) {
+        sq_ring_size = cq_ring_size;
+    }
+    
+    sq_ring = mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                   ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        LOG_WARN("io_uring: failed to map SQ ring");
+        release();
+        return false;
+    }
+    if (single_mmap) {
+        cq_ring = sq_ring;
+    } else {
+        cq_ring = mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            LOG_WARN("io_uring: failed to map CQ ring");
+            release();
+            return false;
+        }
+    }
+    
+    sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    void* sqe_area = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                          ring_fd, IORING_OFF_SQES);
+    if (sqe_area == MAP_FAILED) {
+        LOG_WARN("io_uring: failed to map SQEs");
+        release();
+        return false;
+    }
+    sqes = static_cast<struct io_uring_sqe*>(sqe_area);
+    
+    char* sq = static_cast<char*>(sq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_flags = reinterpret_cast<unsigned*>(sq + params.sq_off.flags);
+    sq_entries = params.sq_entries;
+    sq_local_tail = *sq_tail;
+    
+    char* cq = static_cast<char*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    
+    // Provided-buffer ring for multishot recv
+    void* ring_area = mmap(nullptr, URING_BUF_COUNT * sizeof(struct io_uring_buf), PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring_area == MAP_FAILED) {
+        LOG_WARN("io_uring: failed to allocate buffer ring");
+        release();
+        return false;
+    }
+    buf_ring = static_cast<struct io_uring_buf_ring*>(ring_area);
+    
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = reinterpret_cast<uint64_t>(buf_ring);
+    reg.ring_entries = URING_BUF_COUNT;
+    reg.bgid = BUF_GROUP;
+    if (syscall(__NR_io_uring_register, ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        LOG_WARN("io_uring: provided buffer rings unsupported: " + std::string(strerror(errno)));
+        release();
+        return false;
+    }
+    
+    buffers = new char[(size_t)URING_BUF_COUNT * URING_BUF_SIZE];
+    for (unsigned short bid = 0; bid < URING_BUF_COUNT; ++bid) {
+        used_buffers.push_back(bid);
+    }
+    recycle_buffers();
+    
+    LOG_INFO("io_uring initialized (" + std::to_string(params.sq_entries) + " SQ / " +
+             std::to_string(params.cq_entries) + " CQ entries, " + std::to_string(URING_BUF_COUNT) +
+             " x " + std::to_string(URING_BUF_SIZE) + " byte receive buffers)");
+    return true;
+}
+
+bool UringBackend::setup(int listen_socket, int wakeup_eventfd, int timerfd, IoStats* io_stats) {
+    listen_fd = listen_socket;
+    wakeup_fd = wakeup_eventfd;
+    timer_fd = timerfd;
+    stats = io_stats;
+    
+    arm_accept();
+    arm_wakeup();
+    arm_timer();
+    submit();
+    return true;
+}
+
+struct io_uring_sqe* UringBackend::get_sqe() {
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sq_local_tail - head >= sq_entries) {
+        // Ring full: hand what we have to the kernel first
+        submit();
+        head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    }
+    
+    unsigned index = sq_local_tail & *sq_mask;
+    struct io_uring_sqe* sqe = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sq_array[index] = index;
+    sq_local_tail++;
+    sq_unsubmitted++;
+    inflight++;
+    return sqe;
+}
+
+void UringBackend::reserve_sqes(unsigned count) {
+    unsigned head = __atomic_load_n(sq_head, __ATOMIC_ACQUIRE);
+    if (sq_local_tail - head + count > sq_entries) {
+        submit();
+    }
+}
+
+int UringBackend::enter(unsigned to_submit, unsigned min_complete) {
+    __atomic_store_n(sq_tail, sq_local_tail, __ATOMIC_RELEASE);
+    stats->wait_calls++;
+    int ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete,
+                      IORING_ENTER_GETEVENTS, nullptr, 0);
+    if (ret > 0) {
+        sq_unsubmitted -= std::min<unsigned>(ret, sq_unsubmitted);
+    }
+    return ret;
+}
+
+void UringBackend::submit() {
+    while (sq_unsubmitted > 0) {
+        int ret = enter(sq_unsubmitted, 0);
+        if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            LOG_ERROR("io_uring_enter (submit) failed: " + std::string(strerror(errno)));
+            return;
+        }
+        if (ret <= 0) {
+            return;     // Completion queue backed up: the next wait() reaps first
+        }
+    }
+}
+
+void UringBackend::arm_accept() {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = listen_fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = TAG_ACCEPT;
+}
+
+void UringBackend::arm_wakeup() {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = wakeup_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = TAG_WAKEUP;
+}
+
+void UringBackend::arm_timer() {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = timer_fd;
+    sqe->poll32_events = POLLIN;
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = TAG_TIMER;
+}
+
+void UringBackend::arm_recv(int fd, uint32_t generation) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = BUF_GROUP;
+    sqe->user_data = recv_user_data(fd, generation);
+}
+
+void UringBackend::cancel(uint64_t user_data) {
+    struct io_uring_sqe* sqe = get_sqe();
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_ALL;
+    sqe->user_data = TAG_CANCEL;
+}
+
+bool UringBackend::add_client(int fd) {
+    conns.insert(fd).recv_armed = true;
+    arm_recv(fd, conns.generation(fd));
+    return true;
+}
+
+void UringBackend::remove_client(int fd) {
+    UringConn* conn = conns.find(fd);
+    if (!conn) {
+        return;
+    }
+    
+    // Cancel by user_data (not by fd): the fd is closed right after this,
+    // before the cancel is submitted
+    cancel(recv_user_data(fd, conns.generation(fd)));
+    if (conn->send) {
+        conn->send->orphaned = true;
+        conn->send->orphan_index = orphaned_sends.size();
+        orphaned_sends.push_back(conn->send);
+        cancel(reinterpret_cast<uint64_t>(conn->send) | TAG_SEND);
+    }
+    conns.erase(fd);
+}
+
+void UringBackend::pause_recv(int fd) {
+    UringConn* conn = conns.find(fd);
+    if (!conn || conn->recv_paused) {
+        return;
+    }
+    
+    // Completions already posted still arrive; the cancelled recv's final
+    // one (-ECANCELED) is not a close
+    conn->recv_paused = true;
+    if (conn->recv_armed) {
+        cancel(recv_user_data(fd, conns.generation(fd)));
+    }
+}
+
+void UringBackend::resume_recv(int fd) {
+    UringConn* conn = conns.find(fd);
+    if (!conn || !conn->recv_paused) {
+        return;
+    }
+    
+    // A recv whose cancel has not completed yet is armed again by its
+    // final completion
+    conn->recv_paused = false;
+    if (!conn->recv_armed) {
+        rearm_recv.push_back(std::make_pair(fd, conns.generation(fd)));
+    }
+}
+
+void UringBackend::recycle_buffers() {
+    if (used_buffers.empty()) {
+        return;
+    }
+    
+    // Index the entries by hand: compiled as C++, the header's flexible
+    // bufs[] member lands at offset 8 instead of 0
+    struct io_uring_buf* entries = reinterpret_cast<struct io_uring_buf*>(buf_ring);
+    unsigned short mask = URING_BUF_COUNT - 1;
+    for (unsigned short bid : used_buffers) {
+        struct io_uring_buf* buf = &entries[buf_tail & mask];
+        buf->addr = reinterpret_cast<uint64_t>(buffers + (size_t)bid * URING_BUF_SIZE);
+        buf->len = URING_BUF_SIZE;
+        buf->bid = bid;
+        buf_tail++;
+    }
+    __atomic_store_n(&buf_ring->tail, buf_tail, __ATOMIC_RELEASE);
+    used_buffers.clear();
+}
+
+SendResult UringBackend::flush(int fd, OutputQueue& queue) {
+    UringConn* conn = conns.find(fd);
+    if (!conn) {
+        return SEND_ERROR;
+    }
+    if (conn->send) {
+        return SEND_PENDING;    // One chain at a time keeps the byte stream ordered
+    }
+    if (queue.empty()) {
+        return SEND_DONE;
+    }
+    
+    InflightSend* send = new InflightSend();
+    send->fd = fd;
+    send->generation = conns.generation(fd);
+    send->outstanding = 0;
+    send->written = 0;
+    send->failed = false;
+    send->orphaned = false;
+    
+    size_t frames = queue.snapshot(send->frames, URING_SEND_FRAMES * URING_SEND_LINKS);
+    size_t ops = (frames + URING_SEND_FRAMES - 1) / URING_SEND_FRAMES;
+    send->iov.resize(frames * 2);       // Never reallocated: msghdrs point into it
+    send->msgs.resize(ops);
+    
+    size_t iov_used = 0;
+    for (size_t op = 0; op < ops; ++op) {
+        size_t first = op * URING_SEND_FRAMES;
+        size_t count = std::min<size_t>(URING_SEND_FRAMES, frames - first);
+        size_t used = OutputQueue::gather(&send->frames[first], count, op == 0 ? queue.head_written() : 0,
+                                          &send->iov[iov_used], send->iov.size() - iov_used);
+        
+        struct msghdr& msg = send->msgs[op];
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &send->iov[iov_used];
+        msg.msg_iovlen = used;
+        iov_used += used;
+    }
+    
+    // A link chain must not be split across submissions
+    reserve_sqes(ops);
+    for (size_t op = 0; op < ops; ++op) {
+        struct io_uring_sqe* sqe = get_sqe();
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&send->msgs[op]);
+        sqe->len = 1;
+        // WAITALL: a short write fails the op, which cancels the rest of the
+        // chain instead of letting a later op write past the gap
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->user_data = reinterpret_cast<uint64_t>(send) | TAG_SEND;
+        if (op + 1 < ops) {
+            sqe->flags = IOSQE_IO_LINK;
+        }
+        send->outstanding++;
+    }
+    
+    conn->send = send;
+    return SEND_PENDING;
+}
+
+void UringBackend::handle_send_completion(InflightSend* send, int res, std::vector<IoEvent>& events) {
+    if (res >= 0) {
+        send->written += res;
+    } else if (res != -ECANCELED) {
+        send->failed = true;
+    }
+    
+    if (--send->outstanding > 0) {
+        return;
+    }
+    
+    if (!send->orphaned) {
+        UringConn* conn = conns.find(send->fd, send->generation);
+        if (conn) {
+            conn->send = nullptr;
+            stats->bytes_sent += send->written;
+            events.push_back(IoEvent{IO_SENT, send->fd, nullptr, send->written, send->failed});
+        }
+    } else {
+        InflightSend* moved = orphaned_sends.back();
+        orphaned_sends[send->orphan_index] = moved;
+        moved->orphan_index = send->orphan_index;
+        orphaned_sends.pop_back();
+    }
+    delete send;
+}
+
+void UringBackend::reap(std::vector<IoEvent>& events) {
+    unsigned head = *cq_head;
+    unsigned tail = __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    
+    while (head != tail) {
+        struct io_uring_cqe* cqe = &cqes[head & *cq_mask];
+        uint64_t user_data = cqe->user_data;
+        int res = cqe->res;
+        unsigned flags = cqe->flags;
+        head++;
+        
+        bool more = flags & IORING_CQE_F_MORE;
+        if (!more) {
+            inflight--;
+        }
+        switch (user_data & TAG_MASK) {
+            case TAG_ACCEPT:
+                events.push_back(IoEvent{IO_ACCEPTED, res, nullptr, 0, false});
+                if (!more) {
+                    rearm_accept = true;
+                }
+                break;
+                
+            case TAG_WAKEUP:
+                events.push_back(IoEvent{IO_WAKEUP, wakeup_fd, nullptr, 0, false});
+                if (!more) {
+                    rearm_wakeup = true;
+                }
+                break;
+                
+            case TAG_TIMER:
+                events.push_back(IoEvent{IO_TIMER, timer_fd, nullptr, 0, false});
+                if (!more) {
+                    rearm_timer = true;
+                }
+                break;
+                
+            case TAG_RECV: {
+                int fd = static_cast<int>((user_data & 0xffffffffULL) >> 3);
+                uint32_t generation = static_cast<uint32_t>(user_data >> 32);
+                UringConn* conn = conns.find(fd, generation);
+                bool live = conn != nullptr;
+                
+                if (flags & IORING_CQE_F_BUFFER) {
+                    unsigned short bid = flags >> IORING_CQE_BUFFER_SHIFT;
+                    used_buffers.push_back(bid);
+                    if (live && res > 0) {
+                        events.push_back(IoEvent{IO_DATA, fd, buffers + (size_t)bid * URING_BUF_SIZE,
+                                                 static_cast<size_t>(res), false});
+                    }
+                }
+                
+                if (live && !more) {
+                    conn->recv_armed = false;
+                    if (res > 0 || res == -ENOBUFS || res == -ECANCELED) {
+                        // Multishot stopped (buffers ran out, or paused): arm
+                        // again after recycling unless the input is still full
+                        if (!conn->recv_paused) {
+                            rearm_recv.push_back(std::make_pair(fd, generation));
+                        }
+                    } else {
+                        events.push_back(IoEvent{IO_CLOSED, fd, nullptr, 0, false});
+                    }
+                }
+                break;
+            }
+            
+            case TAG_SEND:
+                handle_send_completion(reinterpret_cast<InflightSend*>(user_data & ~TAG_MASK), res, events);
+                break;
+                
+            default:
+                break;  // TAG_CANCEL
+        }
+    }
+    
+    __atomic_store_n(cq_head, head, __ATOMIC_RELEASE);
+}
+
+bool UringBackend::wait(std::vector<IoEvent>& events, int timeout_ms) {
+    events.clear();
+    
+    // Buffers handed out by the previous wait() have been consumed by now
+    recycle_buffers();
+    
+    if (rearm_accept) {
+        rearm_accept = false;
+        arm_accept();
+    }
+    if (rearm_wakeup) {
+        rearm_wakeup = false;
+        arm_wakeup();
+    }
+    if (rearm_timer) {
+        rearm_timer = false;
+        arm_timer();
+    }
+    for (const auto& entry : rearm_recv) {
+        // Skip connections paused (or already armed) since they were listed
+        UringConn* conn = conns.find(entry.first, entry.second);
+        if (conn && !conn->recv_paused && !conn->recv_armed) {
+            conn->recv_armed = true;
+            arm_recv(entry.first, entry.second);
+        }
+    }
+    rearm_recv.clear();
+    
+    // Completions already posted: don't block
+    bool ready = *cq_head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE);
+    unsigned min_complete = (timeout_ms < 0 && !ready) ? 1 : 0;
+    
+    // Submit everything and wait, in one syscall
+    int ret = enter(sq_unsubmitted, min_complete);
+    if (ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        LOG_ERROR("io_uring_enter failed: " + std::string(strerror(errno)));
+        return false;
+    }
+    
+    reap(events);
+    
+    // Completions that did not fit in the CQ wait in the kernel's overflow list
+    while (__atomic_load_n(sq_flags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) {
+        if (enter(0, 0) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            break;
+        }
+        reap(events);
+        if (*cq_head == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+    }
+    return true;
+}
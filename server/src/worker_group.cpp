@@ -0,0 +1,114 @@
+#include "../include/worker_group.h"
+#include "../include/logger.h"
+
+WorkerGroup::WorkerGroup(int port, Database* database, int num_workers, int backlog, int pool_threads,
+                         IoBackendKind io_kind, int hash_threads) {
+    if (num_workers < 1) {
+        num_workers = 1;
+    }
+    
+    bool reuse_port = num_workers > 1;
+    for (int i = 0; i < num_workers; ++i) {
+        workers.emplace_back(new Server(port, database, i, reuse_port, backlog, io_kind));
+    }
+    
+    std::vector<Server*> all;
+    for (auto& worker : workers) {
+        all.push_back(worker.get());
+    }
+    for (auto& worker : workers) {
+        worker->set_peers(all);
+        worker->set_session_cache(&sessions);
+        worker->set_exam_engine(&exams);
+    }
+    
+    // Exam answers are written through until an AnswerWriter is set
+    exams.set_sink([database](int user_id, int room_id, int question_id, const std::string& selected_option) {
+        database->save_user_answer(user_id, room_id, question_id, selected_option);
+    });
+    
+    if (pool_threads > 0) {
+        pool.reset(new TaskPool(pool_threads));
+        for (auto& worker : workers) {
+            worker->set_task_pool(pool.get());
+        }
+    }
+    
+    if (hash_threads > 0) {
+        hash_pool.reset(new TaskPool(hash_threads));
+        for (auto& worker : workers) {
+            worker->set_hash_pool(hash_pool.get());
+        }
+    }
+}
+
+WorkerGroup::~WorkerGroup() {
+    stop();
+    for (auto& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    
+    // Finish in-flight handlers while their workers still exist
+    if (pool) {
+        pool->shutdown();
+    }
+    if (hash_pool) {
+        hash_pool->shutdown();
+    }
+}
+
+bool WorkerGroup::start() {
+    // Bind every listening socket before any loop runs, so a bind
+    // failure aborts startup instead of leaving a partial group
+    for (auto& worker : workers) {
+        if (!worker->setup()) {
+            return false;
+        }
+    }
+    
+    LOG_INFO("Starting " + std::to_string(workers.size()) + " worker(s)");
+    
+    for (size_t i = 1; i < workers.size(); ++i) {
+        Server* worker = workers[i].get();
+        threads.emplace_back([worker]() { worker->run(); });
+    }
+    
+    workers[0]->run();
+    
+    for (auto& thread : threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    threads.clear();
+    return true;
+}
+
+void WorkerGroup::stop() {
+    for (auto& worker : workers) {
+        worker->stop();
+    }
+}
+
+void WorkerGroup::set_token_signer(TokenSigner* signer) {
+    for (auto& worker : workers) {
+        worker->set_token_signer(signer);
+    }
+}
+
+void WorkerGroup::set_idle_timeout(int seconds) {
+    for (auto& worker : workers) {
+        worker->set_idle_timeout(seconds);
+    }
+}
+
+void WorkerGroup::set_answer_writer(AnswerWriter* writer) {
+    for (auto& worker : workers) {
+        worker->set_answer_writer(writer);
+    }
+    exams.set_sink([writer](int user_id, int room_id, int question_id, const std::string& selected_option) {
+        writer->enqueue(user_id, room_id, question_id, selected_option);
+    });
+}
@@ -0,0 +1,158 @@
+// Answer write path: one autocommit write per CHANGE_ANSWER click vs the
+// AnswerWriter group-commit queue, on a file-backed WAL database configured
+// like the server's. N client threads click answers as fast as they can
+// (each student cycles through the room's questions, changing its mind).
+//   direct - Database::save_user_answer per click, one transaction each
+//   batched - AnswerWriter::enqueue per click, one transaction per flush
+// Reported per mode: clicks/s, click p50/p99, transactions committed, rows
+// written; for batched also flush time and the deepest queue seen.
+//
+// Usage: bench_answer_writer [client threads] [seconds] [flush ms]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../server/include/answer_writer.h"
+#include "../server/include/database.h"
+#include "../server/include/logger.h"
+
+static const int STUDENTS = 500;
+static const int QUESTIONS = 20;
+
+typedef std::chrono::steady_clock Clock;
+
+static double percentile(std::vector<double>& values, int p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * p / 100)];
+}
+
+// One room with STUDENTS participants and up to QUESTIONS sample questions
+static bool populate(Database& db, int& room_id, std::vector<int>& user_ids, std::vector<int>& question_ids) {
+    for (int id = 1; id <= 1000 && (int)question_ids.size() < QUESTIONS; id++) {
+        Question question;
+        if (db.get_question_by_id(id, question)) {
+            question_ids.push_back(id);
+        }
+    }
+    if (question_ids.empty() || !db.create_test_room("answers", 1, QUESTIONS, 30, "{}", room_id)) {
+        return false;
+    }
+    for (int i = 0; i < STUDENTS; i++) {
+        std::string name = "answer_" + std::to_string(i);
+        User user;
+        if (!db.create_user(name, "x", "USER") || !db.get_user_by_username(name, user)) {
+            return false;
+        }
+        db.add_participant(room_id, user.user_id);
+        user_ids.push_back(user.user_id);
+    }
+    return true;
+}
+
+static void run(const char* name, bool batched, int client_threads, double seconds, int flush_ms) {
+    std::string path = "/tmp/bench_answer_writer_" + std::to_string(getpid()) + ".db";
+    {
+        Database db(path);
+        int room_id = 0;
+        std::vector<int> user_ids;
+        std::vector<int> question_ids;
+        if (!db.is_open() || !db.initialize()) {
+            std::cerr << name << ": database setup failed (run from tests/ so ../database/schema.sql is found)\n";
+            return;
+        }
+        DatabaseConfig config;
+        config.read_connections = 0;
+        if (!db.configure(config) || !populate(db, room_id, user_ids, question_ids)) {
+            std::cerr << name << ": setup failed\n";
+            return;
+        }
+        
+        std::unique_ptr<AnswerWriter> writer;
+        if (batched) {
+            writer.reset(new AnswerWriter(&db, flush_ms));
+        }
+        
+        std::atomic<bool> stop(false);
+        std::vector<std::vector<double>> latencies(client_threads);
+        std::atomic<uint64_t> direct_rows(0);
+        std::vector<std::thread> threads;
+        for (int t = 0; t < client_threads; t++) {
+            threads.emplace_back([&, t]() {
+                const char* options[] = {"a", "b", "c", "d"};
+                for (int i = t; !stop.load(std::memory_order_relaxed); i += client_threads) {
+                    int user_id = user_ids[i % STUDENTS];
+                    int question_id = question_ids[(i / STUDENTS) % question_ids.size()];
+                    const char* option = options[(i / 7) % 4];
+                    Clock::time_point start = Clock::now();
+                    if (writer) {
+                        writer->enqueue(user_id, room_id, question_id, option);
+                    } else if (db.save_user_answer(user_id, room_id, question_id, option)) {
+                        direct_rows++;
+                    }
+                    latencies[t].push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+                }
+            });
+        }
+        
+        usleep((useconds_t)(seconds * 1e6));
+        stop = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        
+        // Submit: everything clicked is stored before the numbers are read
+        Clock::time_point flush_start = Clock::now();
+        if (writer) {
+            writer->flush();
+        }
+        double final_flush_ms = std::chrono::duration<double, std::milli>(Clock::now() - flush_start).count();
+        
+        std::vector<double> clicks;
+        for (auto& thread_latencies : latencies) {
+            clicks.insert(clicks.end(), thread_latencies.begin(), thread_latencies.end());
+        }
+        
+        char line[256];
+        snprintf(line, sizeof(line), "  %-8s %10.0f clicks/s  p50 %7.2f us  p99 %8.2f us\n",
+                 name, clicks.size() / seconds, percentile(clicks, 50), percentile(clicks, 99));
+        std::cout << line;
+        if (writer) {
+            AnswerWriterStats stats = writer->get_stats();
+            snprintf(line, sizeof(line),
+                     "           %llu transactions, %llu rows (%llu clicks coalesced), flush max %.2f ms, "
+                     "final flush %.2f ms, max queue depth %zu\n",
+                     (unsigned long long)stats.flushes, (unsigned long long)stats.rows_written,
+                     (unsigned long long)stats.coalesced, stats.max_flush_ms, final_flush_ms, stats.max_queue_depth);
+        } else {
+            snprintf(line, sizeof(line), "           %llu transactions, %llu rows\n",
+                     (unsigned long long)direct_rows.load(), (unsigned long long)direct_rows.load());
+        }
+        std::cout << line;
+    }
+    unlink(path.c_str());
+    unlink((path + "-wal").c_str());
+    unlink((path + "-shm").c_str());
+}
+
+int main(int argc, char** argv) {
+    int client_threads = argc > 1 ? atoi(argv[1]) : 4;
+    double seconds = argc > 2 ? atof(argv[2]) : 3.0;
+    int flush_ms = argc > 3 ? atoi(argv[3]) : DEFAULT_ANSWER_FLUSH_MS;
+    Logger::get_instance()->set_min_level(ERROR);
+    
+    std::cout << "Answer clicks: " << client_threads << " client threads, " << seconds << " s, "
+              << STUDENTS << " students x " << QUESTIONS << " questions, flush every " << flush_ms << " ms\n";
+    run("direct", false, client_threads, seconds, flush_ms);
+    run("batched", true, client_threads, seconds, flush_ms);
+    return 0;
+}
@@ -0,0 +1,71 @@
+// Room broadcast fan-out benchmark: S2C_TEST_STARTED carrying a whole
+// exam, queued to every member of a large room.
+//   per-member  - payload.dump() for each member (old broadcast_to_room)
+//   shared      - serialized once, every queue references the same buffer
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include "../server/include/protocol.h"
+#include "../server/include/logger.h"
+
+static const int MEMBERS = 1000;
+static const int QUESTIONS = 50;
+static const int ROUNDS = 5;
+
+static json make_exam_payload() {
+    json payload;
+    payload["room_id"] = 42;
+    payload["duration_minutes"] = 45;
+    payload["questions"] = json::array();
+    for (int i = 0; i < QUESTIONS; i++) {
+        json q;
+        q["q_id"] = 1000 + i;
+        q["content"] = "Question " + std::to_string(i) + ": which of the following statements about TCP is correct?";
+        q["option_a"] = "It guarantees ordered delivery of bytes";
+        q["option_b"] = "It preserves message boundaries";
+        q["option_c"] = "It is connectionless";
+        q["option_d"] = "It never retransmits";
+        payload["questions"].push_back(q);
+    }
+    return payload;
+}
+
+int main() {
+    Logger::get_instance()->set_min_level(ERROR);
+    
+    json payload = make_exam_payload();
+    size_t payload_size = payload.dump().size();
+    std::cout << "Fan-out: " << MEMBERS << " members, " << QUESTIONS << " questions ("
+              << payload_size << " bytes payload), " << ROUNDS << " rounds\n";
+    
+    double per_member_ms = 0;
+    double shared_ms = 0;
+    size_t per_member_bytes = 0;
+    size_t shared_bytes = 0;
+    
+    for (int r = 0; r < ROUNDS; r++) {
+        {
+            std::vector<OutputQueue> queues(MEMBERS);
+            auto start = std::chrono::steady_clock::now();
+            for (auto& queue : queues) {
+                queue.push(1101, payload.dump());
+            }
+            per_member_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            per_member_bytes = (size_t)MEMBERS * payload_size;
+        }
+        {
+            std::vector<OutputQueue> queues(MEMBERS);
+            auto start = std::chrono::steady_clock::now();
+            SharedPayload serialized = Protocol::serialize(payload);
+            for (auto& queue : queues) {
+                queue.push(1101, serialized);
+            }
+            shared_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            shared_bytes = payload_size;
+        }
+    }
+    
+    printf("  per-member  %8.3f ms/broadcast  %9zu payload bytes allocated\n", per_member_ms / ROUNDS, per_member_bytes);
+    printf("  shared      %8.3f ms/broadcast  %9zu payload bytes allocated\n", shared_ms / ROUNDS, shared_bytes);
+    return 0;
+}
@@ -0,0 +1,161 @@
+// Mixed database load: read-heavy opcodes running next to answer writes.
+// Reader threads loop over the queries behind GET_HISTORY, LIST_ROOMS and
+// VIEW_ROOM_RESULTS while one writer thread saves answers (as CHANGE_ANSWER
+// does), on a file-backed database in two configurations:
+//   journal - rollback journal, one connection: readers and writer serialize
+//   wal     - WAL, one writer + one read-only connection per reader thread
+// Reported per configuration: reads/s and writes/s with p50/p99 latency.
+//
+// Usage: bench_db_mixed [reader threads] [seconds]
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "../server/include/database.h"
+#include "../server/include/logger.h"
+
+static const int USERS = 200;
+static const int ROOMS = 50;
+
+typedef std::chrono::steady_clock Clock;
+
+struct Latencies {
+    std::vector<double> us;
+    
+    double percentile(int p) {
+        if (us.empty()) {
+            return 0;
+        }
+        std::sort(us.begin(), us.end());
+        return us[std::min(us.size() - 1, us.size() * p / 100)];
+    }
+};
+
+// Rooms, users, participants and one finished result per participant
+static bool populate(Database& db, std::vector<int>& user_ids, std::vector<int>& room_ids, int& question_id) {
+    Question question;
+    if (!db.get_question_by_id(1, question)) {
+        return false;
+    }
+    question_id = question.question_id;
+    
+    for (int i = 0; i < USERS; i++) {
+        std::string name = "mixed_" + std::to_string(i);
+        User user;
+        if (!db.create_user(name, "x", "USER") || !db.get_user_by_username(name, user)) {
+            return false;
+        }
+        user_ids.push_back(user.user_id);
+    }
+    for (int r = 0; r < ROOMS; r++) {
+        int room_id = 0;
+        if (!db.create_test_room("room " + std::to_string(r), user_ids[0], 10, 30, "{}", room_id)) {
+            return false;
+        }
+        for (int i = r % 4; i < USERS; i += 4) {
+            db.add_participant(room_id, user_ids[i]);
+            db.update_participant_score(room_id, user_ids[i], i % 10);
+        }
+        db.update_room_status(room_id, "FINISHED");
+        room_ids.push_back(room_id);
+    }
+    return true;
+}
+
+static void run(const char* name, bool wal, int reader_threads, double seconds) {
+    std::string path = "/tmp/bench_db_mixed_" + std::to_string(getpid()) + ".db";
+    {
+        Database db(path);
+        std::vector<int> user_ids;
+        std::vector<int> room_ids;
+        int question_id = 0;
+        if (!db.is_open() || !db.initialize()) {
+            std::cerr << name << ": database setup failed (run from tests/ so ../database/schema.sql is found)\n";
+            return;
+        }
+        
+        DatabaseConfig config;
+        config.wal = wal;
+        config.read_connections = wal ? reader_threads : 0;
+        if (!db.configure(config) || !populate(db, user_ids, room_ids, question_id)) {
+            std::cerr << name << ": setup failed\n";
+            return;
+        }
+        
+        std::atomic<bool> stop(false);
+        std::vector<Latencies> read_latencies(reader_threads);
+        Latencies write_latencies;
+        
+        std::vector<std::thread> threads;
+        for (int t = 0; t < reader_threads; t++) {
+            threads.emplace_back([&, t]() {
+                Latencies& latencies = read_latencies[t];
+                for (int i = t; !stop.load(std::memory_order_relaxed); i++) {
+                    Clock::time_point start = Clock::now();
+                    switch (i % 3) {
+                        case 0:
+                            db.get_user_practice_history(user_ids[i % USERS]);
+                            db.get_user_test_history(user_ids[i % USERS]);
+                            break;
+                        case 1:
+                            db.get_all_rooms();
+                            break;
+                        default:
+                            db.get_room_results(room_ids[i % ROOMS]);
+                            break;
+                    }
+                    latencies.us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+                }
+            });
+        }
+        threads.emplace_back([&]() {
+            const char* options[] = {"a", "b", "c", "d"};
+            for (int i = 0; !stop.load(std::memory_order_relaxed); i++) {
+                Clock::time_point start = Clock::now();
+                db.save_user_answer(user_ids[i % USERS], room_ids[(i / USERS) % ROOMS], question_id, options[i % 4]);
+                write_latencies.us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+            }
+        });
+        
+        usleep((useconds_t)(seconds * 1e6));
+        stop = true;
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        
+        Latencies reads;
+        for (Latencies& latencies : read_latencies) {
+            reads.us.insert(reads.us.end(), latencies.us.begin(), latencies.us.end());
+        }
+        size_t read_count = reads.us.size();
+        size_t write_count = write_latencies.us.size();
+        
+        char line[256];
+        snprintf(line, sizeof(line),
+                 "  %-8s reads %9.0f/s  p50 %8.1f us  p99 %9.1f us   writes %7.0f/s  p50 %8.1f us  p99 %9.1f us\n",
+                 name, read_count / seconds, reads.percentile(50), reads.percentile(99),
+                 write_count / seconds, write_latencies.percentile(50), write_latencies.percentile(99));
+        std::cout << line;
+    }
+    unlink(path.c_str());
+    unlink((path + "-wal").c_str());
+    unlink((path + "-shm").c_str());
+}
+
+int main(int argc, char** argv) {
+    int reader_threads = argc > 1 ? atoi(argv[1]) : 4;
+    double seconds = argc > 2 ? atof(argv[2]) : 3.0;
+    Logger::get_instance()->set_min_level(ERROR);
+    
+    std::cout << "Mixed load: " << reader_threads << " reader threads + 1 writer, " << seconds << " s, "
+              << USERS << " users, " << ROOMS << " rooms\n";
+    run("journal", false, reader_threads, seconds);
+    run("wal", true, reader_threads, seconds);
+    return 0;
+}
@@ -0,0 +1,181 @@
+// CHANGE_ANSWER cost on one core for a room of P participants x Q questions
+// (random participant, question and option per change):
+//   database check - is_user_in_room query + AnswerWriter enqueue (what the
+//                    handler did before the exam engine)
+//   exam engine    - ExamEngine::change_answer, sink = AnswerWriter enqueue
+//   in memory only - ExamEngine::change_answer with no sink
+// Then the end of the exam: grading the in-memory sheets, as finish_exam does.
+// The room lives in a file-backed WAL database; the writer flushes every 50 ms.
+//
+// Usage: bench_exam_engine [participants] [questions] [changes]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include <unistd.h>
+#include "../server/include/answer_writer.h"
+#include "../server/include/database.h"
+#include "../server/include/exam_engine.h"
+#include "../server/include/logger.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Room 1 with its questions and participants (generated in one transaction)
+static bool fill_room(const std::string& path, int participants, int questions) {
+    sqlite3* handle = nullptr;
+    if (sqlite3_open(path.c_str(), &handle) != SQLITE_OK) {
+        return false;
+    }
+    std::string sql =
+        "BEGIN;"
+        "DELETE FROM TestRooms;"
+        "INSERT INTO TestRooms (room_id, name, creator_id, status, num_questions, duration_minutes) "
+        "VALUES (1, 'bench', 1, 'ONGOING', " + std::to_string(questions) + ", 30);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " +
+        std::to_string(questions) + ") "
+        "INSERT INTO Questions (question_id, content, options, correct_option, difficulty, topic, created_by) "
+        "SELECT 100000 + i, 'Bench question ' || i, '{}', char(97 + i % 4), 'easy', 'bench', 1 FROM n;"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " +
+        std::to_string(participants) + ") "
+        "INSERT INTO Users (user_id, username, hashed_password, role) "
+        "SELECT 100000 + i, 'bench_user' || i, 'x', 'USER' FROM n;"
+        "INSERT INTO RoomParticipants (room_id, user_id) SELECT 1, user_id FROM Users WHERE user_id > 100000;"
+        "COMMIT;";
+    char* error = nullptr;
+    bool ok = sqlite3_exec(handle, sql.c_str(), nullptr, nullptr, &error) == SQLITE_OK;
+    if (!ok) {
+        std::cerr << "fill failed: " << (error ? error : "") << "\n";
+        sqlite3_free(error);
+    }
+    sqlite3_close(handle);
+    return ok;
+}
+
+struct Change {
+    int user_id;
+    int question_id;
+    const char* option;
+};
+
+static void report(const char* name, size_t changes, double ms, double baseline_ms) {
+    char line[160];
+    snprintf(line, sizeof(line), "  %-15s %10.0f changes/s  %7.3f us/change  (%5.1fx)\n", name, changes / ms * 1000,
+             ms * 1000 / changes, baseline_ms / ms);
+    std::cout << line;
+}
+
+int main(int argc, char** argv) {
+    int participants = argc > 1 ? atoi(argv[1]) : 5000;
+    int questions = argc > 2 ? atoi(argv[2]) : 100;
+    size_t count = argc > 3 ? atoi(argv[3]) : 1000000;
+    Logger::get_instance()->set_min_level(ERROR);
+    
+    std::string path = "/tmp/bench_exam_engine_" + std::to_string(getpid()) + ".db";
+    {
+        Database setup(path);
+        if (!setup.is_open() || !setup.initialize()) {
+            std::cerr << "database setup failed (run from tests/ so ../database/schema.sql is found)\n";
+            return 1;
+        }
+    }
+    if (!fill_room(path, participants, questions)) {
+        unlink(path.c_str());
+        return 1;
+    }
+    
+    std::vector<int> user_ids;
+    std::vector<int> question_ids;
+    for (int i = 1; i <= participants; i++) {
+        user_ids.push_back(100000 + i);
+    }
+    for (int i = 1; i <= questions; i++) {
+        question_ids.push_back(100000 + i);
+    }
+    const char* options[] = {"option_a", "option_b", "option_c", "option_d"};
+    std::mt19937 rng(7);
+    std::vector<Change> changes(count);
+    for (Change& change : changes) {
+        change = {user_ids[rng() % user_ids.size()], question_ids[rng() % question_ids.size()], options[rng() % 4]};
+    }
+    
+    int status = 0;
+    {
+        Database db(path);
+        if (!db.initialize() || !db.configure(DatabaseConfig())) {
+            std::cerr << "database reopen failed\n";
+            return 1;
+        }
+        AnswerWriter writer(&db, 50, DEFAULT_ANSWER_FLUSH_ROWS);
+        
+        std::cout << "Room: " << participants << " participants x " << questions << " questions, " << count
+                  << " changes on one thread\n";
+        
+        // Checked against the database, a bounded share of the changes (it is slow)
+        size_t checked = std::min<size_t>(count, 100000);
+        Clock::time_point start = Clock::now();
+        for (size_t i = 0; i < checked; i++) {
+            const Change& change = changes[i];
+            if (db.is_user_in_room(1, change.user_id)) {
+                writer.enqueue(change.user_id, 1, change.question_id, change.option);
+            }
+        }
+        double db_ms = elapsed_ms(start) * count / checked;
+        writer.flush();
+        report("database check", count, db_ms, db_ms);
+        
+        ExamEngine engine;
+        engine.set_sink([&writer](int user_id, int room_id, int question_id, const std::string& option) {
+            writer.enqueue(user_id, room_id, question_id, option);
+        });
+        engine.start(1, question_ids, user_ids, time(nullptr) + 1800);
+        start = Clock::now();
+        size_t rejected = 0;
+        for (const Change& change : changes) {
+            rejected += engine.change_answer(1, change.user_id, change.question_id, change.option) != ExamChange::OK;
+        }
+        double engine_ms = elapsed_ms(start);
+        writer.flush();
+        report("exam engine", count, engine_ms, db_ms);
+        
+        ExamEngine memory_only;
+        memory_only.start(1, question_ids, user_ids, time(nullptr) + 1800);
+        start = Clock::now();
+        for (const Change& change : changes) {
+            rejected += memory_only.change_answer(1, change.user_id, change.question_id, change.option) !=
+                        ExamChange::OK;
+        }
+        report("in memory only", count, elapsed_ms(start), db_ms);
+        
+        // End of the exam
+        std::shared_ptr<ExamRoom> room = memory_only.finish(1);
+        std::vector<uint8_t> key(question_ids.size());
+        for (size_t q = 0; q < key.size(); q++) {
+            key[q] = static_cast<uint8_t>(q % 4);
+        }
+        start = Clock::now();
+        SheetGrades grades;
+        Grader::grade_sheets(room->sheets, key.data(), grades);
+        std::cout << "  grading the room " << elapsed_ms(start) << " ms (" << Grader::kernel_name(GradeKernel::AUTO)
+                  << ")\n";
+        
+        AnswerWriterStats stats = writer.get_stats();
+        std::cout << "  writer: " << stats.enqueued << " enqueued, " << stats.rows_written << " rows in "
+                  << stats.flushes << " flushes\n";
+        if (rejected || stats.failed_rows) {
+            std::cout << "  " << rejected << " changes rejected, " << stats.failed_rows << " rows failed!\n";
+            status = 1;
+        }
+    }
+    unlink(path.c_str());
+    unlink((path + "-wal").c_str());
+    unlink((path + "-shm").c_str());
+    return status;
+}
@@ -0,0 +1,71 @@
+// Connection lookup benchmark: the per-event fd -> connection state lookup
+// done by the epoll loop, at 10k and 50k open connections.
+//   std::map  - red-black tree keyed by fd (old Server::clients)
+//   FdSlab    - dense table indexed directly by fd
+// Events arrive in arbitrary fd order, so lookups use a shuffled fd list.
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "../server/include/fd_slab.h"
+
+static const int LOOKUPS = 2000000;
+static const int FIRST_FD = 5;   // After stdio, listening socket, epoll and eventfd
+
+// Roughly the size of ClientInfo, so cache behaviour is comparable
+struct Conn {
+    int sockfd = -1;
+    int user_id = -1;
+    std::string session_token;
+    std::string username;
+    char state[160] = {0};
+    bool closing = false;
+};
+
+template <typename Lookup>
+static double time_lookups(const std::vector<int>& order, Lookup lookup, long& checksum) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        checksum += lookup(order[i % order.size()]);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / LOOKUPS;
+}
+
+static void run(int connections) {
+    std::map<int, Conn> tree;
+    FdSlab<Conn> slab;
+    std::vector<int> order;
+    for (int fd = FIRST_FD; fd < FIRST_FD + connections; fd++) {
+        tree[fd].sockfd = fd;
+        slab.insert(fd).sockfd = fd;
+        order.push_back(fd);
+    }
+    std::mt19937 rng(42);
+    std::shuffle(order.begin(), order.end(), rng);
+    
+    long checksum = 0;
+    double map_ns = time_lookups(order, [&](int fd) {
+        auto it = tree.find(fd);
+        return it == tree.end() || it->second.closing ? 0 : it->second.sockfd;
+    }, checksum);
+    double slab_ns = time_lookups(order, [&](int fd) {
+        Conn* conn = slab.find(fd);
+        return !conn || conn->closing ? 0 : conn->sockfd;
+    }, checksum);
+    
+    std::cout << connections << " connections:\n";
+    std::cout << "  std::map  " << map_ns << " ns/lookup\n";
+    std::cout << "  FdSlab    " << slab_ns << " ns/lookup (" << map_ns / slab_ns << "x faster)\n";
+    std::cout << "  (checksum " << checksum << ")\n";
+}
+
+int main() {
+    std::cout << "Lookups per run: " << LOOKUPS << "\n";
+    run(10000);
+    run(50000);
+    return 0;
+}
@@ -0,0 +1,223 @@
+// Whole-room grading at the end of an exam.
+//   kernels  - Grader::grade_sheets on a 10k x 100 answer matrix with the
+//              scalar, SSE2 and AVX2 kernels (scores + correctness bitmaps)
+//   database - a file-backed room of P participants x 100 answers graded
+//              one row at a time (update_answer_correctness per answer,
+//              get_user_score + update_participant_score per participant)
+//              vs the end of a live exam: the sheets already in memory (as
+//              the ExamEngine holds them), Grader::grade_sheets and
+//              Database::finish_room (one transaction)
+//
+// Usage: bench_grade_sheets [sheets] [questions] [room participants]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include <unistd.h>
+#include "../server/include/database.h"
+#include "../server/include/grader.h"
+#include "../server/include/logger.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_ms(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void bench_kernels(size_t participants, size_t questions) {
+    std::mt19937 rng(42);
+    AnswerSheets sheets;
+    sheets.reset(participants, questions);
+    std::vector<uint8_t> key(questions);
+    for (size_t q = 0; q < questions; q++) {
+        key[q] = static_cast<uint8_t>(rng() % 4);
+    }
+    for (size_t p = 0; p < participants; p++) {
+        for (size_t q = 0; q < questions; q++) {
+            uint32_t value = rng() % 5;
+            sheets.set(p, q, value == 4 ? OPTION_NONE : static_cast<uint8_t>(value));
+        }
+    }
+    
+    std::cout << "Sheets: " << participants << " x " << questions << " questions\n";
+    SheetGrades reference;
+    Grader::grade_sheets(sheets, key.data(), reference, GradeKernel::SCALAR);
+    GradeKernel kernels[] = {GradeKernel::SCALAR, GradeKernel::SSE2, GradeKernel::AVX2};
+    double scalar_ms = 0;
+    for (GradeKernel kernel : kernels) {
+        if (!Grader::kernel_supported(kernel)) {
+            std::cout << "  " << Grader::kernel_name(kernel) << " not supported on this CPU\n";
+            continue;
+        }
+        const int runs = 50;
+        SheetGrades grades;
+        Clock::time_point start = Clock::now();
+        for (int run = 0; run < runs; run++) {
+            Grader::grade_sheets(sheets, key.data(), grades, kernel);
+        }
+        double ms = elapsed_ms(start) / runs;
+        if (kernel == GradeKernel::SCALAR) {
+            scalar_ms = ms;
+        }
+        char line[160];
+        snprintf(line, sizeof(line), "  %-7s %8.3f ms/room  (%5.1fx scalar)%s\n", Grader::kernel_name(kernel), ms,
+                 scalar_ms / ms, grades.bitmaps == reference.bitmaps ? "" : "  RESULTS DIFFER!");
+        std::cout << line;
+    }
+}
+
+// Room 1 questions, participants and answers (generated in one transaction)
+static bool fill_room(const std::string& path, int participants, int questions) {
+    sqlite3* handle = nullptr;
+    if (sqlite3_open(path.c_str(), &handle) != SQLITE_OK) {
+        return false;
+    }
+    std::string p = std::to_string(participants);
+    std::string q = std::to_string(questions);
+    std::string sql =
+        "BEGIN;"
+        "DELETE FROM TestRooms;"
+        "INSERT INTO TestRooms (room_id, name, creator_id, num_questions, duration_minutes) "
+        "VALUES (1, 'bench', 1, " + q + ", 30);"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " + q + ") "
+        "INSERT INTO Questions (question_id, content, options, correct_option, difficulty, topic, created_by) "
+        "SELECT 100000 + i, 'Bench question ' || i, '{\"a\":\"1\",\"b\":\"2\",\"c\":\"3\",\"d\":\"4\"}', "
+        "char(97 + i % 4), 'easy', 'bench', 1 FROM n;"
+        "INSERT INTO TestRoomQuestions (room_id, question_id, question_order) "
+        "SELECT 1, question_id, question_id FROM Questions WHERE question_id > 100000;"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " + p + ") "
+        "INSERT INTO Users (user_id, username, hashed_password, role) "
+        "SELECT 100000 + i, 'bench_user' || i, 'x', 'USER' FROM n;"
+        "INSERT INTO RoomParticipants (room_id, user_id) SELECT 1, user_id FROM Users WHERE user_id > 100000;"
+        "INSERT INTO UserTestAnswers (user_id, room_id, question_id, selected_option) "
+        "SELECT u.user_id, 1, q.question_id, 'option_' || char(97 + (u.user_id * 7 + q.question_id * 3) % 4) "
+        "FROM Users u, Questions q WHERE u.user_id > 100000 AND q.question_id > 100000;"
+        "COMMIT;";
+    char* error = nullptr;
+    bool ok = sqlite3_exec(handle, sql.c_str(), nullptr, nullptr, &error) == SQLITE_OK;
+    if (!ok) {
+        std::cerr << "fill failed: " << (error ? error : "") << "\n";
+        sqlite3_free(error);
+    }
+    sqlite3_close(handle);
+    return ok;
+}
+
+// Answers of room 1 as (user, question, encoded option)
+struct StoredAnswer {
+    int user_id;
+    int question_id;
+    uint8_t option;
+};
+
+static std::vector<StoredAnswer> read_answers(const std::string& path) {
+    std::vector<StoredAnswer> answers;
+    sqlite3* handle = nullptr;
+    sqlite3_open_v2(path.c_str(), &handle, SQLITE_OPEN_READONLY, nullptr);
+    sqlite3_stmt* stmt = nullptr;
+    sqlite3_prepare_v2(handle, "SELECT user_id, question_id, selected_option FROM UserTestAnswers WHERE room_id = 1;",
+                       -1, &stmt, nullptr);
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        answers.push_back({sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1),
+                           Grader::encode_option(reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)))});
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(handle);
+    return answers;
+}
+
+static int bench_database(int participants, int questions) {
+    std::string path = "/tmp/bench_grade_sheets_" + std::to_string(getpid()) + ".db";
+    {
+        Database setup(path);
+        if (!setup.is_open() || !setup.initialize()) {
+            std::cerr << "database setup failed (run from tests/ so ../database/schema.sql is found)\n";
+            return 1;
+        }
+    }
+    if (!fill_room(path, participants, questions)) {
+        unlink(path.c_str());
+        return 1;
+    }
+    std::vector<StoredAnswer> answers = read_answers(path);
+    
+    int status = 0;
+    {
+        Database db(path);
+        if (!db.initialize()) {
+            std::cerr << "database reopen failed\n";
+            return 1;
+        }
+        db.configure(DatabaseConfig());     // WAL + synchronous=NORMAL, as the server runs
+        
+        // One row at a time
+        Clock::time_point start = Clock::now();
+        for (const StoredAnswer& answer : answers) {
+            std::vector<uint8_t> key;
+            db.get_answer_key({answer.question_id}, key);
+            db.update_answer_correctness(answer.user_id, 1, answer.question_id,
+                                         Grader::grade(&answer.option, key.data(), 1) == 1);
+        }
+        long row_total = 0;
+        for (int i = 1; i <= participants; i++) {
+            int score = db.get_user_score(100000 + i, 1);
+            db.update_participant_score(1, 100000 + i, score);
+            row_total += score;
+        }
+        double row_ms = elapsed_ms(start);
+        
+        // The sheets as the exam engine holds them
+        std::vector<int> user_ids;
+        std::vector<int> question_ids;
+        for (int i = 1; i <= participants; i++) {
+            user_ids.push_back(100000 + i);
+        }
+        for (int i = 1; i <= questions; i++) {
+            question_ids.push_back(100000 + i);
+        }
+        AnswerSheets sheets;
+        sheets.reset(user_ids.size(), question_ids.size());
+        for (const StoredAnswer& answer : answers) {
+            sheets.set(answer.user_id - 100001, answer.question_id - 100001, answer.option);
+        }
+        
+        start = Clock::now();
+        std::vector<uint8_t> key;
+        db.get_answer_key(question_ids, key);
+        SheetGrades grades;
+        Grader::grade_sheets(sheets, key.data(), grades);
+        bool graded = db.finish_room(1, user_ids, question_ids, grades);
+        double room_ms = elapsed_ms(start);
+        long room_total = 0;
+        for (uint32_t score : grades.scores) {
+            room_total += score;
+        }
+        
+        std::cout << "Room: " << participants << " participants x " << questions << " questions ("
+                  << answers.size() << " answers, file-backed WAL)\n";
+        std::cout << "  one row at a time   " << row_ms << " ms\n";
+        std::cout << "  finish_room         " << room_ms << " ms (" << row_ms / room_ms << "x faster)\n";
+        if (!graded || room_total != row_total) {
+            std::cout << "  scores differ!\n";
+            status = 1;
+        }
+    }
+    unlink(path.c_str());
+    unlink((path + "-wal").c_str());
+    unlink((path + "-shm").c_str());
+    return status;
+}
+
+int main(int argc, char** argv) {
+    size_t sheets = argc > 1 ? atoi(argv[1]) : 10000;
+    size_t questions = argc > 2 ? atoi(argv[2]) : 100;
+    int participants = argc > 3 ? atoi(argv[3]) : 1000;
+    Logger::get_instance()->set_min_level(ERROR);
+    
+    bench_kernels(sheets, questions);
+    return bench_database(participants, static_cast<int>(questions));
+}
@@ -0,0 +1,111 @@
+// Grading one PRACTICE_SUBMIT of N answers, as handle_practice_submit does:
+//   per-answer lookup - get_question_by_id + "option_" + correct_option string
+//                       compare for each answer (the old loop), with the
+//                       question cache off (a query per answer) and on
+//   answer key        - encode the answers, one AnswerKeyTable lookup for
+//                       the whole submission, Grader::grade over both arrays
+// The database is in memory, so the per-answer numbers are CPU only.
+//
+// Usage: bench_grading [answers per submission]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../server/include/database.h"
+#include "../server/include/grader.h"
+#include "../server/include/logger.h"
+
+static const int SUBMISSIONS = 5000;
+
+template <typename Grade>
+static double time_submissions(Grade grade, long& correct) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < SUBMISSIONS; i++) {
+        correct += grade();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / SUBMISSIONS;
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 200;
+    Logger::get_instance()->set_min_level(ERROR);
+    
+    Database db(":memory:");
+    if (!db.is_open() || !db.initialize()) {
+        std::cerr << "database setup failed (run from tests/ so ../database/schema.sql is found)\n";
+        return 1;
+    }
+    
+    // One question per answer (teacher = user 1 from the sample data)
+    const char* letters[] = {"a", "b", "c", "d"};
+    json options = {{"a", "1"}, {"b", "2"}, {"c", "3"}, {"d", "4"}};
+    json answers = json::array();
+    for (int i = 0; i < count; i++) {
+        int question_id = 0;
+        if (!db.create_question("Bench question " + std::to_string(i), options, letters[i % 4], "easy", "bench", 1,
+                                question_id)) {
+            std::cerr << "create_question failed\n";
+            return 1;
+        }
+        // Three answers in four right
+        const char* selected = letters[(i % 4 == 3 ? i + 1 : i) % 4];
+        answers.push_back({{"q_id", question_id}, {"selected_option", std::string("option_") + selected}});
+    }
+    
+    auto per_answer = [&]() {
+        int correct_count = 0;
+        for (const auto& answer : answers) {
+            int q_id = answer["q_id"];
+            std::string selected = answer["selected_option"];
+            Question question;
+            if (db.get_question_by_id(q_id, question)) {
+                if (selected == "option_" + question.correct_option) {
+                    correct_count++;
+                }
+            }
+        }
+        return correct_count;
+    };
+    
+    auto answer_key = [&]() {
+        std::vector<int> question_ids;
+        std::vector<uint8_t> selected;
+        question_ids.reserve(answers.size());
+        selected.reserve(answers.size());
+        for (const auto& answer : answers) {
+            question_ids.push_back(answer["q_id"]);
+            selected.push_back(Grader::encode_option(answer["selected_option"]));
+        }
+        std::vector<uint8_t> key;
+        db.get_answer_key(question_ids, key);
+        return static_cast<int>(Grader::grade(selected.data(), key.data(), selected.size()));
+    };
+    
+    DatabaseConfig config;
+    config.question_cache_size = 0;
+    db.configure(config);
+    long query_correct = 0;
+    double query_ns = time_submissions(per_answer, query_correct);
+    
+    config.question_cache_size = DEFAULT_QUESTION_CACHE_SIZE;
+    db.configure(config);
+    long cached_correct = 0;
+    double cached_ns = time_submissions(per_answer, cached_correct);
+    
+    long key_correct = 0;
+    double key_ns = time_submissions(answer_key, key_correct);
+    
+    std::cout << "Submission: " << count << " answers, " << SUBMISSIONS << " submissions per run, "
+              << key_correct / SUBMISSIONS << " correct\n";
+    std::cout << "  query per answer      " << query_ns / 1000 << " us/submission\n";
+    std::cout << "  cached per answer     " << cached_ns / 1000 << " us/submission\n";
+    std::cout << "  answer key + grade    " << key_ns / 1000 << " us/submission (" << query_ns / key_ns << "x / "
+              << cached_ns / key_ns << "x faster)\n";
+    if (query_correct != key_correct || cached_correct != key_correct) {
+        std::cout << "  scores differ!\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,294 @@
+// Network backend benchmark: epoll vs io_uring side by side.
+// For each backend a real Server runs in a child process; the parent opens
+// 10k connections and drives an open-loop request stream (fixed rate,
+// spread round-robin over the connections) for a few seconds.
+// Reported per backend: requests/s served, p50/p99 round-trip latency,
+// server syscalls/s and syscalls per request (from the server's IoStats).
+//
+// Usage: bench_io_backend [connections] [requests/s] [seconds]
+// Needs RLIMIT_NOFILE above the connection count (raised up to the hard limit).
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../server/include/server.h"
+#include "../server/include/logger.h"
+
+static const int BASE_PORT = 19400;
+static const double WARMUP_SECONDS = 0.5;
+static const uint16_t PROBE_TYPE = 9999;    // Unknown type: answered inline with an error
+
+typedef std::chrono::steady_clock Clock;
+
+// Child side: the server and its counters
+static Server* g_server = nullptr;
+static IoStats g_window_start;
+
+static void on_window_start(int) {
+    g_window_start = g_server->get_io_stats();
+}
+
+static void on_stop(int) {
+    g_server->stop();
+}
+
+struct WindowStats {
+    IoStats start;
+    IoStats end;
+};
+
+static void run_server(int port, IoBackendKind kind, int report_fd) {
+    Logger::get_instance()->set_min_level(ERROR);  // Every probe logs "unknown message type"
+    
+    std::string db_path = "/tmp/bench_io_backend_" + std::to_string(getpid()) + ".db";
+    {
+        Database db(db_path);
+        if (!db.is_open() || !db.initialize()) {
+            std::cerr << "server: database setup failed\n";
+            _exit(1);
+        }
+        
+        Server server(port, &db, 0, false, DEFAULT_LISTEN_BACKLOG, kind);
+        g_server = &server;
+        signal(SIGUSR1, on_window_start);
+        signal(SIGTERM, on_stop);
+        if (!server.setup()) {
+            _exit(1);
+        }
+        
+        server.run();
+        
+        WindowStats stats{g_window_start, server.get_io_stats()};
+        if (write(report_fd, &stats, sizeof(stats)) != sizeof(stats)) {
+            _exit(1);
+        }
+    }
+    unlink(db_path.c_str());
+    unlink((db_path + "-wal").c_str());
+    unlink((db_path + "-shm").c_str());
+    _exit(0);
+}
+
+// Parent side: one client connection
+struct ClientConn {
+    int fd = -1;
+    FrameDecoder decoder;
+    std::deque<Clock::time_point> sent;     // Send times of unanswered requests
+};
+
+static int connect_to(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    
+    // FrameDecoder::fill reads until EAGAIN
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+static bool run(IoBackendKind kind, const char* name, int port, int connections, int rate, double seconds) {
+    int report[2];
+    if (pipe(report) < 0) {
+        return false;
+    }
+    
+    std::cout << std::flush;    // Not inherited by the child's buffer
+    pid_t child = fork();
+    if (child == 0) {
+        close(report[0]);
+        run_server(port, kind, report[1]);
+    }
+    close(report[1]);
+    
+    // Wait for the listening socket
+    int probe = -1;
+    for (int i = 0; i < 100 && probe < 0; i++) {
+        usleep(50000);
+        probe = connect_to(port);
+    }
+    if (probe < 0) {
+        std::cerr << name << ": server did not start\n";
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+        return false;
+    }
+    close(probe);
+    
+    std::vector<ClientConn> conns(connections);
+    int epoll_fd = epoll_create1(0);
+    for (int i = 0; i < connections; i++) {
+        conns[i].fd = connect_to(port);
+        if (conns[i].fd < 0) {
+            std::cerr << name << ": connect failed after " << i << " connections: " << strerror(errno) << "\n";
+            kill(child, SIGKILL);
+            waitpid(child, nullptr, 0);
+            return false;
+        }
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conns[i].fd, &event);
+    }
+    
+    std::string payload = "{}";
+    char frame[6 + 2];
+    uint16_t type = htons(PROBE_TYPE);
+    uint32_t length = htonl(payload.size());
+    memcpy(frame, &type, 2);
+    memcpy(frame + 2, &length, 4);
+    memcpy(frame + 6, payload.data(), payload.size());
+    
+    std::vector<double> latencies;
+    latencies.reserve((size_t)(rate * seconds) + 1024);
+    uint64_t sent = 0;
+    uint64_t answered = 0;
+    uint64_t measured_sent = 0;
+    size_t next_conn = 0;
+    bool window_open = false;
+    
+    Clock::time_point begin = Clock::now();
+    Clock::time_point window_begin = begin;
+    Clock::time_point end = begin + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(WARMUP_SECONDS + seconds));
+    struct epoll_event events[256];
+    
+    while (true) {
+        Clock::time_point now = Clock::now();
+        if (!window_open && now - begin >= std::chrono::duration<double>(WARMUP_SECONDS)) {
+            window_open = true;
+            window_begin = now;
+            kill(child, SIGUSR1);
+        }
+        if (now >= end) {
+            break;
+        }
+        
+        // Open loop: send whatever the schedule says is due by now
+        uint64_t due = (uint64_t)(std::chrono::duration<double>(now - begin).count() * rate);
+        while (sent < due) {
+            ClientConn& conn = conns[next_conn];
+            next_conn = (next_conn + 1) % conns.size();
+            if (send(conn.fd, frame, sizeof(frame), MSG_NOSIGNAL) != (ssize_t)sizeof(frame)) {
+                std::cerr << name << ": send failed\n";
+                break;
+            }
+            conn.sent.push_back(Clock::now());
+            sent++;
+            if (window_open) {
+                measured_sent++;
+            }
+        }
+        
+        int nfds = epoll_wait(epoll_fd, events, 256, 1);
+        Clock::time_point received = Clock::now();
+        for (int i = 0; i < nfds; i++) {
+            ClientConn& conn = conns[events[i].data.u32];
+            if (conn.decoder.fill(conn.fd) == RECV_ERROR) {
+                std::cerr << name << ": server closed a connection\n";
+                epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+                continue;
+            }
+            Message msg;
+            while (conn.decoder.next(msg) == RECV_SUCCESS) {
+                if (conn.sent.empty()) {
+                    continue;
+                }
+                if (window_open && conn.sent.front() >= window_begin) {
+                    latencies.push_back(std::chrono::duration<double, std::micro>(received - conn.sent.front()).count());
+                    answered++;
+                }
+                conn.sent.pop_front();
+            }
+        }
+    }
+    double window = std::chrono::duration<double>(Clock::now() - window_begin).count();
+    
+    kill(child, SIGTERM);
+    WindowStats stats;
+    bool reported = read(report[0], &stats, sizeof(stats)) == sizeof(stats);
+    close(report[0]);
+    waitpid(child, nullptr, 0);
+    
+    for (ClientConn& conn : conns) {
+        close(conn.fd);
+    }
+    close(epoll_fd);
+    
+    if (!reported || latencies.empty()) {
+        std::cerr << name << ": no results\n";
+        return false;
+    }
+    
+    std::sort(latencies.begin(), latencies.end());
+    double p50 = latencies[latencies.size() / 2];
+    double p99 = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+    uint64_t syscalls = stats.end.syscalls() - stats.start.syscalls();
+    
+    char line[256];
+    snprintf(line, sizeof(line),
+             "  %-6s %8.0f req/s (%llu/%llu answered)  p50 %7.1f us  p99 %8.1f us  "
+             "%9.0f syscalls/s  %.3f syscalls/request\n",
+             name, answered / window, (unsigned long long)answered, (unsigned long long)measured_sent,
+             p50, p99, syscalls / window, (double)syscalls / std::max<uint64_t>(answered, 1));
+    std::cout << line;
+    snprintf(line, sizeof(line), "         recv %llu  send %llu  wait %llu  other %llu\n",
+             (unsigned long long)(stats.end.recv_calls - stats.start.recv_calls),
+             (unsigned long long)(stats.end.send_calls - stats.start.send_calls),
+             (unsigned long long)(stats.end.wait_calls - stats.start.wait_calls),
+             (unsigned long long)(stats.end.other_calls - stats.start.other_calls));
+    std::cout << line;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int connections = argc > 1 ? atoi(argv[1]) : 10000;
+    int rate = argc > 2 ? atoi(argv[2]) : 20000;
+    double seconds = argc > 3 ? atof(argv[3]) : 3.0;
+    
+    // Each process holds one fd per connection plus a few of its own
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    rlim_t wanted = (rlim_t)connections + 64;
+    if (limit.rlim_cur < wanted) {
+        limit.rlim_cur = std::min(wanted, limit.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    if (limit.rlim_cur < wanted) {
+        connections = (int)limit.rlim_cur - 64;
+        std::cout << "RLIMIT_NOFILE too low, using " << connections << " connections\n";
+    }
+    
+    std::cout << "I/O backends: " << connections << " connections, " << rate << " requests/s open loop, "
+              << seconds << " s (after " << WARMUP_SECONDS << " s warmup)\n";
+    
+    bool ok = run(IO_BACKEND_EPOLL, "epoll", BASE_PORT, connections, rate, seconds);
+    ok = run(IO_BACKEND_URING, "uring", BASE_PORT + 1, connections, rate, seconds) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,301 @@
+// Login storm benchmark: password hashing inline vs on the hashing pool.
+// For each mode a real Server runs in a child process with pre-registered
+// users; the parent keeps N logins in flight (N connections, each sending
+// its next login as soon as the previous one is answered) and meanwhile
+// measures two other opcodes back to back on their own connections:
+//   loop  - an unknown type, answered on the event loop
+//   rooms - LIST_ROOMS of a logged-in user, answered by the database pool
+// Reported per mode: logins/s and p50/p99 round trip of both probes
+// (everything answered inside the measurement window counts).
+//
+// Usage: bench_login_storm [logins in flight] [kdf iterations] [seconds]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "../server/include/server.h"
+#include "../server/include/logger.h"
+#include "../server/include/session.h"
+
+static const int BASE_PORT = 19500;
+static const double WARMUP_SECONDS = 0.5;
+static const uint16_t PROBE_TYPE = 9999;    // Unknown type: answered inline with an error
+static const char* PASSWORD = "storm-password";
+
+typedef std::chrono::steady_clock Clock;
+
+static Server* g_server = nullptr;
+
+static void on_stop(int) {
+    g_server->stop();
+}
+
+static std::string storm_user(int i) {
+    return "storm_" + std::to_string(i);
+}
+
+// Child side: users + server, hashing on `hash_threads` threads (0 = inline)
+static void run_server(int port, int users, int hash_threads) {
+    Logger::get_instance()->set_min_level(ERROR);
+    
+    std::string db_path = "/tmp/bench_login_storm_" + std::to_string(getpid()) + ".db";
+    {
+        Database db(db_path);
+        if (!db.is_open() || !db.initialize()) {
+            std::cerr << "server: database setup failed\n";
+            _exit(1);
+        }
+        
+        // One hash for everybody: registering N users would cost N KDF runs
+        std::string hashed = SessionManager::hash_password(PASSWORD);
+        for (int i = 0; i <= users; i++) {
+            db.create_user(storm_user(i), hashed, "USER");
+        }
+        
+        TaskPool db_pool(DEFAULT_POOL_THREADS);
+        std::unique_ptr<TaskPool> hash_pool;
+        Server server(port, &db, 0, false, DEFAULT_LISTEN_BACKLOG);
+        server.set_task_pool(&db_pool);
+        if (hash_threads > 0) {
+            hash_pool.reset(new TaskPool(hash_threads));
+            server.set_hash_pool(hash_pool.get());
+        }
+        g_server = &server;
+        signal(SIGTERM, on_stop);
+        if (!server.setup()) {
+            _exit(1);
+        }
+        
+        server.run();
+        if (hash_pool) {
+            hash_pool->shutdown();
+        }
+        db_pool.shutdown();
+    }
+    unlink(db_path.c_str());
+    unlink((db_path + "-wal").c_str());
+    unlink((db_path + "-shm").c_str());
+    _exit(0);
+}
+
+static int connect_to(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+    
+    // FrameDecoder::fill reads until EAGAIN
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+static bool send_frame(int fd, uint16_t type, const json& payload) {
+    std::string body = payload.dump();
+    std::string frame(6, '\0');
+    uint16_t net_type = htons(type);
+    uint32_t net_length = htonl(body.size());
+    memcpy(&frame[0], &net_type, 2);
+    memcpy(&frame[2], &net_length, 4);
+    frame += body;
+    return send(fd, frame.data(), frame.size(), MSG_NOSIGNAL) == (ssize_t)frame.size();
+}
+
+static json login_request(int i) {
+    json payload;
+    payload["username"] = storm_user(i);
+    payload["password"] = PASSWORD;
+    return payload;
+}
+
+// One client connection with at most one request outstanding
+struct ClientConn {
+    int fd = -1;
+    FrameDecoder decoder;
+    uint16_t type = 0;                  // What it keeps sending
+    json payload;
+    Clock::time_point sent_at;
+    std::vector<double>* latencies = nullptr;   // Probes only
+};
+
+static double percentile(std::vector<double>& values, int p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * p / 100)];
+}
+
+static bool run(const char* name, int port, int in_flight, int hash_threads, double seconds) {
+    std::cout << std::flush;    // Not inherited by the child's buffer
+    pid_t child = fork();
+    if (child == 0) {
+        run_server(port, in_flight, hash_threads);
+    }
+    
+    // Wait for the listening socket (after the users are created)
+    int probe = -1;
+    for (int i = 0; i < 200 && probe < 0; i++) {
+        usleep(50000);
+        probe = connect_to(port);
+    }
+    if (probe < 0) {
+        std::cerr << name << ": server did not start\n";
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+        return false;
+    }
+    close(probe);
+    
+    // conns[0]: loop probe, conns[1]: rooms probe, then the login storm
+    std::vector<ClientConn> conns(in_flight + 2);
+    std::vector<double> loop_latencies;
+    std::vector<double> rooms_latencies;
+    int epoll_fd = epoll_create1(0);
+    for (size_t i = 0; i < conns.size(); i++) {
+        conns[i].fd = connect_to(port);
+        if (conns[i].fd < 0) {
+            std::cerr << name << ": connect failed: " << strerror(errno) << "\n";
+            kill(child, SIGKILL);
+            waitpid(child, nullptr, 0);
+            return false;
+        }
+        struct epoll_event event;
+        event.events = EPOLLIN;
+        event.data.u32 = i;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, conns[i].fd, &event);
+    }
+    conns[0].type = PROBE_TYPE;
+    conns[0].payload = json::object();
+    conns[0].latencies = &loop_latencies;
+    
+    // The rooms probe logs in first (the connection stays authorized)
+    conns[1].type = C2S_LOGIN;
+    conns[1].payload = login_request(in_flight);
+    conns[1].latencies = &rooms_latencies;
+    for (int i = 0; i < in_flight; i++) {
+        conns[i + 2].type = C2S_LOGIN;
+        conns[i + 2].payload = login_request(i);
+    }
+    
+    Clock::time_point begin = Clock::now();
+    Clock::time_point window_begin = begin + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(WARMUP_SECONDS));
+    Clock::time_point end = window_begin + std::chrono::duration_cast<Clock::duration>(
+        std::chrono::duration<double>(seconds));
+    for (ClientConn& conn : conns) {
+        conn.sent_at = Clock::now();
+        send_frame(conn.fd, conn.type, conn.payload);
+    }
+    
+    uint64_t logins = 0;
+    bool failed = false;
+    struct epoll_event events[256];
+    while (!failed && Clock::now() < end) {
+        int nfds = epoll_wait(epoll_fd, events, 256, 10);
+        Clock::time_point received = Clock::now();
+        bool in_window = received >= window_begin;
+        for (int i = 0; i < nfds; i++) {
+            ClientConn& conn = conns[events[i].data.u32];
+            if (conn.decoder.fill(conn.fd) == RECV_ERROR) {
+                std::cerr << name << ": server closed a connection\n";
+                failed = true;
+                break;
+            }
+            Message msg;
+            while (conn.decoder.next(msg) == RECV_SUCCESS) {
+                if (conn.type == C2S_LOGIN && msg.type != S2C_LOGIN_OK) {
+                    std::cerr << name << ": login failed\n";
+                    failed = true;
+                    break;
+                }
+                if (in_window) {
+                    if (conn.latencies) {
+                        conn.latencies->push_back(
+                            std::chrono::duration<double, std::micro>(received - conn.sent_at).count());
+                    } else {
+                        logins++;
+                    }
+                }
+                
+                // Rooms probe: logged in, switch to the measured opcode
+                if (conn.latencies && conn.type == C2S_LOGIN) {
+                    conn.type = C2S_LIST_ROOMS;
+                    conn.payload = json::object();
+                    conn.latencies->clear();
+                }
+                conn.sent_at = Clock::now();
+                send_frame(conn.fd, conn.type, conn.payload);
+            }
+        }
+    }
+    
+    kill(child, SIGTERM);
+    waitpid(child, nullptr, 0);
+    for (ClientConn& conn : conns) {
+        close(conn.fd);
+    }
+    close(epoll_fd);
+    
+    if (failed) {
+        return false;
+    }
+    
+    // A stalled loop answers few probes: the counts matter as much as the percentiles
+    char line[256];
+    snprintf(line, sizeof(line), "  %-7s %7.1f logins/s\n", name, logins / seconds);
+    std::cout << line;
+    snprintf(line, sizeof(line), "          loop probe  %7zu answered  p50 %10.1f us  p99 %10.1f us\n",
+             loop_latencies.size(), percentile(loop_latencies, 50), percentile(loop_latencies, 99));
+    std::cout << line;
+    snprintf(line, sizeof(line), "          rooms probe %7zu answered  p50 %10.1f us  p99 %10.1f us\n",
+             rooms_latencies.size(), percentile(rooms_latencies, 50), percentile(rooms_latencies, 99));
+    std::cout << line;
+    return true;
+}
+
+int main(int argc, char** argv) {
+    int in_flight = argc > 1 ? atoi(argv[1]) : 500;
+    int iterations = argc > 2 ? atoi(argv[2]) : 20000;
+    double seconds = argc > 3 ? atof(argv[3]) : 5.0;
+    SessionManager::set_kdf_iterations(iterations);
+    
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    rlim_t wanted = (rlim_t)in_flight + 64;
+    if (limit.rlim_cur < wanted) {
+        limit.rlim_cur = std::min(wanted, limit.rlim_max);
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+    
+    std::cout << "Login storm: " << in_flight << " logins in flight, PBKDF2 " << iterations
+              << " iterations, " << seconds << " s (after " << WARMUP_SECONDS << " s warmup)\n";
+    
+    bool ok = run("inline", BASE_PORT, in_flight, 0, seconds);
+    ok = run("pool", BASE_PORT + 1, in_flight, DEFAULT_HASH_THREADS, seconds) && ok;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,176 @@
+// Random question sampling on a large bank: the old ORDER BY RANDOM()
+// LIMIT k query (scans and sorts every matching row) vs QuestionIndex
+// (k ids drawn in O(k), then k primary-key lookups).
+// The bank is a file-backed database of N generated questions over 10
+// topics x 3 difficulties. Three filters, as sent by PRACTICE_REQUEST:
+//   all/all, one topic, one topic + difficulty
+// Reported per filter: time per request for ORDER BY RANDOM(), for
+// get_random_questions and for the index draw alone; plus index load time.
+//
+// Usage: bench_question_index [questions] [k]
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sqlite3.h>
+#include <unistd.h>
+#include "../server/include/database.h"
+#include "../server/include/logger.h"
+#include "../server/include/question_index.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static double elapsed_us(Clock::time_point start) {
+    return std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+}
+
+// Generated rows in one transaction (recursive CTE, no round trips)
+static bool fill_bank(const std::string& path, int questions) {
+    sqlite3* handle = nullptr;
+    if (sqlite3_open(path.c_str(), &handle) != SQLITE_OK) {
+        return false;
+    }
+    std::string sql =
+        "BEGIN;"
+        "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " + std::to_string(questions) + ") "
+        "INSERT INTO Questions (content, options, correct_option, difficulty, topic, created_by) "
+        "SELECT 'Generated question ' || i, '{\"a\":\"1\",\"b\":\"2\",\"c\":\"3\",\"d\":\"4\"}', 'a', "
+        "CASE i % 3 WHEN 0 THEN 'easy' WHEN 1 THEN 'medium' ELSE 'hard' END, 'topic' || (i % 10), 1 FROM n;"
+        "COMMIT;";
+    char* error = nullptr;
+    bool ok = sqlite3_exec(handle, sql.c_str(), nullptr, nullptr, &error) == SQLITE_OK;
+    if (!ok) {
+        std::cerr << "fill failed: " << (error ? error : "") << "\n";
+        sqlite3_free(error);
+    }
+    sqlite3_close(handle);
+    return ok;
+}
+
+// The query get_random_questions used to build (with bound parameters)
+static double order_by_random_us(sqlite3* handle, const std::string& topic, const std::string& difficulty,
+                                 int k, int runs) {
+    std::string sql = "SELECT question_id, content, options, correct_option, difficulty, topic, created_by "
+                      "FROM Questions WHERE 1=1";
+    if (topic != "all") {
+        sql += " AND topic = ?1";
+    }
+    if (difficulty != "all") {
+        sql += " AND difficulty = ?2";
+    }
+    sql += " ORDER BY RANDOM() LIMIT ?3;";
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(handle, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+        return 0;
+    }
+    
+    long rows = 0;
+    Clock::time_point start = Clock::now();
+    for (int run = 0; run < runs; run++) {
+        if (topic != "all") {
+            sqlite3_bind_text(stmt, 1, topic.c_str(), -1, SQLITE_TRANSIENT);
+        }
+        if (difficulty != "all") {
+            sqlite3_bind_text(stmt, 2, difficulty.c_str(), -1, SQLITE_TRANSIENT);
+        }
+        sqlite3_bind_int(stmt, 3, k);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            rows++;
+        }
+        sqlite3_reset(stmt);
+    }
+    double us = elapsed_us(start) / runs;
+    sqlite3_finalize(stmt);
+    return rows == (long)k * runs ? us : -1;
+}
+
+int main(int argc, char** argv) {
+    int questions = argc > 1 ? atoi(argv[1]) : 1000000;
+    int k = argc > 2 ? atoi(argv[2]) : 10;
+    Logger::get_instance()->set_min_level(ERROR);
+    
+    std::string path = "/tmp/bench_question_index_" + std::to_string(getpid()) + ".db";
+    {
+        // Schema and sample data (teacher = user 1), then the generated bank
+        Database setup(path);
+        if (!setup.is_open() || !setup.initialize()) {
+            std::cerr << "database setup failed (run from tests/ so ../database/schema.sql is found)\n";
+            return 1;
+        }
+    }
+    if (!fill_bank(path, questions)) {
+        unlink(path.c_str());
+        return 1;
+    }
+    
+    {
+        Clock::time_point load_start = Clock::now();
+        Database db(path);
+        if (!db.initialize()) {
+            std::cerr << "database reopen failed\n";
+            return 1;
+        }
+        double load_ms = elapsed_us(load_start) / 1000;
+        
+        sqlite3* handle = nullptr;
+        sqlite3_open_v2(path.c_str(), &handle, SQLITE_OPEN_READONLY, nullptr);
+        
+        // The server's index, rebuilt here to time the draw on its own
+        QuestionIndex index;
+        sqlite3_stmt* stmt = nullptr;
+        sqlite3_prepare_v2(handle, "SELECT question_id, topic, difficulty FROM Questions;", -1, &stmt, nullptr);
+        while (sqlite3_step(stmt) == SQLITE_ROW) {
+            index.add(sqlite3_column_int(stmt, 0), reinterpret_cast<const char*>(sqlite3_column_text(stmt, 1)),
+                      reinterpret_cast<const char*>(sqlite3_column_text(stmt, 2)));
+        }
+        sqlite3_finalize(stmt);
+        
+        std::cout << "Question bank: " << db.indexed_question_count() << " questions, k = " << k
+                  << ", index loaded in " << load_ms << " ms (with initialize())\n";
+        
+        struct Filter {
+            const char* topic;
+            const char* difficulty;
+        };
+        Filter filters[] = {{"all", "all"}, {"topic3", "all"}, {"topic3", "hard"}};
+        for (const Filter& filter : filters) {
+            double sql_us = order_by_random_us(handle, filter.topic, filter.difficulty, k, 5);
+            
+            const int runs = 20000;
+            long checksum = 0;
+            Clock::time_point start = Clock::now();
+            for (int run = 0; run < runs; run++) {
+                checksum += db.get_random_questions(k, filter.topic, filter.difficulty).size();
+            }
+            double db_us = elapsed_us(start) / runs;
+            
+            start = Clock::now();
+            for (int run = 0; run < runs; run++) {
+                checksum += index.sample(k, filter.topic, filter.difficulty).size();
+            }
+            double draw_us = elapsed_us(start) / runs;
+            
+            char line[256];
+            snprintf(line, sizeof(line),
+                     "  %-6s/%-4s %8zu match  ORDER BY RANDOM() %10.1f us   index + lookups %7.2f us (%6.0fx)   "
+                     "draw only %6.2f us%s\n",
+                     filter.topic, filter.difficulty, index.count(filter.topic, filter.difficulty), sql_us, db_us,
+                     sql_us / db_us, draw_us, checksum == 2L * runs * k ? "" : "  (short samples!)");
+            std::cout << line;
+        }
+        
+        // 60000 draws of k from the bank: mostly misses unless the bank fits the cache
+        QuestionCacheStats stats = db.question_cache_stats();
+        char line[160];
+        snprintf(line, sizeof(line), "  question cache: %zu/%zu cached, hit rate %.1f%%\n", stats.size, stats.capacity,
+                 stats.hit_rate() * 100);
+        std::cout << line;
+        sqlite3_close(handle);
+    }
+    unlink(path.c_str());
+    unlink((path + "-wal").c_str());
+    unlink((path + "-shm").c_str());
+    return 0;
+}
@@ -0,0 +1,82 @@
+// Serialization cost of a 50-question S2C_PRACTICE_QUESTIONS payload:
+//   json tree - a json object per question, options copied into
+//               "option_" + key fields, then dump() of the whole response
+//               (what handle_practice_request did)
+//   fragments - QuestionPayload::build joining the questions' cached
+//               client_json bytes (serialized once, when the row is decoded)
+// Questions carry realistic Vietnamese text (escaping and UTF-8 included).
+//
+// Usage: bench_question_payload [questions per payload]
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../server/include/question_payload.h"
+
+static const int PAYLOADS = 20000;
+
+template <typename Build>
+static double time_payloads(Build build, size_t& bytes) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < PAYLOADS; i++) {
+        bytes += build();
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / PAYLOADS;
+}
+
+int main(int argc, char** argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 50;
+    
+    std::vector<Question> questions(count);
+    for (int i = 0; i < count; i++) {
+        Question& q = questions[i];
+        q.question_id = 1000 + i;
+        q.content = "Câu " + std::to_string(i) + ": Sông nào dài nhất chảy qua lãnh thổ Việt Nam "
+                    "và đổ ra \"Biển Đông\"?";
+        q.options.set(0, "Sông Hồng");
+        q.options.set(1, "Sông Cửu Long");
+        q.options.set(2, "Sông Đồng Nai");
+        q.options.set(3, "Sông Mekong");
+        q.correct_option = "d";
+        q.client_json = QuestionPayload::client_json(q);
+    }
+    
+    size_t tree_bytes = 0;
+    double tree_ns = time_payloads([&]() {
+        json response;
+        response["duration_seconds"] = 1800;
+        response["questions"] = json::array();
+        for (const auto& q : questions) {
+            json question_json;
+            question_json["q_id"] = q.question_id;
+            question_json["content"] = q.content;
+            for (int i = 0; i < QuestionOptions::COUNT; i++) {
+                if (q.options.has(i)) {
+                    question_json[std::string("option_") + QuestionOptions::key(i)] = q.options.text[i];
+                }
+            }
+            response["questions"].push_back(question_json);
+        }
+        return Protocol::serialize(response)->size();
+    }, tree_bytes);
+    
+    size_t fragment_bytes = 0;
+    double fragment_ns = time_payloads([&]() {
+        json response;
+        response["duration_seconds"] = 1800;
+        return QuestionPayload::build(response, questions)->size();
+    }, fragment_bytes);
+    
+    std::cout << "Payload: " << count << " questions, " << tree_bytes / PAYLOADS << " bytes, "
+              << PAYLOADS << " payloads per run\n";
+    std::cout << "  json tree + dump   " << tree_ns / 1000 << " us/payload\n";
+    std::cout << "  cached fragments   " << fragment_ns / 1000 << " us/payload (" << tree_ns / fragment_ns
+              << "x faster)\n";
+    if (tree_bytes != fragment_bytes) {
+        std::cout << "  payload sizes differ!\n";
+        return 1;
+    }
+    return 0;
+}
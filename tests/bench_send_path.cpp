@@ -0,0 +1,136 @@
+// Send path benchmark: syscalls per message on a broadcast-heavy workload.
+// Every tick broadcasts a few messages to every connection, comparing:
+//   legacy  - header and payload as two send() calls per message
+//   writev  - Protocol::send_message (one sendmsg per message)
+//   queued  - OutputQueue per connection, one coalesced flush per tick
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "../server/include/protocol.h"
+#include "../server/include/logger.h"
+
+static const int CONNECTIONS = 200;
+static const int TICKS = 200;
+static const int MESSAGES_PER_TICK = 4;
+
+struct Pair {
+    int reader;
+    int writer;
+};
+
+static std::vector<Pair> open_pairs() {
+    std::vector<Pair> pairs;
+    for (int i = 0; i < CONNECTIONS; i++) {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) < 0) {
+            perror("socketpair");
+            exit(1);
+        }
+        fcntl(sv[0], F_SETFL, fcntl(sv[0], F_GETFL, 0) | O_NONBLOCK);
+        pairs.push_back({sv[0], sv[1]});
+    }
+    return pairs;
+}
+
+static void drain(const std::vector<Pair>& pairs) {
+    char buf[65536];
+    for (const auto& p : pairs) {
+        while (recv(p.reader, buf, sizeof(buf), 0) > 0) {
+        }
+    }
+}
+
+static void close_pairs(const std::vector<Pair>& pairs) {
+    for (const auto& p : pairs) {
+        close(p.reader);
+        close(p.writer);
+    }
+}
+
+static void report(const char* name, uint64_t syscalls, double ms) {
+    uint64_t messages = (uint64_t)CONNECTIONS * TICKS * MESSAGES_PER_TICK;
+    printf("  %-8s %9llu messages %9llu syscalls  %.3f syscalls/msg  %8.2f ms\n", name,
+           (unsigned long long)messages, (unsigned long long)syscalls, (double)syscalls / messages, ms);
+}
+
+int main() {
+    Logger::get_instance()->set_min_level(ERROR);
+    
+    json payload;
+    payload["username"] = "student_042";
+    payload["room_id"] = 17;
+    std::string body = payload.dump();
+    
+    std::cout << "Broadcast: " << CONNECTIONS << " connections x " << TICKS << " ticks x "
+              << MESSAGES_PER_TICK << " messages/tick, " << body.size() << " byte payload\n";
+    
+    // legacy: two send() per message
+    {
+        std::vector<Pair> pairs = open_pairs();
+        uint64_t syscalls = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < TICKS; t++) {
+            for (int m = 0; m < MESSAGES_PER_TICK; m++) {
+                std::string dumped = payload.dump();
+                char header[6];
+                Protocol::write_header(header, 1004, dumped.size());
+                for (const auto& p : pairs) {
+                    Protocol::send_exact(p.writer, header, 6);
+                    Protocol::send_exact(p.writer, dumped.data(), dumped.size());
+                    syscalls += 2;
+                }
+            }
+            drain(pairs);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        report("legacy", syscalls, ms);
+        close_pairs(pairs);
+    }
+    
+    // writev: one sendmsg per message
+    {
+        std::vector<Pair> pairs = open_pairs();
+        uint64_t syscalls = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < TICKS; t++) {
+            for (int m = 0; m < MESSAGES_PER_TICK; m++) {
+                for (const auto& p : pairs) {
+                    Protocol::send_message(p.writer, 1004, payload);
+                    syscalls++;
+                }
+            }
+            drain(pairs);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        report("writev", syscalls, ms);
+        close_pairs(pairs);
+    }
+    
+    // queued: messages coalesced per connection, one flush per tick
+    {
+        std::vector<Pair> pairs = open_pairs();
+        std::vector<OutputQueue> queues(pairs.size());
+        IoStats stats;
+        auto start = std::chrono::steady_clock::now();
+        for (int t = 0; t < TICKS; t++) {
+            for (int m = 0; m < MESSAGES_PER_TICK; m++) {
+                for (size_t i = 0; i < pairs.size(); i++) {
+                    queues[i].push(1004, payload.dump());
+                }
+            }
+            for (size_t i = 0; i < pairs.size(); i++) {
+                queues[i].flush(pairs[i].writer, &stats);
+            }
+            drain(pairs);
+        }
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        report("queued", stats.send_calls, ms);
+        close_pairs(pairs);
+    }
+    
+    return 0;
+}
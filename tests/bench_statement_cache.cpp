@@ -0,0 +1,85 @@
+// Prepared-statement cache benchmark: two hot point queries, each run with
+// the cache off (prepare + finalize per call, the old behaviour) and on
+// (prepared once, reset and rebound per call).
+//   get_question_by_id - primary-key SELECT, read on every question fetch
+//   save_user_answer   - INSERT OR REPLACE, written on every answer click
+// The database is in memory so the numbers are CPU only; on disk every
+// autocommit write also pays an fsync, which the cache does not change.
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../server/include/database.h"
+#include "../server/include/logger.h"
+
+static const int CALLS = 200000;
+
+template <typename Call>
+static double time_calls(Call call) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < CALLS; i++) {
+        call(i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    return ns / CALLS;
+}
+
+static void report(const char* name, double uncached_ns, double cached_ns) {
+    std::cout << "  " << name << "\n";
+    std::cout << "    prepare per call  " << uncached_ns << " ns/call\n";
+    std::cout << "    statement cache   " << cached_ns << " ns/call (" << uncached_ns / cached_ns << "x faster)\n";
+}
+
+int main() {
+    Logger::get_instance()->set_min_level(ERROR);
+    
+    Database db(":memory:");
+    if (!db.is_open() || !db.initialize()) {
+        std::cerr << "database setup failed (run from tests/ so ../database/schema.sql is found)\n";
+        return 1;
+    }
+    
+    // Rows must come from SQLite, not from the question cache
+    DatabaseConfig config;
+    config.question_cache_size = 0;
+    db.configure(config);
+    
+    // Sample data has a teacher (user 1) and a few dozen questions
+    std::vector<int> question_ids;
+    for (int id = 1; id <= 1000; id++) {
+        Question question;
+        if (db.get_question_by_id(id, question)) {
+            question_ids.push_back(id);
+        }
+    }
+    int room_id = 0;
+    if (question_ids.empty() || !db.create_test_room("bench", 1, 10, 30, "{}", room_id)) {
+        std::cerr << "sample data missing\n";
+        return 1;
+    }
+    
+    long checksum = 0;
+    auto get_question = [&](int i) {
+        Question question;
+        checksum += db.get_question_by_id(question_ids[i % question_ids.size()], question) ? question.question_id : 0;
+    };
+    const char* options[] = {"a", "b", "c", "d"};
+    auto save_answer = [&](int i) {
+        checksum += db.save_user_answer(1, room_id, question_ids[i % question_ids.size()], options[i % 4]);
+    };
+    
+    std::cout << "Calls per run: " << CALLS << " (" << question_ids.size() << " questions, in-memory database)\n";
+    
+    db.set_statement_cache(false);
+    double get_uncached = time_calls(get_question);
+    double save_uncached = time_calls(save_answer);
+    
+    db.set_statement_cache(true);
+    double get_cached = time_calls(get_question);
+    double save_cached = time_calls(save_answer);
+    
+    report("get_question_by_id", get_uncached, get_cached);
+    report("save_user_answer", save_uncached, save_cached);
+    std::cout << "  (checksum " << checksum << ")\n";
+    return 0;
+}
@@ -0,0 +1,140 @@
+// Timer cost with N armed timers due over the next 10 minutes (6000 ticks
+// of TIMER_TICK_MS), as idle-connection timers would be:
+//   std::multimap - ordered by expiry, cancel through a stored iterator
+//   TimerWheel    - hierarchical wheel (O(1) schedule / cancel)
+// re-arm  - cancel one timer and schedule it again (activity on a connection)
+// advance - run through every tick until all timers fired; reports the mean
+//           and worst time spent in one loop tick
+//
+// Usage: bench_timer_wheel [max timers] [re-arms]
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <random>
+#include <vector>
+#include "../server/include/timer_wheel.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static const uint64_t HORIZON = 6000;
+static const uint64_t START = 12345;
+
+static double elapsed_ns(Clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+}
+
+struct Result {
+    double rearm_ns = 0;
+    double tick_mean_us = 0;
+    double tick_max_us = 0;
+    size_t fired = 0;
+};
+
+static void print(const char* name, const Result& result) {
+    char line[160];
+    snprintf(line, sizeof(line), "  %-14s re-arm %7.1f ns   tick mean %7.2f us, max %8.1f us   (%zu fired)\n", name,
+             result.rearm_ns, result.tick_mean_us, result.tick_max_us, result.fired);
+    std::cout << line;
+}
+
+template <typename Advance>
+static void run_ticks(Advance advance, Result& result) {
+    double total = 0;
+    for (uint64_t tick = START + 1; tick <= START + HORIZON + 1; tick++) {
+        Clock::time_point start = Clock::now();
+        result.fired += advance(tick);
+        double us = elapsed_ns(start) / 1000;
+        total += us;
+        result.tick_max_us = std::max(result.tick_max_us, us);
+    }
+    result.tick_mean_us = total / (HORIZON + 1);
+}
+
+static Result bench_multimap(const std::vector<uint64_t>& expiries, const std::vector<uint64_t>& rearms) {
+    typedef std::multimap<uint64_t, TimerEvent> Map;
+    Map timers;
+    std::vector<Map::iterator> handles;
+    handles.reserve(expiries.size());
+    for (size_t i = 0; i < expiries.size(); i++) {
+        handles.push_back(timers.emplace(expiries[i], TimerEvent{0, static_cast<int>(i), 0}));
+    }
+    
+    Result result;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < rearms.size(); i++) {
+        size_t slot = i % handles.size();
+        timers.erase(handles[slot]);
+        handles[slot] = timers.emplace(rearms[i], TimerEvent{0, static_cast<int>(slot), 0});
+    }
+    result.rearm_ns = elapsed_ns(start) / rearms.size();
+    
+    std::vector<TimerEvent> fired;
+    run_ticks([&](uint64_t now) {
+        fired.clear();
+        while (!timers.empty() && timers.begin()->first <= now) {
+            fired.push_back(timers.begin()->second);
+            timers.erase(timers.begin());
+        }
+        return fired.size();
+    }, result);
+    return result;
+}
+
+static Result bench_wheel(const std::vector<uint64_t>& expiries, const std::vector<uint64_t>& rearms) {
+    TimerWheel wheel(START);
+    std::vector<TimerId> handles;
+    handles.reserve(expiries.size());
+    for (size_t i = 0; i < expiries.size(); i++) {
+        handles.push_back(wheel.schedule(expiries[i], TimerEvent{0, static_cast<int>(i), 0}));
+    }
+    
+    Result result;
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < rearms.size(); i++) {
+        size_t slot = i % handles.size();
+        wheel.cancel(handles[slot]);
+        handles[slot] = wheel.schedule(rearms[i], TimerEvent{0, static_cast<int>(slot), 0});
+    }
+    result.rearm_ns = elapsed_ns(start) / rearms.size();
+    
+    std::vector<TimerEvent> fired;
+    run_ticks([&](uint64_t now) {
+        fired.clear();
+        wheel.advance(now, fired);
+        return fired.size();
+    }, result);
+    return result;
+}
+
+int main(int argc, char** argv) {
+    size_t max_timers = argc > 1 ? atoll(argv[1]) : 1000000;
+    size_t rearm_count = argc > 2 ? atoll(argv[2]) : 1000000;
+    
+    std::mt19937_64 rng(11);
+    std::vector<uint64_t> rearms(rearm_count);
+    for (uint64_t& expires : rearms) {
+        expires = START + 1 + rng() % HORIZON;
+    }
+    
+    int status = 0;
+    for (size_t count = 1000; count <= max_timers; count *= 10) {
+        std::vector<uint64_t> expiries(count);
+        for (uint64_t& expires : expiries) {
+            expires = START + 1 + rng() % HORIZON;
+        }
+        
+        std::cout << count << " armed timers, " << rearm_count << " re-arms, " << HORIZON << " ticks\n";
+        Result map_result = bench_multimap(expiries, rearms);
+        Result wheel_result = bench_wheel(expiries, rearms);
+        print("std::multimap", map_result);
+        print("TimerWheel", wheel_result);
+        if (map_result.fired != count || wheel_result.fired != count) {
+            std::cout << "  timers lost!\n";
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,137 @@
+#!/usr/bin/env python3
+"""
+Connect Burst Test
+Mở N kết nối cùng lúc (cả lớp bấm "join" một lượt) và đo thời gian
+connect + phản hồi đầu tiên của server cho từng kết nối.
+
+Mỗi kết nối gửi một message không hợp lệ (type 9999): server trả
+S2C_RESPONSE_ERROR ngay mà không chạm database, nên độ trễ đo được chính
+là độ trễ accept. Khi accept queue tràn, SYN bị drop và client phải retry
+(~1s, 3s, ...), thể hiện rõ ở p99/max.
+
+Usage:
+    python3 test_connect_burst.py [--host 127.0.0.1] [--port 8888] [--count 2000]
+"""
+
+import argparse
+import json
+import resource
+import selectors
+import socket
+import struct
+import time
+
+UNKNOWN_MESSAGE = 9999
+S2C_RESPONSE_ERROR = 802
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    index = min(len(sorted_values) - 1, int(len(sorted_values) * p / 100))
+    return sorted_values[index]
+
+
+def run_burst(host, port, count, timeout):
+    # One fd per connection
+    soft, hard = resource.getrlimit(resource.RLIMIT_NOFILE)
+    if soft < count + 64:
+        resource.setrlimit(resource.RLIMIT_NOFILE, (min(hard, count + 64), hard))
+
+    payload = json.dumps({}).encode('utf-8')
+    request = struct.pack('!HI', UNKNOWN_MESSAGE, len(payload)) + payload
+
+    sel = selectors.DefaultSelector()
+    start = {}
+    connected = []
+    latencies = []
+    failed = 0
+
+    # Fire every connect before waiting on any of them
+    burst_start = time.monotonic()
+    for _ in range(count):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        sock.setblocking(False)
+        start[sock] = time.monotonic()
+        err = sock.connect_ex((host, port))
+        if err not in (0, 115):  # 115 = EINPROGRESS
+            failed += 1
+            sock.close()
+            continue
+        sel.register(sock, selectors.EVENT_WRITE, b'')
+    burst_sent = time.monotonic() - burst_start
+
+    deadline = time.monotonic() + timeout
+    pending = len(sel.get_map())
+    while pending > 0 and time.monotonic() < deadline:
+        for key, events in sel.select(timeout=0.5):
+            sock = key.fileobj
+            if events & selectors.EVENT_WRITE:
+                if sock.getsockopt(socket.SOL_SOCKET, socket.SO_ERROR) != 0:
+                    failed += 1
+                    pending -= 1
+                    sel.unregister(sock)
+                    sock.close()
+                    continue
+                connected.append(sock)
+                sock.send(request)
+                sel.modify(sock, selectors.EVENT_READ, b'')
+                continue
+
+            try:
+                data = key.data + sock.recv(4096)
+            except (ConnectionResetError, BlockingIOError):
+                data = None
+            if not data:
+                failed += 1
+                pending -= 1
+                sel.unregister(sock)
+                continue
+            if len(data) < 6:
+                sel.modify(sock, selectors.EVENT_READ, data)
+                continue
+            msg_type, length = struct.unpack('!HI', data[:6])
+            if len(data) < 6 + length:
+                sel.modify(sock, selectors.EVENT_READ, data)
+                continue
+            if msg_type == S2C_RESPONSE_ERROR:
+                latencies.append(time.monotonic() - start[sock])
+            else:
+                failed += 1
+            pending -= 1
+            sel.unregister(sock)
+
+    timed_out = pending
+    for sock in start:
+        sock.close()
+
+    latencies.sort()
+    ms = [v * 1000 for v in latencies]
+    print("=" * 60)
+    print(f"Connect burst: {count} connections to {host}:{port}")
+    print("=" * 60)
+    print(f"connect() calls issued in {burst_sent * 1000:.1f} ms")
+    print(f"answered: {len(latencies)}, failed: {failed}, timed out: {timed_out}")
+    if ms:
+        print(f"connect + first reply latency (ms): "
+              f"p50={percentile(ms, 50):.1f} p90={percentile(ms, 90):.1f} "
+              f"p99={percentile(ms, 99):.1f} max={ms[-1]:.1f}")
+        slow = sum(1 for v in ms if v >= 900)
+        print(f"connections >= 900 ms (SYN retransmit): {slow}")
+    return len(latencies) == count
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Burst of simultaneous connects")
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=8888)
+    parser.add_argument('--count', type=int, default=2000)
+    parser.add_argument('--timeout', type=float, default=30.0)
+    args = parser.parse_args()
+
+    ok = run_burst(args.host, args.port, args.count, args.timeout)
+    raise SystemExit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+Connection Auth Test
+Sau khi login, một kết nối được xác thực bằng ClientInfo: request mang đúng
+token (hoặc không mang token) không cần tra cứu session. Token khác hoặc token
+đã logout (kể cả logout từ kết nối khác) phải bị từ chối.
+
+Usage:
+    python3 test_connection_auth.py [--host 127.0.0.1] [--port 8888]
+"""
+
+import argparse
+import json
+import random
+import socket
+import struct
+
+C2S_REGISTER = 101
+C2S_LOGIN = 102
+C2S_LOGOUT = 103
+C2S_LIST_ROOMS = 301
+C2S_GET_HISTORY = 501
+S2C_RESPONSE_OK = 801
+S2C_RESPONSE_ERROR = 802
+S2C_LOGIN_OK = 803
+
+
+def recv_exact(sock, n):
+    data = b''
+    while len(data) < n:
+        chunk = sock.recv(n - len(data))
+        if not chunk:
+            raise ConnectionError("server closed the connection")
+        data += chunk
+    return data
+
+
+def request(sock, msg_type, payload):
+    body = json.dumps(payload).encode('utf-8')
+    sock.sendall(struct.pack('!HI', msg_type, len(body)) + body)
+    reply_type, length = struct.unpack('!HI', recv_exact(sock, 6))
+    reply = json.loads(recv_exact(sock, length)) if length else {}
+    return reply_type, reply
+
+
+def connect(host, port):
+    sock = socket.create_connection((host, port))
+    sock.settimeout(5)
+    return sock
+
+
+def login(sock, username):
+    request(sock, C2S_REGISTER, {'username': username, 'password': 'pw', 'role': 'USER'})
+    reply_type, reply = request(sock, C2S_LOGIN, {'username': username, 'password': 'pw'})
+    assert reply_type == S2C_LOGIN_OK, reply
+    return reply['session_token']
+
+
+def check(name, condition):
+    print(f"{'✓' if condition else '✗'} {name}")
+    return condition
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Connection-bound authentication")
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=8888)
+    args = parser.parse_args()
+
+    tag = random.randint(0, 10**9)
+    a = connect(args.host, args.port)
+    b = connect(args.host, args.port)
+    token_a = login(a, f"auth_a_{tag}")
+    token_b = login(b, f"auth_b_{tag}")
+
+    ok = True
+    ok &= check("own token accepted", request(a, C2S_LIST_ROOMS, {'session_token': token_a})[0] != S2C_RESPONSE_ERROR)
+    ok &= check("no token accepted on a logged-in connection",
+                request(a, C2S_LIST_ROOMS, {})[0] != S2C_RESPONSE_ERROR)
+    ok &= check("no token accepted by a pool handler",
+                request(a, C2S_GET_HISTORY, {})[0] != S2C_RESPONSE_ERROR)
+    ok &= check("another valid token still checked against the store",
+                request(a, C2S_LIST_ROOMS, {'session_token': token_b})[0] != S2C_RESPONSE_ERROR)
+    ok &= check("unknown token rejected", request(a, C2S_LIST_ROOMS, {'session_token': 'bogus'})[0] == S2C_RESPONSE_ERROR)
+
+    anonymous = connect(args.host, args.port)
+    ok &= check("no token rejected before login", request(anonymous, C2S_LIST_ROOMS, {})[0] == S2C_RESPONSE_ERROR)
+    anonymous.close()
+
+    # Logout of A's session from connection B revokes the binding on A
+    ok &= check("logout from another connection", request(b, C2S_LOGOUT, {'session_token': token_a})[0] == S2C_RESPONSE_OK)
+    ok &= check("revoked token rejected on its own connection",
+                request(a, C2S_LIST_ROOMS, {'session_token': token_a})[0] == S2C_RESPONSE_ERROR)
+    ok &= check("B still logged in", request(b, C2S_LIST_ROOMS, {})[0] != S2C_RESPONSE_ERROR)
+    ok &= check("logout without token", request(b, C2S_LOGOUT, {})[0] == S2C_RESPONSE_OK)
+    ok &= check("B logged out", request(b, C2S_LIST_ROOMS, {'session_token': token_b})[0] == S2C_RESPONSE_ERROR)
+
+    a.close()
+    b.close()
+    print("ALL PASSED" if ok else "FAILED")
+    raise SystemExit(0 if ok else 1)
+
+
+if __name__ == '__main__':
+    main()
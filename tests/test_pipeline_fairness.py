@@ -0,0 +1,108 @@
+#!/usr/bin/env python3
+"""
+Pipeline Fairness Test
+Một client gửi liên tục (pipeline) hàng chục nghìn requests; một client khác
+đo độ trễ từng request của mình trong lúc đó. Với scheduler công bằng, độ trễ
+của client thứ hai phải bị chặn (bounded), không phụ thuộc số request đang
+xếp hàng của client kia.
+
+Các request dùng message type không hợp lệ (9999): server trả
+S2C_RESPONSE_ERROR ngay trên event loop, không chạm database.
+
+Usage:
+    python3 test_pipeline_fairness.py [--host 127.0.0.1] [--port 8888] [--flood 50000]
+"""
+
+import argparse
+import json
+import socket
+import struct
+import threading
+import time
+
+UNKNOWN_MESSAGE = 9999
+S2C_RESPONSE_ERROR = 802
+
+
+def make_request():
+    payload = json.dumps({'padding': 'x' * 64}).encode('utf-8')
+    return struct.pack('!HI', UNKNOWN_MESSAGE, len(payload)) + payload
+
+
+def recv_frame(sock):
+    header = b''
+    while len(header) < 6:
+        chunk = sock.recv(6 - len(header))
+        if not chunk:
+            raise ConnectionError("server closed the connection")
+        header += chunk
+    msg_type, length = struct.unpack('!HI', header)
+    body = b''
+    while len(body) < length:
+        chunk = sock.recv(length - len(body))
+        if not chunk:
+            raise ConnectionError("server closed the connection")
+        body += chunk
+    return msg_type
+
+
+def flood(host, port, count, done):
+    sock = socket.create_connection((host, port))
+    request = make_request()
+
+    def reader():
+        for _ in range(count):
+            recv_frame(sock)
+        done.set()
+
+    thread = threading.Thread(target=reader, daemon=True)
+    thread.start()
+    batch = request * 500
+    for _ in range(count // 500):
+        sock.sendall(batch)
+    thread.join()
+    sock.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Latency of one client while another pipelines")
+    parser.add_argument('--host', default='127.0.0.1')
+    parser.add_argument('--port', type=int, default=8888)
+    parser.add_argument('--flood', type=int, default=50000)
+    args = parser.parse_args()
+
+    probe = socket.create_connection((args.host, args.port))
+    probe.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+    request = make_request()
+
+    done = threading.Event()
+    flood_start = time.monotonic()
+    flooder = threading.Thread(target=flood, args=(args.host, args.port, args.flood, done), daemon=True)
+    flooder.start()
+
+    latencies = []
+    while not done.is_set():
+        start = time.monotonic()
+        probe.sendall(request)
+        assert recv_frame(probe) == S2C_RESPONSE_ERROR
+        latencies.append((time.monotonic() - start) * 1000)
+        time.sleep(0.002)
+    flood_time = time.monotonic() - flood_start
+    flooder.join()
+    probe.close()
+
+    latencies.sort()
+    def pct(p):
+        return latencies[min(len(latencies) - 1, int(len(latencies) * p / 100))]
+
+    print("=" * 60)
+    print(f"Pipeline fairness: {args.flood} pipelined requests from one client")
+    print("=" * 60)
+    print(f"flood handled in {flood_time:.2f} s ({args.flood / flood_time:.0f} req/s)")
+    print(f"probe requests: {len(latencies)}")
+    if latencies:
+        print(f"probe latency (ms): p50={pct(50):.2f} p99={pct(99):.2f} max={latencies[-1]:.2f}")
+
+
+if __name__ == '__main__':
+    main()